@@ -8,18 +8,281 @@
  * descending order.
  * It uses multiple threads to distribute up the counting process.
  *
- * Usage: ./program_name <file.txt> <num_threads>
+ * Build: gcc -O2 -pthread main.c -o lab2 -lm (libm for the Zipf law of the
+ * generator and the percentiles of bench and stress)
+ *
+ * Usage: ./program_name <file.txt|directory> [...] <num_threads> [--strategy=<name>]
  * Example: ./program_name partidos.txt 4
+ * Example: ./program_name partidos.txt 4 --strategy=local
+ * Example: ./program_name temporadas/ 8 --per-file
+ *
+ * Several files (or directories with files) can be given. They are split in
+ * chunks of similar size that are distributed largest first to the thread
+ * with less work, so all the threads finish at about the same time. The result
+ * is a combined report or, with --per-file, a report per input file
+ * (reporte_mvp_<name>.txt, with _2, _3... for files with the same name in
+ * other directories).
+ *
+ * With --cache-dir=<directory> the combined aggregate is saved in the
+ * directory under a fingerprint of the inputs (path, size, modification and
+ * change times and inode of every file) and of the query options, and an
+ * identical later run writes the report from it without scanning.
+ * --cache-sample adds a hash of sampled blocks of the files to the
+ * fingerprint, for file systems whose times can't be trusted.
+ *
+ * With --memo-dir=<directory> the files are split in blocks of about
+ * --memo-block bytes (16M by default) and the partial aggregate of every block
+ * is saved in the directory under the hash of its content and the query. The
+ * boundaries of the blocks are chosen by the content of the lines, so an edit
+ * only changes the blocks around it even if it moves the rest of the file.
+ * Later runs only scan the blocks whose content changed and load the rest,
+ * so an edit in a big file costs about hashing it (mapped in memory, 8 bytes
+ * at a time) instead of a full scan.
+ *
+ * With --dedup the lines that are exact copies of a previous line of the same
+ * input (replayed matches) are skipped before counting. The filter takes
+ * about 16 bytes per input line (its size is shown with the skipped records)
+ * and up to 1 TiB of inputs.
+ *
+ * With --deadline=<ms> the run gives a partial result on time instead of an
+ * exact one late: when the time is over (on the monotonic clock) the threads
+ * stop after their current batch or slice of a memoized block being hashed,
+ * what was aggregated is merged and the report ends with an
+ * INCOMPLETO line with the fraction of the bytes processed. The lines aren't
+ * counted before the scan then (the tables are sized from the file sizes).
+ *
+ * With --repeat=<n> the count and the report run n times in the same process.
+ * The later runs empty the tables of the first one instead of freeing them,
+ * and reuse their buckets, the arenas of their items, the key buffers of the
+ * threads and the array sorted for the report, so a warm run makes no
+ * allocations in the tracked subsystems (tables, items, keys, parser buffers
+ * and name arrays); only the small per-run bookkeeping (thread and work unit
+ * arrays, the statistics of the threads and stdio) still goes through malloc.
+ * With --stats the tracked allocations and the time of every run are
+ * printed, and the statistics at the end are those of the last run.
+ *
+ * With --stats the time of every phase (and of every thread) is printed to
+ * stderr together with the throughput in bytes/s and lines/s, the
+ * contention of tableMutex and the stripe mutexes, the quality of the hash
+ * table (occupancy, chain lengths and comparisons per lookup) and the current
+ * and peak bytes and the allocations of every subsystem next to the peak RSS.
+ * With --perf the hardware counters of every thread during the aggregation
+ * are printed (IPC and cache, branch and dTLB misses per line), if the system
+ * allows perf events.
+ * With --progress a line with the bytes processed, the rate and the ETA is
+ * refreshed on stderr while the threads scan, so a slow run can be told apart
+ * from a hung one.
+ * With --trace=<file.json> the timeline of every thread (chunks, extraction,
+ * aggregation, lock waits and the phases of the main thread) is written in
+ * Trace Event format, to be loaded in chrome://tracing or Perfetto.
+ *
+ * When built with systemtap's sys/sdt.h, the program has USDT probes
+ * (provider mvp) that cost nothing until a tracer attaches:
+ *  - chunk_start(tid, fileIndex, startOffset, endOffset)
+ *  - chunk_end(tid, fileIndex, lines, bytes)
+ *  - key_insert(key, value): a new player was added to a table
+ *  - lock_wait(lockId, nanoseconds): a thread waited for a strategy mutex
+ *  - report_write_start(fileName) and report_write_end(fileName, players)
+ * Example: bpftrace -e 'usdt:./lab2:mvp:lock_wait { @[arg0] = hist(arg1); }'
+ *
+ * Diff mode compares two seasons (files, directories or snapshots saved with
+ * --snapshot), both aggregated at the same time, and writes the delta and the
+ * rank change of every player to reporte_diff.txt:
+ * Example: ./program_name diff 22_23.txt 23_24.txt 4
+ *
+ * The generate command writes synthetic inputs in the same format, of any
+ * size, with a given number of players whose awards follow a Zipf
+ * distribution, a fraction of names with UTF-8 characters, a range of line
+ * lengths (reached with a filler field between the score and the MVP, so the
+ * named columns keep their values) and a fixed seed (the same options always
+ * give the same file):
+ * Example: ./program_name generate partidos_10g.txt --size=10G --players=5000 --skew=1.1
+ *
+ * The bench command generates inputs of every size and skew and times the
+ * counting engine (line count, aggregation, merge and sorted report) for
+ * every strategy and number of threads, with warmup runs and repetitions.
+ * The median and p95 times, lines/s and GB/s are written as JSON:
+ * Example: ./program_name bench --threads=1,2,4,8 --sizes=64M,256M --skews=0,1.2 --output=bench.json
+ *
+ * The microbench command times the hot functions alone (hashGenerator and
+ * an FNV-1a alternative, countVisibleCharacters, field extraction,
+ * incrementOrInsertHashItem with 1 to N threads, the sort of the report with
+ * qsort and a counting sort, and the report lines) over generated names with
+ * a Zipf distribution, and prints the ns/op of each one:
+ * Example: ./program_name microbench --keys=1000000 --threads=8
+ *
+ * The verify command runs every strategy with every number of threads over
+ * the given files and over generated inputs, and checks that the counts are
+ * the same as those of a simple single-threaded reference (in any order).
+ * Every run is repeated with other columns, with --filter, with --dedup,
+ * with --per-file (the input twice), with the reference loaded as a
+ * snapshot next to the input, as diff does, and written as a report and read
+ * back. A last input has names longer than the padding of the report.
+ * The reference of the first file can be checked too against a report:
+ * Example: ./program_name verify mvp_champions_23_24.txt --expected=expected.txt --sizes=4M,32M
+ *
+ * The stress command feeds every strategy with adversarial keys: a single
+ * player in every line (a final), a different player in every line and a
+ * few players crafted to fall in the same bucket of hashGenerator. It prints
+ * the throughput and the latency percentiles of the batches as JSON:
+ * Example: ./program_name stress --threads=1,4,16 --keys=1000000
+ *
+ * The reports command parses the inputs once into a columnar store: every
+ * field is replaced by the id of its value in a dictionary of its column and
+ * the score is parsed into goals. Then it writes a report per --group-by
+ * column (the MVP, the stage, the clubs...) counting those ids with plain
+ * loops over arrays split among the threads, instead of scanning the text
+ * again for every report:
+ * Example: ./program_name reports partidos.txt 4 --group-by=last,0,1 --filter=0:Grupo
+ *
+ * With --teams the reports command also attributes every award to the club
+ * of the MVP, in the same pass over the ids of the store, and writes the
+ * awards of every club and of every player at home and away
+ * (reporte_clubes.txt and reporte_mvp_lados.txt). The side of the MVP is
+ * that of the winner of the match or, with --teams=<jugadores.txt> (lines
+ * <player>,<club>), that of the club of the player:
+ * Example: ./program_name reports partidos.txt 4 --teams=jugadores.txt
+ *
+ * The query command answers a small SQL query over the same store:
+ *   SELECT <column|count(*)|sum(<goals>)>, ... [WHERE <column> <op> <value> [AND ...]]
+ *   [GROUP BY <column>, ...] [ORDER BY <n|column> [ASC|DESC], ...] [LIMIT <n>]
+ * The columns are stage, home, away, score, mvp (the last field of every
+ * line, the same column as c<n> when all the lines have n + 1 fields) or
+ * c<n>, and the goals home_goals, away_goals and goals. The operators are =,
+ * <>, LIKE (with % and _) and, for the goals, <, <=, > and >=. The query is
+ * compiled to a pipeline of operators (filter, group and aggregate) that the
+ * threads run over batches of rows, the groups are kept in hash tables keyed
+ * by the packed ids of the GROUP BY columns, and the result is written to
+ * stdout:
+ * Example: ./program_name query \
+ *     "SELECT mvp, count(*) WHERE stage LIKE 'Grupo%' GROUP BY mvp ORDER BY 2 DESC LIMIT 10" partidos.txt 4
+ *
+ * The counting core is hidden behind a small interface (AggregationStrategy)
+ * so the way threads share the counts can be chosen at runtime:
+ *  - mutex:    one shared hash table protected by a single global mutex
+ *  - striped:  one shared hash table with a mutex per group of buckets
+ *  - local:    one private hash table per thread, merged at the end
+ *  - lockfree: one shared hash table updated with atomic operations
+ *  - sketch:   one Space-Saving sketch per thread (bounded memory, the counts
+ *              are upper bounds when there are more players than counters)
  *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// USDT static tracepoints (provider "mvp") when systemtap's sys/sdt.h is
+// available. Every probe has a semaphore that the tracer increments while it
+// is attached, so probes with costly arguments are only evaluated then.
+// Without sys/sdt.h the probes compile to nothing.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HAVE_SYS_SDT_H 1
+#endif
+#endif
+
+#ifdef HAVE_SYS_SDT_H
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define MVP_PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short mvp_##name##_semaphore \
+    __attribute__((unused)) __attribute__((section(".probes")))
+#define MVP_PROBE_ENABLED(name) __builtin_expect(mvp_##name##_semaphore != 0, 0)
+#define MVP_PROBE1(name, a) DTRACE_PROBE1(mvp, name, a)
+#define MVP_PROBE2(name, a, b) DTRACE_PROBE2(mvp, name, a, b)
+#define MVP_PROBE4(name, a, b, c, d) DTRACE_PROBE4(mvp, name, a, b, c, d)
+#else
+#define MVP_PROBE_SEMAPHORE(name) typedef int mvp_##name##_probe_unavailable
+#define MVP_PROBE_ENABLED(name) 0
+#define MVP_PROBE1(name, a) do { } while (0)
+#define MVP_PROBE2(name, a, b) do { } while (0)
+#define MVP_PROBE4(name, a, b, c, d) do { } while (0)
+#endif
+
+// Mutex to protect the shared hash table, to avoid race conditions.
+// It is statically initialized since it is shared by every table of the
+// mutex strategy (there is one per file with --per-file)
+pthread_mutex_t tableMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Number of mutexes used by the striped strategy (each one protects the
+// buckets whose index modulo this value is the same)
+#define NUMBER_OF_STRIPES 64
+
+// Locks profiled with --stats: tableMutex and every stripe mutex
+#define TABLE_MUTEX_LOCK_ID 0
+#define STRIPE_LOCK_ID(stripe) (1 + (stripe))
+#define NUMBER_OF_PROFILED_LOCKS (1 + NUMBER_OF_STRIPES)
+
+// Hardware events counted with --perf
+#define NUMBER_OF_PERF_EVENTS 5
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_CACHE_MISSES 2
+#define PERF_BRANCH_MISSES 3
+#define PERF_DTLB_MISSES 4
+
+// Time between two refreshes of the --progress line
+#define PROGRESS_INTERVAL_MS 500
+
+// Events kept per thread with --trace (older ones are overwritten)
+#define TRACE_RING_CAPACITY 65536
+
+// Default number of counters kept by each thread in the sketch strategy
+#define DEFAULT_SKETCH_CAPACITY 1024
+
+// Number of counters kept by each thread in the sketch strategy
+size_t sketchCapacity = DEFAULT_SKETCH_CAPACITY;
+
+// Number of keys extracted before handing them to the strategy
+#define KEY_BATCH_SIZE 4096
+
+// Bytes where a thread copies the keys of a batch, the batch ends early if
+// the next line might not fit
+#define KEY_BUFFER_SIZE (64 * 1024)
+
+// Bytes of every block of an arena (bigger items get a block of their own)
+#define ARENA_BLOCK_SIZE (64 * 1024)
 
-// Mutex to protect the shared hash table, to avoid race conditions
-pthread_mutex_t tableMutex;
+// Files are split in chunks so every thread gets about this many of them
+#define CHUNKS_PER_THREAD 4
+
+// Smallest chunk a file is split into, smaller files are a single chunk
+#define MIN_CHUNK_SIZE (64 * 1024)
+
+// First line of the files written with --snapshot
+#define SNAPSHOT_HEADER "MVPSNAP 1"
+
+// Bytes per line assumed to size the tables when the lines aren't counted
+// to save time for the scan (--deadline)
+#define ESTIMATED_LINE_LENGTH 32
+
+// Default size of the blocks memoized with --memo-dir
+#define DEFAULT_MEMO_BLOCK_SIZE (16L * 1024 * 1024)
+#define MEMO_BOUNDARY_BYTES 32  // Bytes at the end of a line that decide a block boundary
+#define MEMO_HASH_SLICE (1L << 20)  // Bytes hashed between checks of the deadline
+
+// Samples hashed by --cache-sample and the bytes of every sample
+#define CACHE_SAMPLES 16
+#define CACHE_SAMPLE_SIZE 4096
 
 /* Represents a single item in the hash table */
 typedef struct HashItem {
@@ -28,12 +291,32 @@ typedef struct HashItem {
     struct HashItem *next;  // Pointer to next item (for collision chaining)
 } HashItem;
 
+/* A block of an arena, its bytes are handed out in order */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;    // Bytes of data
+    size_t used;    // Bytes of data already handed out
+    char data[];
+} ArenaBlock;
+
+/* Memory handed out in order from a list of blocks that are only freed all
+ * together. A reset rewinds it to the first block keeping every block, so
+ * the next run fills the same memory again */
+typedef struct Arena {
+    ArenaBlock *first;
+    ArenaBlock *current;    // Block the next allocation is taken from
+} Arena;
+
 /* Represents a hash table with an array of pointers to HashItem structures.
- * Size is the capacity of the table, and count is the number of items in it. */
+ * Size is the capacity of the table, and count is the number of items in it.
+ * The items of a table with arenas (and their keys) are taken from the arena
+ * of the thread that inserts them instead of being allocated one by one */
 typedef struct HashTable {
     HashItem **items;
     size_t size;
     size_t count;
+    Arena *arenas;  // One per inserting thread (NULL if items are allocated one by one)
+    int numArenas;
 } HashTable;
 
 /* Struct to facilitate the sorting of MVP by their count. */
@@ -42,487 +325,9034 @@ typedef struct SortableItem {
     int value;  // Count value for sorting
 } SortableItem;
 
-/* Parameters passed to each thread to define its work range. */
-typedef struct ThreadData {
-    int tid;    // Thread ID for identification
-    char *fileName; // Input file to process
-    int startLine;  // Starting line in the file
-    int endLine;    // Ending line in the file
-    HashTable *table;   // Shared hash table reference
-} ThreadData;
+/* Callback used to visit every (player, count) pair of an aggregation */
+typedef void (*ItemVisitor)(const char *key, int value, void *context);
 
-// Function forward declarations
-int countVisibleCharacters(const char *str);
+/* Interface implemented by every counting strategy.
+ * init creates the state, addBatch is called concurrently by the threads with
+ * a batch of keys (counts NULL means 1 per key), merge is called once after
+ * all threads finished, iterate visits the merged result and destroy frees
+ * everything. resultTable exposes the merged hash table for --stats and
+ * reset empties the state for another run over it (--repeat). */
+typedef struct AggregationStrategy {
+    const char *name;   // Name used with --strategy
+    const char *description;    // Short description for the usage message
+    void *(*init)(size_t capacity, int numberOfThreads);
+    void (*addBatch)(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+    void (*merge)(void *state);
+    void (*iterate)(void *state, ItemVisitor visit, void *context);
+    void (*destroy)(void *state);
+    HashTable *(*resultTable)(void *state);   // Merged table (for diagnostics)
+    void (*reset)(void *state); // Empties the state keeping its memory for another run
+} AggregationStrategy;
 
-int ceilDivision(int numerator, int divisor);
+/* Shape of the query: which column is counted and which lines are kept */
+typedef struct ParserQuery {
+    int column; // Column to count (-1 means the last one)
+    char delimiter; // Character separating the columns
+    int filterColumn;   // Column checked by the filter (-1 means no filter)
+    const char *filterPrefix;   // Prefix the filter column must start with
+    size_t filterPrefixLength;
+} ParserQuery;
 
-int getLineCountFromFile(const char *fileName);
+/* A slot of the deduplication filter packs the top bits of the fingerprint
+ * of a record with where it is (to verify a repeated fingerprint against the
+ * original line) in a single word, so it is written with one compare-and-swap */
+#define DEDUP_LOCATION_BITS 40
+#define DEDUP_LOCATION_MASK ((1ULL << DEDUP_LOCATION_BITS) - 1)
 
-unsigned int hashGenerator(char *key, int size);
+/* Lock-free set of the records already counted, used by --dedup to skip the
+ * lines that are exact copies of a previous one. It takes 8 bytes per slot
+ * and has twice as many slots as lines, so about 16 bytes per input line */
+typedef struct DedupFilter {
+    uint64_t *slots;    // Open addressing table, power of two size, 0 means empty
+    size_t mask;
+    int *descriptors;   // Read-only descriptor per input file (for pread)
+    const int *groups;  // Group of every input file
+    uint64_t *fileStarts;   // Offset of every file in the inputs one after another
+    size_t numFiles;
+    size_t duplicates;  // Number of records skipped
+} DedupFilter;
 
-HashTable *createHashTable(int size);
+/* Reads the lines that start inside a byte range of a file */
+typedef struct LineReader {
+    FILE *file;
+    long position;  // Offset of the next byte to read
+    long endOffset; // Lines starting at or after this offset are not read
+    long lineOffset;    // Offset of the last line read
+    long linesRead; // Number of lines read so far
+    long fullLength;    // Length of the last line without its line break if it
+                        // didn't fit in the buffer, 0 otherwise
+    int fileIndex;  // Index of the file in the input list
+    DedupFilter *dedup; // Filter of duplicated records (or NULL)
+    char buffer[1024];
+} LineReader;
 
-HashItem *createHashItem(char *key, int value);
+/* Extracts the keys of up to maxKeys lines of the reader into keys, copying
+ * them to keyBuffer (KEY_BUFFER_SIZE bytes), returns how many keys were
+ * extracted (0 once the range is exhausted) */
+typedef size_t (*ExtractKeysFunction)(LineReader *reader, const ParserQuery *query,
+                                      char **keys, char *keyBuffer, size_t maxKeys, int *finished);
 
-void incrementOrInsertHashItem(HashTable *table, char *key, int value);
+/* A parser variant specialized for a shape of query */
+typedef struct ParserVariant {
+    const char *name;
+    int column;
+    int filterColumn;
+    char delimiter;
+    ExtractKeysFunction extractKeys;
+} ParserVariant;
 
-void freeHashTable(HashTable *table);
+/* Specialized parser variants for the common query shapes:
+ * X(name, counted column, filter column, delimiter)
+ * A column -1 means the last one and a filter column -1 means no filter.
+ * The default (count of the MVP, the last column) must stay first */
+#define PARSER_VARIANTS(X) \
+    X(LastColumn, -1, -1, ',') \
+    X(Column0, 0, -1, ',') \
+    X(Column1, 1, -1, ',') \
+    X(Column2, 2, -1, ',') \
+    X(Column3, 3, -1, ',') \
+    X(Column4, 4, -1, ',') \
+    X(LastColumnByColumn0, -1, 0, ',') \
+    X(Column1ByColumn0, 1, 0, ',') \
+    X(Column2ByColumn0, 2, 0, ',')
 
-char **extractMVPNamesFromLineRange(const char *fileName, int startLine, int endLine);
+/* An input file with its size and number of lines */
+typedef struct InputFile {
+    char *path;
+    long size;
+    int lineCount;
+    int group;  // Index of the state the file is counted into
+} InputFile;
 
-int compareByMVPCounts(const void *a, const void *b);
+/* Growable list of input files */
+typedef struct InputList {
+    InputFile *files;
+    size_t count;
+    size_t capacity;
+} InputList;
 
-int writeReportOfPlayersSortedByMVPCount(HashTable *table);
+/* A piece of work: the lines starting inside a byte range of an input file */
+typedef struct WorkUnit {
+    int fileIndex;  // Index of the file in the input list
+    long startOffset;   // First byte of the range
+    long endOffset; // First byte after the range
+} WorkUnit;
 
-void *countPlayerOccurrences(void *arg);
+/* A span of time of a thread, exported as a Trace Event "complete" event */
+typedef struct TraceEvent {
+    const char *name;   // Static string, never freed
+    double startSeconds;
+    double durationSeconds;
+} TraceEvent;
 
-int main(int argc, char *argv[]) {
-    // Check if the user provided the correct number of arguments
-    if (argc != 3) {
-        // Print message with instructions if the number of arguments is incorrect
-        fprintf(stderr, "Usage: %s archivo.txt num_hebras\n", argv[0]);
-        return EXIT_FAILURE;
-    }
+/* Preallocated ring of events of a thread, when it is full the oldest events
+ * are overwritten so recording never allocates */
+typedef struct TraceRing {
+    TraceEvent *events;
+    size_t capacity;
+    size_t written; // Total events recorded (may exceed the capacity)
+    char name[32];  // Thread name shown by the trace viewer
+} TraceRing;
 
-    // Parse input parameters: filename and number of threads
-    char *fileName = argv[1];
-    int numberOfThreads = atoi(argv[2]);
-    if (numberOfThreads <= 0) {
-        fprintf(stderr, "Error: threads number must be greater than 0.\n");
-        return EXIT_FAILURE;
-    }
+/* Bytes scanned by a thread, alone in its cache line so the threads don't
+ * invalidate each other's counter */
+typedef struct ProgressCounter {
+    long bytes;
+    char padding[64 - sizeof(long)];
+} ProgressCounter;
 
-    // Count total lines in the input file
-    int lineCount = getLineCountFromFile(fileName);
-    if (lineCount == -1) {
-        fprintf(stderr, "Error while counting lines in the file.\n");
-        return EXIT_FAILURE;
-    }
+/* Parameters passed to each thread to define its work range. */
+typedef struct ThreadData {
+    int tid;    // Thread ID for identification
+    InputFile *files;   // Input files to process
+    WorkUnit *units;    // Work units assigned to the thread
+    size_t numUnits;
+    long assignedBytes; // Total bytes of the assigned units
+    const AggregationStrategy *strategy;    // Strategy used to count
+    void **states;  // States of the strategy, one per group of files
+    const ParserVariant *parser;    // Variant used to extract the keys
+    const ParserQuery *query;   // Column and filter of the query
+    DedupFilter *dedup; // Filter of duplicated records (or NULL)
+    TraceRing *traceRing;   // Ring of trace events of the thread (or NULL)
+    ProgressCounter *progress;  // Bytes scanned for --progress (or NULL)
+    const char *memoDirName;    // Directory of memoized blocks (or NULL)
+    uint64_t memoSeed;  // Hash of the query, the seed of the block hashes
+    long scannedBytes;  // Bytes of the units scanned (or loaded) by the thread
+    char **keys;    // Keys of the batch being extracted (KEY_BATCH_SIZE)
+    char *keyBuffer;    // Where the keys of the batch are copied (KEY_BUFFER_SIZE)
+    int failed; // A unit couldn't be counted, the result is wrong
+} ThreadData;
 
-    // Calculate how many lines each thread should process (rounded up)
-    // ex: 125 lines and 3 threads = 125/3 => 41.666 => 42
-    int linesPerThread = ceilDivision(lineCount, numberOfThreads);
+/* Options given in the command line */
+typedef struct ProgramOptions {
+    char **inputs;  // Files or directories to process
+    size_t numInputs;
+    int numberOfThreads;
+    const AggregationStrategy *strategy;
+    ParserQuery query;
+    int perFile;    // Write a report per input file instead of a combined one
+    const char *snapshotFileName;   // File where the aggregate is saved (or NULL)
+    int dedup;  // Skip the lines that are copies of a previous line
+    int stats;  // Print the timing breakdown at the end
+    int perf;   // Count hardware events during the aggregation
+    const char *traceFileName;  // Trace Event JSON written at exit (or NULL)
+    int progress;   // Print a live progress line while scanning
+    const char *cacheDirName;   // Directory of cached aggregates (or NULL)
+    int cacheSample;    // Add a hash of sampled blocks to the fingerprint
+    const char *memoDirName;    // Directory of memoized blocks (or NULL)
+    long memoBlockSize; // Size of the memoized blocks
+    long deadlineMilliseconds;  // Time after which the result is partial (0 means none)
+    int repeat; // Runs of the count in the same process
+} ProgramOptions;
 
-    // Create a hash table with a size equal to the number of lines in the file
-    HashTable *table = createHashTable(lineCount);
-    if (table == NULL) {
-        fprintf(stderr, "Error creating hash table.\n");
-        return EXIT_FAILURE;
-    }
+/* Phases of a run timed by --stats */
+typedef enum Phase {
+    PHASE_LINE_COUNT,   // Counting the lines of the inputs
+    PHASE_SCAN, // Threads extracting and aggregating the keys (wall time)
+    PHASE_MERGE,    // Merging the partial results of the threads
+    PHASE_SORT, // Sorting the players for the report
+    PHASE_REPORT,   // Writing the report
+    NUMBER_OF_PHASES
+} Phase;
 
-    // Initialize mutex that will be used to ensure that only one thread can
-    // access the hash table at a time preventing race condition
-    pthread_mutex_init(&tableMutex, NULL);
+/* Lookups done by a thread in the hash tables, to measure how many key
+ * comparisons every lookup costs */
+typedef struct LookupStats {
+    long lookups;
+    long comparisons;   // Keys compared while walking the chains
+} LookupStats;
 
-    // Dynamically allocate memory for an  array of pthread_t to store ids
-    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
-    if (threads == NULL) {
-        fprintf(stderr, "Error allocating memory for threads.\n");
-        freeHashTable(table);
-        return EXIT_FAILURE;
-    }
+/* Timings and volumes measured by a thread while scanning its chunks */
+typedef struct ThreadStats {
+    double extractSeconds;  // Time reading lines and extracting keys
+    double aggregateSeconds;    // Time inside the strategy addBatch
+    double totalSeconds;    // Time since the thread started
+    long units; // Chunks processed
+    long lines; // Lines read
+    long keys;  // Keys handed to the strategy
+    long bytes; // Bytes read
+    long memoLoaded;    // Memoized blocks loaded from --memo-dir
+    long memoScanned;   // Memoized blocks scanned because they changed
+    LookupStats lookupStats;    // Lookups in the hash tables
+} ThreadStats;
 
-    // Dynamically allocate memory for an array of data (ThreadData) for threads
-    ThreadData *threadData = malloc(numberOfThreads * sizeof(ThreadData));
-    if (threadData == NULL) {
-        fprintf(stderr, "Error allocating memory for threads data.\n");
-        free(threads);
-        freeHashTable(table);
-        return EXIT_FAILURE;
-    }
+/* Contention of a lock measured by a thread */
+typedef struct LockStats {
+    long acquisitions;  // Times the lock was taken
+    long contended; // Times the lock was already taken by another thread
+    double totalWaitSeconds;    // Time waiting for the lock
+    double maxWaitSeconds;  // Longest wait
+} LockStats;
 
-    // Distribute work among threads by assigning a range of lines to each thread
-    int startLine = 0;
-    for (int i = 0; i < numberOfThreads; i++) {
-        // Calculate end position for current thread's work chunk
-        int endLine = startLine + linesPerThread;
+/* Subsystems whose allocations are accounted with --stats */
+typedef enum MemorySubsystem {
+    MEMORY_HASH_ITEMS,  // HashItem and sketch counters
+    MEMORY_KEYS,    // Player names owned by the tables and sketches
+    MEMORY_BUCKETS, // Hash tables and their bucket arrays, sketch heaps
+    MEMORY_NAMES,   // Arrays of names to sort (reports and diff entries)
+    MEMORY_PARSER,  // Key batches and the keys extracted by the parser
+    MEMORY_COLUMNS, // Id and goal arrays of the columnar store
+    MEMORY_ARENAS,  // Blocks of the arenas of items and keys of the strategy tables
+    NUMBER_OF_MEMORY_SUBSYSTEMS
+} MemorySubsystem;
 
-        // If the end line exceeds the total number of lines, set it to lineCount
-        // Ex: 125 / 3 = 41.66 => 42 but 42 * 3 = 126 > 125 so we set it to 125
-        // to avoid out of bounds access
-        if (endLine > lineCount) {
-            endLine = lineCount;
-        }
+/* Bytes allocated by a subsystem and calls to the allocator it made,
+ * updated with atomic operations */
+typedef struct MemoryUsage {
+    long currentBytes;
+    long peakBytes;
+    long allocations;
+} MemoryUsage;
 
-        // Configure thread parameters
-        threadData[i].tid = i;
-        threadData[i].fileName = fileName;
-        threadData[i].startLine = startLine;
-        threadData[i].endLine = endLine;
-        threadData[i].table = table;
+/* Statistics collected when --stats is given */
+typedef struct Statistics {
+    int enabled;
+    double phaseSeconds[NUMBER_OF_PHASES];
+    ThreadStats *threads;   // Per thread statistics of the scan
+    LockStats *locks;   // NUMBER_OF_PROFILED_LOCKS entries per thread
+    int numberOfThreads;
+    MemoryUsage memory[NUMBER_OF_MEMORY_SUBSYSTEMS];
+} Statistics;
 
-        // Update start position for next thread
-        startLine = endLine;
-    }
+/* Hardware event counted with --perf */
+typedef struct PerfEvent {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} PerfEvent;
 
-    // Create threads to count player occurrences in the file
-    // Each thread will process a range of lines from the file
-    for (int i = 0; i < numberOfThreads; i++) {
-        pthread_create(&threads[i], NULL, countPlayerOccurrences, (void *) &threadData[i]);
-    }
+/* Hardware counters of a thread, opened as a group so they are enabled and
+ * read together. Events the CPU (or the VM) doesn't support are skipped */
+typedef struct PerfSession {
+    int leader; // Descriptor of the group leader (-1 if not opened)
+    int descriptors[NUMBER_OF_PERF_EVENTS];
+    int order[NUMBER_OF_PERF_EVENTS];   // Event of every value read from the group
+    int numOpened;
+} PerfSession;
 
-    // Wait for all threads to complete their processing before continuing
-    // This ensures all MVP data has been processed before printing results
-    for (int i = 0; i < numberOfThreads; i++) {
-        pthread_join(threads[i], NULL);
-    }
+/* Values counted by a thread during the aggregation */
+typedef struct PerfCounters {
+    uint64_t values[NUMBER_OF_PERF_EVENTS];
+    int supported[NUMBER_OF_PERF_EVENTS];
+    long lines; // Lines read by the thread
+    int opened; // 1 if the thread could open the counters
+} PerfCounters;
 
-    // Write the results to file report mvp.txt in sorted order
-    int report = writeReportOfPlayersSortedByMVPCount(table);
-    if (report == -1) {
-        fprintf(stderr, "Error while writing the sorted report.\n");
-        free(threads);
-        free(threadData);
-        freeHashTable(table);
-        return EXIT_FAILURE;
-    }
+/* Hardware counters report of --perf */
+typedef struct PerfReport {
+    int enabled;
+    PerfCounters *threads;
+    int numberOfThreads;
+    int failureReported;    // The failure to open the counters was already printed
+} PerfReport;
 
-    // Clean up resources
-    free(threads);
-    free(threadData);
-    freeHashTable(table);
+/* Live progress of the scan, sampled by a timer thread with --progress. The
+ * workers only store their own counter, the mutex and the condition are used
+ * by the main thread to wake up the timer thread when the scan ends */
+typedef struct ProgressMonitor {
+    ProgressCounter *threads;
+    int numberOfThreads;
+    long totalBytes;    // Bytes of all the work units
+    double startSeconds;
+    int finished;
+    pthread_mutex_t mutex;
+    pthread_cond_t finishedCondition;
+} ProgressMonitor;
 
-    // Destroy the mutex after all threads have finished
-    pthread_mutex_destroy(&tableMutex);
+/* Deadline of a run with --deadline. A timer thread sets expired when the
+ * time is over and the workers check it between batches (and slices of the
+ * memoized blocks they hash), so they stop after at most a batch and the
+ * scan ends with what was aggregated. The bytes of the last scan (in total
+ * and by group) tell how much of the inputs the result covers */
+typedef struct DeadlineTimer {
+    long milliseconds;  // 0 means no deadline
+    int expired;    // Set by the timer, read by the workers (atomic)
+    int finished;   // The run ended before the deadline
+    struct timespec deadline;   // When the time is over (CLOCK_MONOTONIC)
+    long scannedBytes;
+    long totalBytes;
+    long *groupScannedBytes;    // Bytes scanned of every group of files (atomic)
+    long *groupTotalBytes;  // Bytes of the work units of every group
+    pthread_mutex_t mutex;
+    pthread_cond_t finishedCondition;
+} DeadlineTimer;
 
-    return EXIT_SUCCESS;
-}
+/* Trace of the run written with --trace, ring 0 is the main thread */
+typedef struct TraceLog {
+    const char *fileName;   // NULL when tracing is disabled
+    double originSeconds;   // Timestamps are relative to the start
+    TraceRing **rings;
+    int numRings;
+} TraceLog;
 
-/* Calculates the ceiling division of two integers (division rounded up) */
-int ceilDivision(int numerator, int divisor) {
-    if (numerator % divisor == 0) {
-        return numerator / divisor;
-    } else {
-        return (numerator / divisor) + 1;
-    }
-}
+/* A player of the diff report, indexed by its interned ID */
+typedef struct DiffEntry {
+    char *key;  // Reference to the key in the first table that had it
+    int previousCount;  // Count in the first (previous) input
+    int currentCount;   // Count in the second (current) input
+    int previousRank;   // Rank in the first input (0 if absent)
+    int currentRank;    // Rank in the second input (0 if absent)
+} DiffEntry;
 
-/* Creates an initializes a hash table with capacity defined by the given size
- * Returns a pointer to the table or NULL if it fails */
-HashTable *createHashTable(int size) {
-    // Allocate memory for the table structure
-    HashTable *table = malloc(sizeof(HashTable));
-    if (table == NULL) {
-        perror("Failed to allocate memory for hash table.");
-        return NULL;
-    }
+/* Interned players of both inputs of a diff */
+typedef struct DiffJoin {
+    HashTable *ids; // Player name to ID (stored as the value)
+    DiffEntry *entries; // Entries indexed by ID
+    size_t count;
+    size_t capacity;
+    int side;   // Input being interned (0 previous, 1 current)
+} DiffJoin;
 
-    // Create a zero-initialized items array
-    table->items = calloc(size, sizeof(HashItem *));
-    if (table->items == NULL) {
-        perror("Failed to allocate memory for hash table items.");
-        free(table);
-        return NULL;
-    }
+/* Options of the generate command */
+typedef struct GeneratorOptions {
+    const char *fileName;
+    long long targetLines;  // Lines to write (0 when the size is given)
+    long long targetBytes;  // Bytes to write (0 when the lines are given)
+    size_t numberOfPlayers; // Distinct MVPs
+    double skew;    // Zipf exponent, 0 gives uniform awards
+    double utf8Fraction;    // Fraction of players with non-ASCII names
+    int minLineLength;  // Lines are padded to a length drawn in this range (0 is no padding)
+    int maxLineLength;
+    uint64_t seed;
+} GeneratorOptions;
 
-    // Initializes table properties
-    table->count = 0;
-    table->size = size;
+// Maximum values of every list given to the bench command
+#define MAX_BENCH_VALUES 16
 
-    return table;
-}
+/* Options of the bench command, every list is swept in nested loops */
+typedef struct BenchOptions {
+    int threads[MAX_BENCH_VALUES];
+    size_t numThreads;
+    const AggregationStrategy *strategies[MAX_BENCH_VALUES];
+    size_t numStrategies;
+    long long sizes[MAX_BENCH_VALUES];  // Bytes of the generated inputs
+    size_t numSizes;
+    double skews[MAX_BENCH_VALUES];
+    size_t numSkews;
+    size_t numberOfPlayers;
+    int repeat; // Measured runs of every configuration
+    int warmup; // Runs discarded before measuring
+    const char *outputFileName; // JSON results (NULL for stdout)
+    const char *directory;  // Where the inputs are generated
+} BenchOptions;
 
-/* Creates and initializes a hash item for insertion into the hash table.
- * Handles collision by including a next pointer to chain items
- *
- * Collision handling is used because:
- * 1. Different player names may hash to the same index (hash collision)
- * 2. Collision handling avoid newer players overwriting previous ones
- * with the same hash
- */
-HashItem *createHashItem(char *key, int value) {
-    // Allocate memory for the hash item
-    HashItem *item = malloc(sizeof(HashItem));
-    if (item == NULL) {
-        perror("Failed to allocate memory for hash item.");
-        return NULL;
-    }
+/* Work of a thread of the incrementOrInsertHashItem microbenchmark */
+typedef struct MicrobenchThread {
+    HashTable *table;
+    char **keys;
+    size_t numKeys;
+} MicrobenchThread;
 
-    // Copy the key string into the allocated memory and append null terminator
-    item->key = strdup(key);
-    if (item->key == NULL) {
-        perror("Failed to allocate memory for hash item key.");
-        free(item);
-        return NULL;
-    }
+// Keys added by every timed addBatch call of the stress command
+#define STRESS_BATCH_SIZE 64
 
-    // Set initial value (mvp count) and next pointer for collision handling
-    item->value = value;
-    item->next = NULL;
+/* Adversarial distributions of keys of the stress command */
+typedef enum StressDistribution {
+    STRESS_SINGLE_KEY,  // Every line has the same MVP
+    STRESS_DISTINCT_KEYS,   // Every line has a different MVP
+    STRESS_COLLIDING_KEYS,  // A few MVPs that all fall in the same bucket
+    NUMBER_OF_STRESS_DISTRIBUTIONS
+} StressDistribution;
 
-    return item;
-}
+/* Work of a thread of the stress command and the latency of its batches */
+typedef struct StressThread {
+    const AggregationStrategy *strategy;
+    void *state;
+    int tid;
+    char **keys;
+    size_t numKeys;
+    double *latencies;  // Seconds of every batch
+    size_t numBatches;
+} StressThread;
 
-/* Generate a hash value for a given key using a polynomial rolling hash. */
-unsigned int hashGenerator(char *key, int size) {
-    unsigned int hashValue = 0;
-    for (size_t i = 0; key[i] != '\0'; i++) {
-        // Multiply by 31, add current char, and keep within bounds with modulo
-        hashValue = (hashValue * 31 + key[i]) % size;
-    }
+/* Options of the verify command: the sweep of strategies, threads, sizes and
+ * skews (parsed like the bench options) and the real inputs */
+typedef struct VerifyOptions {
+    BenchOptions sweep;
+    char **inputs;  // Real input files
+    size_t numInputs;
+    const char *expectedFileName;   // Report expected for the first input (or NULL)
+} VerifyOptions;
 
-    return hashValue;
-}
+/* A variant of the count checked by verify, with its own reference */
+typedef struct VerifyVariant {
+    const char *name;
+    ParserQuery query;
+    int dedup;
+    int perFile;    // The input twice, each copy in a group of its own
+    int snapshot;   // The reference loaded as a snapshot in a second group
+    int report; // The result written as a report and read back
+} VerifyVariant;
 
-/* Increments count for an existing key or inserts new item in the hash table.
- * This function is thread-safe by using mutex locking and unlocking. */
-void incrementOrInsertHashItem(HashTable *table, char *key, int value) {
-    // Calculates item index for this key
-    unsigned int index = hashGenerator(key, table->size);
+// Maximum number of columns of the columnar store (a line with more fields
+// is an error)
+#define MAX_STORE_COLUMNS 16
 
-    // Lock mutex to prevent race conditions on the shared hash table
-    // Lock the entire table since it has to look for the key and navigate
-    // the chain, determine if it should increment or add another item
-    // all of this has to be done in a single lock since is an atomic operation
-    pthread_mutex_lock(&tableMutex);
+// Slot of the store with the last field of every line, whatever its column
+#define LAST_STORE_COLUMN MAX_STORE_COLUMNS
 
-    // Search for the key
-    HashItem *current = table->items[index];
-    while (current != NULL) {
-        // check if the key already exists in the hash table
-        if (strcmp(current->key, key) == 0) {
-            // Key found, increment his value by 1
-            current->value += 1;
+// Buckets of a column dictionary when it is created, they double as it fills
+#define INITIAL_DICTIONARY_SIZE 64
 
-            // Unlock the mutex to allow other threads to access the table
-            pthread_mutex_unlock(&tableMutex);
-            return;
-        }
-        // Moves to the next item in chain
-        current = current->next;
-    }
+// Fewer rows than this per thread are counted by fewer threads
+#define MIN_STORE_ROWS_PER_THREAD 65536
 
-    // Key doesn't exist so create a new item with the provided key and value
-    HashItem *newItem = createHashItem(key, value);
-    if (newItem == NULL) {
-        perror("Failed to create a hash item.");
-        pthread_mutex_unlock(&tableMutex);
-        return;
-    }
+// Columns of the clubs and of the score in the matches
+#define DEFAULT_HOME_COLUMN 1
+#define DEFAULT_AWAY_COLUMN 2
+#define DEFAULT_SCORE_COLUMN 3
 
-    // Insert the new item at the beginning of the collision chaiun
-    newItem->next = table->items[index];
-    table->items[index] = newItem;
-    table->count++;
+/* Distinct values of a column of the columnar store. Every value gets a
+ * dense id (its index in values), the table maps a value to its id */
+typedef struct ColumnDictionary {
+    HashTable *ids;
+    char **values;  // Keys owned by the table, indexed by id
+    size_t count;
+    size_t capacity;
+} ColumnDictionary;
 
-    // Unlock the mutex to allow other threads to access the table
-    pthread_mutex_unlock(&tableMutex);
-}
+/* The inputs parsed once into columns (dictionary encoded): every field is
+ * the id of its value in the dictionary of the column (-1 when the line has
+ * fewer fields) and the score is parsed into the goals of each side. The
+ * slot LAST_STORE_COLUMN has the last field of every line, as the count
+ * reads it, so lines with a different number of fields agree on it. Queries
+ * over the store are loops over the id arrays, without touching strings */
+typedef struct ColumnStore {
+    size_t numRows;
+    size_t capacity;
+    int numColumns; // Columns 0 to numColumns - 1 (besides LAST_STORE_COLUMN)
+    int *columns[MAX_STORE_COLUMNS + 1];    // numRows ids per column (NULL if unused)
+    ColumnDictionary dictionaries[MAX_STORE_COLUMNS + 1];
+    int scoreColumn;    // Column with the <home>-<away> score
+    short *homeGoals;   // -1 when the score can't be parsed
+    short *awayGoals;
+} ColumnStore;
 
-/* Counts visible UTF-8 characters (not bytes) so it handles multibyte chars
- * to avoid displacing the columns in the report. (happens with
- * characters like ñ, á, é, ü, etc.) */
-int countVisibleCharacters(const char *str) {
-    int count = 0;
-    int i = 0;
+/* A thread building the part of the store of its work units */
+typedef struct StoreBuildThread {
+    ThreadData *work;   // Units assigned to the thread
+    ColumnStore part;
+    char delimiter;
+    int status;
+} StoreBuildThread;
 
-    // Iterate through the string and count visible characters
-    while (str[i] != '\0') {
-        // Check if the current byte is the start of a multibyte character
-        if ((str[i] & 0xC0) != 0x80) {
-            count++;
-        }
-        i++;
-    }
+/* A thread counting the values of a column in a range of rows */
+typedef struct StoreCountThread {
+    const ColumnStore *store;
+    int column;
+    int filterColumn;   // -1 means no filter
+    const unsigned char *keep;  // Ids of the filter column that are kept
+    size_t startRow;
+    size_t endRow;
+    int *counts;    // Rows per id of the column
+} StoreCountThread;
 
-    return count;
-}
+// Maximum number of items of every clause of a query (SELECT, WHERE...)
+#define MAX_QUERY_ITEMS 8
 
-/* Writes a report of players sorted by their MVP counts (descending)
- * return 0 on success or -1 on error */
-int writeReportOfPlayersSortedByMVPCount(HashTable *table) {
+// Maximum number of tokens of a query and of bytes of a token
+#define MAX_QUERY_TOKENS 128
+#define MAX_QUERY_TOKEN_LENGTH 128
 
-    // Allocate memory for an array to hold items for sorting
-    SortableItem *sortedItems = malloc(table->count * sizeof(SortableItem));
-    if (sortedItems == NULL) {
-        return -1;
-    }
+// Bits of the key of a group of a query: the ids of its GROUP BY columns
+// packed together, all ones marks a free slot of the table of groups
+#define QUERY_GROUP_KEY_BITS 63
+#define QUERY_EMPTY_GROUP UINT64_MAX
 
+// Initial number of slots of the table of groups of every thread
+#define QUERY_GROUPS_CAPACITY 1024
 
-    // Copy all hash table entries to the sortable array (including collisions)
-    int itemIndex = 0;
-    for (size_t i = 0; i < table->size; i++) {
-        HashItem *current = table->items[i];
+/* A thread attributing the awards of a range of rows to the clubs and sides */
+typedef struct TeamThread {
+    const ColumnStore *store;
+    int homeColumn;
+    int awayColumn;
+    int mvpColumn;
+    int filterColumn;   // -1 means no filter
+    const unsigned char *keep;  // Ids of the filter column that are kept
+    const int *homeClubs;   // Club of every id of the home column
+    const int *awayClubs;   // Club of every id of the away column
+    const int *playerClubs; // Club of every MVP id given by a file (or NULL)
+    size_t startRow;
+    size_t endRow;
+    int *clubCounts;    // Home and away awards of every club
+    int *playerCounts;  // Home, away and total awards of every MVP
+    long unknownSide;   // Awards whose side can't be told
+} TeamThread;
 
-        // Process all entries in this hash item collision chain
-        while (current != NULL) {
-            sortedItems[itemIndex].key = current->key;
-            sortedItems[itemIndex].value = current->value;
-            itemIndex++;
+/* Awards of a club or of a player by side, to sort the team reports */
+typedef struct TeamItem {
+    const char *name;
+    int awards;
+    int home;
+    int away;
+} TeamItem;
 
-            // Move to the next item in the collision chain
-            current = current->next;
-        }
-    }
+/* Kinds of values a query can refer to */
+typedef enum QueryValueKind {
+    QUERY_TEXT, // A column of the store
+    QUERY_HOME_GOALS,
+    QUERY_AWAY_GOALS,
+    QUERY_GOALS,    // Goals of both sides
+} QueryValueKind;
 
-    // Sort by MVP count (descending)
-    qsort(sortedItems, table->count, sizeof(SortableItem), compareByMVPCounts);
+/* A value referred by a query: a column of the store or the goals */
+typedef struct QueryValue {
+    QueryValueKind kind;
+    int column; // Column of a QUERY_TEXT (-1 means the last one)
+} QueryValue;
 
-    // Write the sorted result to reporte_mvp.txt
-    FILE *fptr;
-    fptr = fopen("reporte_mvp.txt", "w");
-    if (fptr == NULL) {
-        perror("Error creating report file");
-        free(sortedItems);
-        return -1;
-    }
+/* Name of a value in the queries */
+typedef struct QueryValueName {
+    const char *name;
+    QueryValue value;
+} QueryValueName;
 
-    // Report header
-    fprintf(fptr, "Jugador MVP%*s|\tPremios\n", 13, "");
-    fprintf(fptr, "-----------------------------------\n");
+/* Operators of the conditions of WHERE */
+typedef enum QueryOperator {
+    QUERY_EQUAL,
+    QUERY_NOT_EQUAL,
+    QUERY_LESS,
+    QUERY_LESS_EQUAL,
+    QUERY_GREATER,
+    QUERY_GREATER_EQUAL,
+    QUERY_LIKE,
+} QueryOperator;
 
-    // Write each entry procuring aligned columns
-    for (size_t i = 0; i < table->count; i++) {
-        char buffer[100] = {0};
-        strcpy(buffer, sortedItems[i].key);
+/* Aggregates of the items of SELECT */
+typedef enum QueryAggregate {
+    QUERY_NO_AGGREGATE, // A GROUP BY column
+    QUERY_COUNT,
+    QUERY_SUM,
+} QueryAggregate;
 
-        // Count the visible characters (not bytes) in the player name
-        int visibleCharacters = countVisibleCharacters(buffer);
+/* An item of SELECT */
+typedef struct QuerySelectItem {
+    QueryAggregate aggregate;
+    QueryValue value;   // Column shown or goals added up
+    int index;  // Index of its GROUP BY column or of its sums
+    char name[MAX_QUERY_TOKEN_LENGTH];  // Text of the item, for the header
+} QuerySelectItem;
 
-        // Pad player name with spaces so all names have the same display width
-        for (size_t j = visibleCharacters; j < 24; j++) {
-            strcat(buffer, " ");
-        }
+/* A condition of WHERE, a text column is compiled to the ids that pass it */
+typedef struct QueryCondition {
+    QueryValue value;
+    QueryOperator operator;
+    char text[MAX_QUERY_TOKEN_LENGTH];  // Literal compared with a column
+    long number;    // Literal compared with the goals
+    unsigned char *keep;    // Ids of the column that pass (once compiled)
+} QueryCondition;
 
-        fprintf(fptr, "%s|\t%d\n", buffer, sortedItems[i].value);
-    }
+/* A key of ORDER BY */
+typedef struct QueryOrder {
+    int item;   // Index of the SELECT item
+    int descending;
+} QueryOrder;
 
-    fclose(fptr);
-    free(sortedItems);
+/* A query of the query command: SELECT ... [WHERE ...] [GROUP BY ...]
+ * [ORDER BY ...] [LIMIT n], compiled against a columnar store */
+typedef struct SelectQuery {
+    QuerySelectItem select[MAX_QUERY_ITEMS];
+    size_t numSelect;
+    QueryCondition where[MAX_QUERY_ITEMS];
+    size_t numWhere;
+    QueryValue groupBy[MAX_QUERY_ITEMS];
+    size_t numGroupBy;
+    QueryOrder orderBy[MAX_QUERY_ITEMS];
+    size_t numOrderBy;
+    long limit; // -1 means no limit
+    size_t numSums;
+    int groupColumns[MAX_QUERY_ITEMS];  // Columns of the store of GROUP BY
+    int groupShifts[MAX_QUERY_ITEMS];   // Position of their ids in the key of a group
+    int groupBits[MAX_QUERY_ITEMS]; // Bits of their ids in the key of a group
+} SelectQuery;
 
-    return 0;
-}
+/* A token of a query: a word, a symbol or a quoted string */
+typedef struct QueryToken {
+    int isString;
+    char text[MAX_QUERY_TOKEN_LENGTH];
+} QueryToken;
 
-/* Frees the memory allocated for the hash table and its items */
-void freeHashTable(HashTable *table) {
-    if (table == NULL) {
-        return;
-    }
+/* The tokens of a query and the next one to parse */
+typedef struct QueryParser {
+    QueryToken tokens[MAX_QUERY_TOKENS];
+    size_t numTokens;
+    size_t position;
+} QueryParser;
 
-    // Free each item in the hash table (including collisions)
-    for (size_t i = 0; i < table->size; i++) {
-        HashItem *item = table->items[i];
+/* Accumulators of the groups of a query: an open addressing table keyed by
+ * the packed ids of the GROUP BY columns, so only the groups that have rows
+ * take memory */
+typedef struct QueryGroups {
+    uint64_t *keys; // Key of every slot (QUERY_EMPTY_GROUP if free)
+    long *counts;   // Rows of every slot
+    long *sums; // numSums goals of every slot
+    size_t numSums;
+    size_t capacity;    // Power of two
+    size_t count;
+} QueryGroups;
 
-        while (item != NULL) {
-            // Save reference to current item before moving to next
-            HashItem *temp = item;
-            item = item->next;
+/* A thread running the operators of a query over a range of rows */
+typedef struct QueryThread {
+    const ColumnStore *store;
+    const SelectQuery *query;
+    size_t startRow;
+    size_t endRow;
+    QueryGroups groups;
+    int failed; // The thread couldn't allocate memory, its groups are incomplete
+} QueryThread;
 
-            // Free the item key and the item itself
-            free(temp->key);
-            free(temp);
-        }
-    }
-    // Free the array of item pointers and the hash table itself
-    free(table->items);
-    free(table);
-}
+/* A row of the result of a query */
+typedef struct QueryRow {
+    const SelectQuery *query;   // For the ORDER BY comparison
+    uint64_t group; // Key of the group
+    const char *texts[MAX_QUERY_ITEMS];
+    long numbers[MAX_QUERY_ITEMS];
+} QueryRow;
 
-/* Extract player names from a specific range of lines in a file
- * returns an array of player names (strings) or NULL on error */
-char **extractMVPNamesFromLineRange(const char *fileName, int startLine, int endLine) {
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL) {
+/* State of the striped strategy: a shared table and a mutex per stripe */
+typedef struct StripedState {
+    HashTable *table;
+    pthread_mutex_t stripes[NUMBER_OF_STRIPES];
+} StripedState;
+
+/* State of the thread-local strategy: a private table per thread that is
+ * merged into the global table at the end */
+typedef struct LocalState {
+    HashTable **localTables;
+    int numberOfThreads;
+    HashTable *table;
+} LocalState;
+
+/* A monitored player in a Space-Saving sketch.
+ * The counters are kept in a min-heap (by count) and chained by hash */
+typedef struct SketchCounter {
+    char *key;
+    int value;  // Estimated count (upper bound)
+    size_t heapIndex;   // Position in the min-heap
+    struct SketchCounter *next; // Next counter in the same bucket
+} SketchCounter;
+
+/* Space-Saving sketch owned by a single thread */
+typedef struct Sketch {
+    SketchCounter *counters;    // Preallocated counters
+    SketchCounter **heap;   // Min-heap of used counters ordered by value
+    SketchCounter **buckets;    // Hash index of used counters
+    size_t capacity;
+    size_t used;
+} Sketch;
+
+/* State of the sketch strategy: a sketch per thread and the merged table */
+typedef struct SketchState {
+    Sketch *sketches;
+    int numberOfThreads;
+    HashTable *table;
+} SketchState;
+
+/* Growable array of items used to collect an aggregation for sorting */
+typedef struct SortableList {
+    SortableItem *items;
+    size_t count;
+    size_t capacity;
+} SortableList;
+
+/* Buffers kept from one run to the next with --repeat, so the warm runs
+ * don't allocate them again */
+typedef struct RunScratch {
+    int enabled;    // Keep the buffers after a run (only with --repeat)
+    char **keys;    // KEY_BATCH_SIZE keys per thread
+    char *keyBuffers;   // KEY_BUFFER_SIZE bytes per thread
+    int numberOfThreads;    // Threads the key buffers have room for
+    SortableList sortList;  // Items sorted to write the report
+} RunScratch;
+
+// Function forward declarations
+int countVisibleCharacters(const char *str);
+
+int ceilDivision(int numerator, int divisor);
+
+int getLineCountFromFile(const char *fileName);
+
+unsigned int hashGenerator(char *key, int size);
+
+HashTable *createHashTable(int size);
+
+HashItem *createHashItem(char *key, int value);
+
+int addToHashItem(HashTable *table, char *key, int value);
+
+void incrementOrInsertHashItem(HashTable *table, char *key, int value);
+
+void iterateHashTable(HashTable *table, ItemVisitor visit, void *context);
+
+void freeHashTable(HashTable *table);
+
+HashTable *createArenaHashTable(int size, int numArenas);
+
+HashItem *allocateHashItem(HashTable *table, int arena, char *key, int value);
+
+void freeHashItems(HashTable *table);
+
+void resetHashTable(HashTable *table);
+
+void *arenaAllocate(Arena *arena, size_t size);
+
+void resetArena(Arena *arena);
+
+void freeArena(Arena *arena);
+
+const AggregationStrategy *findStrategy(const char *name);
+
+void *mutexInit(size_t capacity, int numberOfThreads);
+
+void mutexAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+
+void mutexMerge(void *state);
+
+void mutexIterate(void *state, ItemVisitor visit, void *context);
+
+void mutexDestroy(void *state);
+
+HashTable *mutexResultTable(void *state);
+
+void mutexReset(void *state);
+
+void *stripedInit(size_t capacity, int numberOfThreads);
+
+void stripedAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+
+void stripedMerge(void *state);
+
+void stripedIterate(void *state, ItemVisitor visit, void *context);
+
+void stripedDestroy(void *state);
+
+HashTable *stripedResultTable(void *state);
+
+void stripedReset(void *state);
+
+void *localInit(size_t capacity, int numberOfThreads);
+
+void localAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+
+void localMerge(void *state);
+
+void localIterate(void *state, ItemVisitor visit, void *context);
+
+void localDestroy(void *state);
+
+HashTable *localResultTable(void *state);
+
+void localReset(void *state);
+
+void *lockFreeInit(size_t capacity, int numberOfThreads);
+
+void lockFreeAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+
+void lockFreeMerge(void *state);
+
+void lockFreeIterate(void *state, ItemVisitor visit, void *context);
+
+void lockFreeDestroy(void *state);
+
+HashTable *lockFreeResultTable(void *state);
+
+void lockFreeReset(void *state);
+
+void *sketchInit(size_t capacity, int numberOfThreads);
+
+void sketchAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys);
+
+void sketchMerge(void *state);
+
+void sketchIterate(void *state, ItemVisitor visit, void *context);
+
+void sketchDestroy(void *state);
+
+HashTable *sketchResultTable(void *state);
+
+void sketchReset(void *state);
+
+void sketchSwap(Sketch *sketch, size_t a, size_t b);
+
+void sketchSiftDown(Sketch *sketch, size_t index);
+
+void sketchSiftUp(Sketch *sketch, size_t index);
+
+void sketchAdd(Sketch *sketch, char *key, int value);
+
+int openLineReader(LineReader *reader, const char *fileName, long startOffset, long endOffset);
+
+#define DECLARE_PARSER_VARIANT(name, column, filterColumn, delimiter) \
+    size_t extractKeys##name(LineReader *reader, const ParserQuery *query, \
+                             char **keys, char *keyBuffer, size_t maxKeys, int *finished);
+PARSER_VARIANTS(DECLARE_PARSER_VARIANT)
+#undef DECLARE_PARSER_VARIANT
+
+size_t extractKeysGeneric(LineReader *reader, const ParserQuery *query,
+                          char **keys, char *keyBuffer, size_t maxKeys, int *finished);
+
+const ParserVariant *selectParserVariant(const ParserQuery *query);
+
+int parseFilter(const char *argument, ParserQuery *query);
+
+int compareByMVPCounts(const void *a, const void *b);
+
+void appendSortableItem(const char *key, int value, void *context);
+
+int writeReportOfPlayersSortedByMVPCount(const AggregationStrategy *strategy, void *state, const char *reportFileName);
+
+void writeReportLine(FILE *file, const char *key, int value);
+
+void printUsage(const char *programName);
+
+int runCountCommand(int argc, char *argv[]);
+
+int runDiffCommand(int argc, char *argv[], const char *programName);
+
+int parseProgramOptions(int argc, char *argv[], ProgramOptions *options);
+
+int runGenerateCommand(int argc, char *argv[], const char *programName);
+
+int parseGeneratorOptions(int argc, char *argv[], GeneratorOptions *options);
+
+int runBenchCommand(int argc, char *argv[], const char *programName);
+
+int parseBenchOptions(int argc, char *argv[], BenchOptions *options);
+
+int splitList(char *argument, char **items, size_t maxItems, size_t *numItems);
+
+int parseThreadList(char *argument, int *threads, size_t *numThreads);
+
+int parseStrategyList(char *argument, const AggregationStrategy **selected, size_t *numStrategies);
+
+int compareDoubles(const void *a, const void *b);
+
+int runMicrobenchCommand(int argc, char *argv[], const char *programName);
+
+unsigned int hashFnv1a(char *key, int size);
+
+void sortByCountsDescending(SortableItem *items, size_t count);
+
+void *incrementKeysThread(void *arg);
+
+void printMicrobenchResult(const char *name, double seconds, long operations);
+
+int runVerifyCommand(int argc, char *argv[], const char *programName);
+
+int parseVerifyOptions(int argc, char *argv[], VerifyOptions *options);
+
+int verifyInput(const VerifyOptions *options, const char *fileName, const char *expectedFileName);
+
+size_t verifyVariant(const VerifyVariant *variant, const AggregationStrategy *strategy, int numberOfThreads,
+                     const char *fileName, HashTable *reference, const char *snapshotFileName,
+                     const char *reportFileName);
+
+int writeLongKeyInput(const char *fileName);
+
+HashTable *countReference(const char *fileName, const ParserQuery *query, int dedup);
+
+const char *findReferenceField(const char *line, int column, size_t *length);
+
+HashTable *loadReport(const char *fileName);
+
+void addTrimmedItem(const char *key, int value, void *context);
+
+size_t countTableDifferences(HashTable *expected, HashTable *actual);
+
+int runStressCommand(int argc, char *argv[], const char *programName);
+
+char **buildStressKeys(StressDistribution distribution, size_t numKeys, size_t numCollisions, char **storage);
+
+int stressConfiguration(const AggregationStrategy *strategy, int numberOfThreads, char **keys, size_t numKeys,
+                        double *seconds, double *latencies);
+
+void *addStressBatches(void *arg);
+
+int runReportsCommand(int argc, char *argv[], const char *programName);
+
+void initColumnStore(ColumnStore *store, int scoreColumn);
+
+void freeColumnStore(ColumnStore *store);
+
+void freeColumnDictionary(ColumnDictionary *dictionary);
+
+int internColumnValue(ColumnDictionary *dictionary, char *value);
+
+int growColumnDictionary(ColumnDictionary *dictionary);
+
+int reserveStoreRows(ColumnStore *store, size_t numRows);
+
+int addStoreColumn(ColumnStore *store);
+
+int createStoreColumn(ColumnStore *store, int column);
+
+int addStoreRow(ColumnStore *store, char *line, char delimiter);
+
+void parseScore(const char *field, short *homeGoals, short *awayGoals);
+
+void *buildStorePart(void *arg);
+
+int appendColumnStore(ColumnStore *store, ColumnStore *part);
+
+int buildColumnStore(ColumnStore *store, InputList *inputList, char delimiter, int scoreColumn,
+                     int numberOfThreads);
+
+int resolveStoreColumn(const ColumnStore *store, int column);
+
+int countStoreThreads(const ColumnStore *store, int numberOfThreads);
+
+unsigned char *matchStorePrefix(const ColumnStore *store, int column, const char *prefix, size_t length);
+
+int *countStoreColumn(const ColumnStore *store, int column, int filterColumn, const unsigned char *keep,
+                      int numberOfThreads);
+
+void *countStoreRows(void *arg);
+
+int writeStoreReport(const ColumnStore *store, int column, const int *counts, const char *reportFileName);
+
+int writeTeamReports(const ColumnStore *store, int filterColumn, const unsigned char *keep,
+                     const char *playerClubsFileName, char delimiter, int numberOfThreads);
+
+int *loadPlayerClubs(const char *fileName, const ColumnDictionary *players, ColumnDictionary *clubs,
+                     char delimiter);
+
+void *attributeTeamAwards(void *arg);
+
+int compareTeamItems(const void *a, const void *b);
+
+int writeTeamReport(const char *reportFileName, const char *label, TeamItem *items, size_t numItems,
+                    long unknownSide);
+
+int runQueryCommand(int argc, char *argv[], const char *programName);
+
+int tokenizeQuery(const char *text, QueryParser *parser);
+
+int acceptQueryToken(QueryParser *parser, const char *text);
+
+int parseQueryValue(QueryParser *parser, QueryValue *value);
+
+int parseSelectItem(QueryParser *parser, QuerySelectItem *item);
+
+int parseQueryCondition(QueryParser *parser, QueryCondition *condition);
+
+int parseSelectQuery(const char *text, SelectQuery *query);
+
+int compileSelectQuery(SelectQuery *query, const ColumnStore *store);
+
+int resolveQueryColumn(const ColumnStore *store, int column, int lastColumn);
+
+void freeSelectQuery(SelectQuery *query);
+
+int matchLikePattern(const char *value, const char *pattern);
+
+QueryRow *executeSelectQuery(const SelectQuery *query, const ColumnStore *store, int numberOfThreads,
+                             size_t *numRows, size_t *numGroups);
+
+int initQueryGroups(QueryGroups *groups, size_t numSums);
+
+long findQueryGroup(QueryGroups *groups, uint64_t key);
+
+void freeQueryGroups(QueryGroups *groups);
+
+void *runQueryOperators(void *arg);
+
+size_t filterQueryBatch(const ColumnStore *store, const QueryCondition *condition, size_t *selection,
+                        size_t numSelected);
+
+size_t groupQueryBatch(const ColumnStore *store, const SelectQuery *query, size_t *selection, uint64_t *groups,
+                       size_t numSelected);
+
+int compareQueryRows(const void *a, const void *b);
+
+void writeQueryResult(FILE *file, const SelectQuery *query, const QueryRow *rows, size_t numRows);
+
+int benchConfiguration(const BenchOptions *options, const char *fileName, const AggregationStrategy *strategy,
+                       int numberOfThreads, double *seconds);
+
+long long parseByteSize(const char *argument);
+
+uint64_t splitMix64(uint64_t *state);
+
+uint64_t xorShift64Star(uint64_t *state);
+
+double nextRandomDouble(uint64_t *state);
+
+size_t buildPlayerName(size_t index, int accented, char *buffer);
+
+double *buildZipfTable(size_t numberOfPlayers, double skew);
+
+size_t sampleZipf(const double *cumulative, size_t numberOfPlayers, double uniform);
+
+int generateInputFile(const GeneratorOptions *options);
+
+int addInputFile(InputList *list, const char *path, int group);
+
+int addInputPath(InputList *list, const char *path, int group);
+
+void **countInputs(InputList *inputList, ProgramOptions *options, size_t numGroups);
+
+int *countInputLines(InputList *list, size_t numGroups);
+
+void **createStates(const AggregationStrategy *strategy, const int *groupLineCounts,
+                    size_t numGroups, int numberOfThreads);
+
+void destroyStates(const AggregationStrategy *strategy, void **states, size_t numStates);
+
+void resetStates(const AggregationStrategy *strategy, void **states, size_t numStates);
+
+int writeCountReports(const AggregationStrategy *strategy, void **states, size_t numGroups,
+                      InputList *inputList, int perFile, int incomplete);
+
+int reserveKeyBuffers(int numberOfThreads);
+
+void releaseKeyBuffers(void);
+
+long countAllocations(void);
+
+void resetRunStatistics(void);
+
+int aggregateInputs(InputList *inputList, ProgramOptions *options, void **states, size_t numGroups);
+
+double nowSeconds(void);
+
+double startPhaseTime(void);
+
+void addPhaseTime(Phase phase, double startSeconds);
+
+void printStatistics(InputList *inputList);
+
+void lockMutex(pthread_mutex_t *mutex, int lockId);
+
+void addLockStats(LockStats *total, const LockStats *lockStats);
+
+void printLockStatistics(void);
+
+void addMemoryUsage(MemorySubsystem subsystem, long bytes);
+
+void addAllocation(MemorySubsystem subsystem);
+
+void *trackedMalloc(MemorySubsystem subsystem, size_t size);
+
+void *trackedCalloc(MemorySubsystem subsystem, size_t count, size_t size);
+
+void *trackedRealloc(MemorySubsystem subsystem, void *pointer, size_t oldSize, size_t newSize);
+
+char *trackedStrdup(MemorySubsystem subsystem, const char *string);
+
+void trackedFree(MemorySubsystem subsystem, void *pointer, size_t size);
+
+void trackedFreeString(MemorySubsystem subsystem, char *string);
+
+void printMemoryStatistics(void);
+
+int startProgressMonitor(ProgressMonitor *monitor, pthread_t *thread, ThreadData *threadData, int numberOfThreads);
+
+void stopProgressMonitor(ProgressMonitor *monitor, pthread_t thread);
+
+void *reportProgress(void *arg);
+
+void printProgressLine(ProgressMonitor *monitor, const char *end);
+
+int startDeadlineTimer(DeadlineTimer *timer, pthread_t *thread, long milliseconds);
+
+void stopDeadlineTimer(DeadlineTimer *timer, pthread_t thread);
+
+void *waitForDeadline(void *arg);
+
+int appendIncompleteMarker(const char *reportFileName, long scannedBytes, long totalBytes);
+
+void addGroupScannedBytes(ThreadData *threadData, const WorkUnit *unit, long bytes);
+
+void releaseDeadlineGroups(void);
+
+void printHashTableDiagnostics(HashTable *table, const char *label);
+
+int openPerfSession(PerfSession *session);
+
+void setPerfSessionEnabled(PerfSession *session, int enabled);
+
+void readPerfSession(PerfSession *session, PerfCounters *counters);
+
+void closePerfSession(PerfSession *session);
+
+void printPerfReport(void);
+
+TraceRing *addTraceRing(const char *name);
+
+void traceEvent(const char *name, double startSeconds, double endSeconds);
+
+int writeTraceFile(void);
+
+void freeTraceLog(void);
+
+uint64_t hashRecord(const char *data, size_t length, uint64_t seed);
+
+DedupFilter *createDedupFilter(InputList *inputList);
+
+int isDuplicateRecord(DedupFilter *filter, int fileIndex, long offset, const char *line, size_t length,
+                      size_t recordLength);
+
+int isSameRecord(DedupFilter *filter, uint64_t location, int fileIndex, long offset, const char *line,
+                 size_t length, size_t recordLength);
+
+void freeDedupFilter(DedupFilter *filter);
+
+void writeSnapshotItem(const char *key, int value, void *context);
+
+int writeSnapshot(const AggregationStrategy *strategy, void *state, const char *snapshotFileName,
+                  const char *fingerprint);
+
+int isSnapshotFile(const char *path);
+
+int loadSnapshot(const AggregationStrategy *strategy, void *state, const char *snapshotFileName, int tid);
+
+char *buildCacheFingerprint(InputList *inputList, ProgramOptions *options);
+
+uint64_t hashSampledBlocks(const char *path, long size);
+
+uint64_t hashBytes(uint64_t hashValue, const unsigned char *bytes, size_t length);
+
+void **loadCacheEntry(const AggregationStrategy *strategy, const char *cacheFileName, const char *fingerprint,
+                      int numberOfThreads);
+
+int storeCacheEntry(const AggregationStrategy *strategy, void *state, const char *cacheFileName,
+                    const char *fingerprint);
+
+int hashWorkUnit(const char *path, const WorkUnit *unit, uint64_t seed, uint64_t *hashValue);
+
+uint64_t hashWords(uint64_t hashValue, const unsigned char *bytes, size_t length);
+
+WorkUnit *splitIntoContentBlocks(InputList *list, long blockSize, size_t *numUnits);
+
+int isContentBoundary(const char *line, long length, long blockSize);
+
+int loadMemoizedUnit(ThreadData *threadData, const WorkUnit *unit, void *state, char *memoFileName,
+                     size_t size, long *lines);
+
+int saveMemoizedUnit(ThreadData *threadData, const WorkUnit *unit, HashTable *partial, const char *memoFileName,
+                     long lines);
+
+HashItem *findHashItem(HashTable *table, char *key);
+
+void internDiffItem(const char *key, int value, void *context);
+
+int compareDiffEntries(const void *a, const void *b);
+
+void rankDiffEntries(DiffEntry *entries, size_t count, int side);
+
+int writeDiffReport(const AggregationStrategy *strategy, void *previousState, void *currentState,
+                    const char *reportFileName);
+
+int compareFileNames(const void *a, const void *b);
+
+void freeInputList(InputList *list);
+
+int compareWorkUnitsBySize(const void *a, const void *b);
+
+WorkUnit *splitIntoWorkUnits(InputList *list, int numberOfThreads, long fixedChunkSize, size_t *numUnits);
+
+WorkUnit *assignWorkUnits(WorkUnit *units, size_t numUnits, ThreadData *threadData, int numberOfThreads);
+
+void buildPerFileReportName(const InputList *list, size_t index, char *reportFileName, size_t size);
+
+int findFileStem(const char *path, const char **stem);
+
+int checkPerFileReportNames(const InputList *list);
+
+void *countPlayerOccurrences(void *arg);
+
+// Semaphores of the USDT probes
+MVP_PROBE_SEMAPHORE(chunk_start);
+MVP_PROBE_SEMAPHORE(chunk_end);
+MVP_PROBE_SEMAPHORE(key_insert);
+MVP_PROBE_SEMAPHORE(lock_wait);
+MVP_PROBE_SEMAPHORE(report_write_start);
+MVP_PROBE_SEMAPHORE(report_write_end);
+
+// Statistics of the run, only collected with --stats
+Statistics statistics = {0};
+
+// Lookup statistics of the current thread (NULL when they aren't collected)
+__thread LookupStats *threadLookupStats = NULL;
+
+// Lock statistics of the current thread (NULL when they aren't collected)
+__thread LockStats *threadLockStats = NULL;
+
+// Hardware counters of the run, only collected with --perf
+PerfReport perfReport = {0};
+
+// Deadline of the run, only set with --deadline
+DeadlineTimer deadlineTimer = {0};
+
+// Buffers reused by the runs of --repeat
+RunScratch runScratch = {0};
+
+// Events counted with --perf, in the order of the PERF_* indexes
+const PerfEvent perfEvents[NUMBER_OF_PERF_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"dTLB misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+// Trace of the run, only recorded with --trace
+TraceLog traceLog = {0};
+
+// Trace ring of the current thread (NULL when it isn't traced)
+__thread TraceRing *threadTraceRing = NULL;
+
+// Stages and clubs used for the synthetic matches of the generate command
+const char *generatorStages[] = {
+    "Grupo MD1", "Grupo MD2", "Grupo MD3", "Grupo MD4", "Grupo MD5", "Grupo MD6",
+    "Octavos", "Cuartos", "Semifinal", "Final"
+};
+const char *generatorClubs[] = {
+    "AC Milan", "Antwerp", "Arsenal", "Atlético de Madrid", "Barcelona", "Bayern", "Benfica", "Braga",
+    "Celtic", "Copenhagen", "Crvena zvezda", "Dortmund", "Feyenoord", "Galatasaray", "Inter", "Lazio",
+    "Leipzig", "Lens", "Man City", "Man United", "Napoli", "Newcastle", "PSV Eindhoven", "Paris",
+    "Porto", "Real Madrid", "Real Sociedad", "Salzburg", "Sevilla", "Shakhtar Donetsk", "Union Berlin",
+    "Young Boys"
+};
+
+// Syllables the synthetic player names are made of (consonant and vowel)
+const char *generatorSyllables[] = {
+    "ka", "lo", "mi", "ra", "to", "ne", "su", "vi", "do", "le", "ba", "ri", "na", "go", "pe", "zu"
+};
+
+// Variants of every check of verify: the default count first (the one
+// compared with --expected), then other columns, filters and modes
+const VerifyVariant verifyVariants[] = {
+    {"last column", {-1, ',', -1, NULL, 0}, 0, 0, 0, 0},
+    {"column=0", {0, ',', -1, NULL, 0}, 0, 0, 0, 0},
+    {"column=2", {2, ',', -1, NULL, 0}, 0, 0, 0, 0},
+    {"filter=0:Grupo", {-1, ',', 0, "Grupo", 5}, 0, 0, 0, 0},
+    {"column=1 filter=0:Final", {1, ',', 0, "Final", 5}, 0, 0, 0, 0},
+    {"dedup", {-1, ',', -1, NULL, 0}, 1, 0, 0, 0},
+    {"per-file", {-1, ',', -1, NULL, 0}, 0, 1, 0, 0},
+    {"snapshot", {-1, ',', -1, NULL, 0}, 0, 0, 1, 0},
+    {"report", {-1, ',', -1, NULL, 0}, 0, 0, 0, 1},
+};
+
+// Names of the columns of the matches and of the goals in the queries
+const QueryValueName queryValueNames[] = {
+    {"stage", {QUERY_TEXT, 0}},
+    {"home", {QUERY_TEXT, 1}},
+    {"away", {QUERY_TEXT, 2}},
+    {"score", {QUERY_TEXT, 3}},
+    {"mvp", {QUERY_TEXT, -1}},
+    {"home_goals", {QUERY_HOME_GOALS, 0}},
+    {"away_goals", {QUERY_AWAY_GOALS, 0}},
+    {"goals", {QUERY_GOALS, 0}},
+};
+
+// Names of the phases in the --stats breakdown
+const char *phaseNames[NUMBER_OF_PHASES] = {
+    "line counting", "scan (threads)", "merge", "sort", "report write"
+};
+
+// Names of the subsystems in the --stats memory breakdown
+const char *memorySubsystemNames[NUMBER_OF_MEMORY_SUBSYSTEMS] = {
+    "hash items", "keys", "bucket arrays", "name arrays", "parser buffers", "column arrays",
+    "item arenas"
+};
+
+// Available counting strategies, the first one is the default
+const AggregationStrategy strategies[] = {
+    {"mutex", "single table protected by a global mutex",
+     mutexInit, mutexAddBatch, mutexMerge, mutexIterate, mutexDestroy,
+     mutexResultTable, mutexReset},
+    {"striped", "single table with a mutex per stripe of buckets",
+     stripedInit, stripedAddBatch, stripedMerge, stripedIterate, stripedDestroy,
+     stripedResultTable, stripedReset},
+    {"local", "private table per thread merged at the end",
+     localInit, localAddBatch, localMerge, localIterate, localDestroy,
+     localResultTable, localReset},
+    {"lockfree", "single table updated with atomic operations",
+     lockFreeInit, lockFreeAddBatch, lockFreeMerge, lockFreeIterate, lockFreeDestroy,
+     lockFreeResultTable, lockFreeReset},
+    {"sketch", "Space-Saving sketch per thread (approximate counts)",
+     sketchInit, sketchAddBatch, sketchMerge, sketchIterate, sketchDestroy,
+     sketchResultTable, sketchReset},
+};
+
+#define NUMBER_OF_STRATEGIES (sizeof(strategies) / sizeof(strategies[0]))
+
+// Table of the specialized parser variants generated from PARSER_VARIANTS
+#define PARSER_VARIANT_ENTRY(name, column, filterColumn, delimiter) \
+    {#name, column, filterColumn, delimiter, extractKeys##name},
+const ParserVariant parserVariants[] = {
+    PARSER_VARIANTS(PARSER_VARIANT_ENTRY)
+};
+#undef PARSER_VARIANT_ENTRY
+
+#define NUMBER_OF_PARSER_VARIANTS (sizeof(parserVariants) / sizeof(parserVariants[0]))
+
+// Variant used for the shapes without a specialized one
+const ParserVariant genericParserVariant = {"Generic", 0, 0, 0, extractKeysGeneric};
+
+int main(int argc, char *argv[]) {
+    // The first argument may select another command, by default the program
+    // counts the MVPs of the inputs
+    if (argc > 1 && strcmp(argv[1], "diff") == 0) {
+        return runDiffCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "generate") == 0) {
+        return runGenerateCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return runBenchCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "microbench") == 0) {
+        return runMicrobenchCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "verify") == 0) {
+        return runVerifyCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "stress") == 0) {
+        return runStressCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "reports") == 0) {
+        return runReportsCommand(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && strcmp(argv[1], "query") == 0) {
+        return runQueryCommand(argc - 1, argv + 1, argv[0]);
+    }
+
+    return runCountCommand(argc, argv);
+}
+
+/* Counts the MVPs of the input files and writes the sorted report(s) */
+int runCountCommand(int argc, char *argv[]) {
+    ProgramOptions options;
+    if (parseProgramOptions(argc, argv, &options) == -1 || options.numInputs == 0) {
+        // Print message with instructions if the arguments are incorrect
+        printUsage(argv[0]);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+    const AggregationStrategy *strategy = options.strategy;
+    statistics.enabled = options.stats;
+    perfReport.enabled = options.perf;
+    if (options.traceFileName != NULL) {
+        traceLog.fileName = options.traceFileName;
+        traceLog.originSeconds = nowSeconds();
+        threadTraceRing = addTraceRing("main");
+    }
+    deadlineTimer.milliseconds = options.deadlineMilliseconds;
+    runScratch.enabled = options.repeat > 1;
+
+    // Expand the directories and collect the size of every input file. With
+    // --per-file every file is a group with its own state and report
+    InputList inputList = {NULL, 0, 0};
+    for (size_t i = 0; i < options.numInputs; i++) {
+        if (addInputPath(&inputList, options.inputs[i], 0) == -1) {
+            freeInputList(&inputList);
+            free(options.inputs);
+            return EXIT_FAILURE;
+        }
+    }
+    free(options.inputs);
+
+    size_t numGroups = 1;
+    if (options.perFile) {
+        numGroups = inputList.count;
+        for (size_t i = 0; i < inputList.count; i++) {
+            inputList.files[i].group = i;
+        }
+        if (checkPerFileReportNames(&inputList) == -1) {
+            freeInputList(&inputList);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The deadline counts from here, every phase spends from it
+    pthread_t deadlineThread;
+    if (options.deadlineMilliseconds > 0 &&
+        startDeadlineTimer(&deadlineTimer, &deadlineThread, options.deadlineMilliseconds) == -1) {
+        freeInputList(&inputList);
+        return EXIT_FAILURE;
+    }
+
+    // Reuse the aggregate of an identical previous run if it is cached
+    char *fingerprint = NULL;
+    char cacheFileName[4096];
+    void **states = NULL;
+    if (options.cacheDirName != NULL && !options.perFile) {
+        fingerprint = buildCacheFingerprint(&inputList, &options);
+        if (fingerprint != NULL) {
+            snprintf(cacheFileName, sizeof(cacheFileName), "%s/%016llx.snap", options.cacheDirName,
+                     (unsigned long long) hashBytes(14695981039346656037ULL, (unsigned char *) fingerprint,
+                                                    strlen(fingerprint)));
+            states = loadCacheEntry(strategy, cacheFileName, fingerprint, options.numberOfThreads);
+        }
+    }
+    int cached = states != NULL;
+
+    double runStart = statistics.enabled ? nowSeconds() : 0;
+    long runAllocations = countAllocations();
+    if (!cached) {
+        states = countInputs(&inputList, &options, numGroups);
+    }
+
+    // A cached result is complete, a scanned one is partial if the deadline
+    // stopped the threads
+    int incomplete = 0;
+    if (options.deadlineMilliseconds > 0) {
+        stopDeadlineTimer(&deadlineTimer, deadlineThread);
+        incomplete = !cached && deadlineTimer.expired && deadlineTimer.scannedBytes < deadlineTimer.totalBytes;
+    }
+    if (states == NULL) {
+        free(fingerprint);
+        freeInputList(&inputList);
+        releaseKeyBuffers();
+        releaseDeadlineGroups();
+        return EXIT_FAILURE;
+    }
+    if (incomplete) {
+        fprintf(stderr, "Deadline of %ld ms reached: %ld of %ld bytes processed, the report is incomplete.\n",
+                options.deadlineMilliseconds, deadlineTimer.scannedBytes, deadlineTimer.totalBytes);
+    }
+
+    // The entry is only stored if the inputs didn't change while scanning
+    if (fingerprint != NULL && !cached && !incomplete) {
+        char *fingerprintAfter = buildCacheFingerprint(&inputList, &options);
+        if (fingerprintAfter != NULL && strcmp(fingerprint, fingerprintAfter) == 0) {
+            storeCacheEntry(strategy, states[0], cacheFileName, fingerprint);
+        }
+        free(fingerprintAfter);
+    }
+    free(fingerprint);
+
+    // Write the results in sorted order, to reporte_mvp.txt or to a report
+    // per file
+    int status = writeCountReports(strategy, states, numGroups, &inputList, options.perFile, incomplete);
+
+    // The later runs of --repeat count again into the states of the first
+    // one, emptied instead of freed, and report what every run allocated
+    for (int run = 2; run <= options.repeat && status == EXIT_SUCCESS; run++) {
+        if (statistics.enabled) {
+            fprintf(stderr, "Run %d: %.3f ms, %ld tracked allocations\n", run - 1,
+                    (nowSeconds() - runStart) * 1e3, countAllocations() - runAllocations);
+            resetRunStatistics();
+        }
+        runStart = statistics.enabled ? nowSeconds() : 0;
+        runAllocations = countAllocations();
+
+        resetStates(strategy, states, numGroups);
+        if (aggregateInputs(&inputList, &options, states, numGroups) == -1) {
+            fprintf(stderr, "Error while counting the run %d.\n", run);
+            status = EXIT_FAILURE;
+        } else {
+            status = writeCountReports(strategy, states, numGroups, &inputList, options.perFile, 0);
+        }
+    }
+    if (options.repeat > 1 && statistics.enabled) {
+        fprintf(stderr, "Run %d: %.3f ms, %ld tracked allocations\n", options.repeat,
+                (nowSeconds() - runStart) * 1e3, countAllocations() - runAllocations);
+    }
+
+    // Save the combined aggregate so it can be compared later with diff, a
+    // partial one would look complete there
+    if (incomplete && options.snapshotFileName != NULL) {
+        fprintf(stderr, "The snapshot isn't saved, the run is incomplete.\n");
+    } else if (options.snapshotFileName != NULL && !options.perFile &&
+        writeSnapshot(strategy, states[0], options.snapshotFileName, NULL) == -1) {
+        fprintf(stderr, "Error while writing the snapshot.\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (statistics.enabled) {
+        if (options.repeat > 1) {
+            fprintf(stderr, "\nStatistics of the last run (%d of %d).\n", options.repeat, options.repeat);
+        }
+        printStatistics(&inputList);
+        for (size_t i = 0; i < numGroups; i++) {
+            printHashTableDiagnostics(strategy->resultTable(states[i]),
+                                      options.perFile ? inputList.files[i].path : "combined");
+        }
+        printMemoryStatistics();
+    }
+    if (perfReport.enabled) {
+        printPerfReport();
+    }
+    if (traceLog.fileName != NULL) {
+        if (writeTraceFile() == -1) {
+            fprintf(stderr, "Error while writing the trace file.\n");
+            status = EXIT_FAILURE;
+        }
+        freeTraceLog();
+    }
+
+    // Clean up resources
+    destroyStates(strategy, states, numGroups);
+    freeInputList(&inputList);
+    releaseKeyBuffers();
+    releaseDeadlineGroups();
+    trackedFree(MEMORY_NAMES, runScratch.sortList.items, runScratch.sortList.capacity * sizeof(SortableItem));
+
+    return status;
+}
+
+/* Writes the sorted report of every group, to reporte_mvp.txt or to a report
+ * per file. In an incomplete run the report of every group that wasn't
+ * fully processed ends with the marker of the bytes of the group.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE if a report couldn't be written */
+int writeCountReports(const AggregationStrategy *strategy, void **states, size_t numGroups,
+                      InputList *inputList, int perFile, int incomplete) {
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < numGroups; i++) {
+        char reportFileName[4096] = "reporte_mvp.txt";
+        if (perFile) {
+            buildPerFileReportName(inputList, i, reportFileName, sizeof(reportFileName));
+        }
+
+        int report = writeReportOfPlayersSortedByMVPCount(strategy, states[i], reportFileName);
+        long scannedBytes = incomplete ? deadlineTimer.groupScannedBytes[i] : 0;
+        long totalBytes = incomplete ? deadlineTimer.groupTotalBytes[i] : 0;
+        if (report == -1 ||
+            (scannedBytes < totalBytes && appendIncompleteMarker(reportFileName, scannedBytes, totalBytes) == -1)) {
+            fprintf(stderr, "Error while writing the sorted report.\n");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+/* Writes a synthetic input file with the options of the command line */
+int runGenerateCommand(int argc, char *argv[], const char *programName) {
+    GeneratorOptions options;
+    if (parseGeneratorOptions(argc, argv, &options) == -1) {
+        fprintf(stderr, "Usage: %s generate <salida.txt> [--lines=<n>|--size=<n>[K|M|G]] [--players=<n>]\n"
+                        "       [--skew=<s>] [--utf8=<fraction>] [--line-length=<min>:<max>] [--seed=<n>]\n",
+                programName);
+        return EXIT_FAILURE;
+    }
+
+    return generateInputFile(&options) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Times the counting engine over generated inputs for every combination of
+ * size, skew, strategy and number of threads, and writes the results as JSON */
+int runBenchCommand(int argc, char *argv[], const char *programName) {
+    BenchOptions options;
+    if (parseBenchOptions(argc, argv, &options) == -1) {
+        fprintf(stderr, "Usage: %s bench [--threads=<n,...>] [--strategies=<name,...>] [--sizes=<n,...>]\n"
+                        "       [--skews=<s,...>] [--players=<n>] [--repeat=<n>] [--warmup=<n>]\n"
+                        "       [--output=<file.json>] [--dir=<directory>]\n", programName);
+        return EXIT_FAILURE;
+    }
+
+    FILE *output = stdout;
+    if (options.outputFileName != NULL) {
+        output = fopen(options.outputFileName, "w");
+        if (output == NULL) {
+            perror("Error creating the bench output file");
+            return EXIT_FAILURE;
+        }
+    }
+
+    double *seconds = malloc(options.repeat * sizeof(double));
+    if (seconds == NULL) {
+        perror("Error allocating memory for the bench timings");
+        if (output != stdout) {
+            fclose(output);
+        }
+        return EXIT_FAILURE;
+    }
+
+    fprintf(output, "{\n  \"players\": %zu,\n  \"repeat\": %d,\n  \"warmup\": %d,\n  \"results\": [",
+            options.numberOfPlayers, options.repeat, options.warmup);
+
+    int status = EXIT_SUCCESS;
+    int first = 1;
+    for (size_t i = 0; i < options.numSizes && status == EXIT_SUCCESS; i++) {
+        for (size_t j = 0; j < options.numSkews && status == EXIT_SUCCESS; j++) {
+            // Generate the input of this size and skew, always with the same seed
+            char fileName[4096];
+            snprintf(fileName, sizeof(fileName), "%s/bench_%zu_%zu.txt", options.directory, i, j);
+            GeneratorOptions generatorOptions = {fileName, 0, options.sizes[i], options.numberOfPlayers,
+                                                 options.skews[j], 0.1, 0, 0, 1};
+            if (generateInputFile(&generatorOptions) == -1) {
+                status = EXIT_FAILURE;
+                break;
+            }
+            struct stat fileStat;
+            long long bytes = stat(fileName, &fileStat) == 0 ? (long long) fileStat.st_size : options.sizes[i];
+            int lines = getLineCountFromFile(fileName);
+
+            for (size_t s = 0; s < options.numStrategies && status == EXIT_SUCCESS; s++) {
+                for (size_t t = 0; t < options.numThreads; t++) {
+                    if (benchConfiguration(&options, fileName, options.strategies[s], options.threads[t],
+                                           seconds) == -1) {
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+
+                    // Median and p95 (nearest rank) of the measured runs
+                    qsort(seconds, options.repeat, sizeof(double), compareDoubles);
+                    double median = options.repeat % 2 == 1 ? seconds[options.repeat / 2] :
+                                    (seconds[options.repeat / 2 - 1] + seconds[options.repeat / 2]) / 2;
+                    double p95 = seconds[(int) ceil(0.95 * options.repeat) - 1];
+
+                    fprintf(output, "%s\n    {\"strategy\": \"%s\", \"threads\": %d, \"bytes\": %lld, "
+                                    "\"lines\": %d, \"skew\": %g, \"median_ms\": %.3f, \"p95_ms\": %.3f, "
+                                    "\"lines_per_second\": %.0f, \"gigabytes_per_second\": %.4f}",
+                            first ? "" : ",", options.strategies[s]->name, options.threads[t],
+                            bytes, lines, options.skews[j], median * 1e3, p95 * 1e3,
+                            lines / median, bytes / median / 1e9);
+                    first = 0;
+
+                    fprintf(stderr, "%-10s %3d threads %10lld bytes skew %-5g median %10.3f ms p95 %10.3f ms\n",
+                            options.strategies[s]->name, options.threads[t], bytes,
+                            options.skews[j], median * 1e3, p95 * 1e3);
+                }
+            }
+
+            remove(fileName);
+        }
+    }
+
+    fprintf(output, "\n  ]\n}\n");
+    if (output != stdout && fclose(output) == EOF) {
+        perror("Error writing the bench output file");
+        status = EXIT_FAILURE;
+    }
+    free(seconds);
+
+    return status;
+}
+
+/* Runs the engine over a file with a strategy and a number of threads, the
+ * warmup runs are discarded and the time of every other run is stored in
+ * seconds (options->repeat entries). Returns 0 on success or -1 on error */
+int benchConfiguration(const BenchOptions *options, const char *fileName, const AggregationStrategy *strategy,
+                       int numberOfThreads, double *seconds) {
+    ProgramOptions programOptions = {0};
+    programOptions.numberOfThreads = numberOfThreads;
+    programOptions.strategy = strategy;
+    programOptions.query = (ParserQuery) {-1, ',', -1, NULL, 0};
+
+    for (int run = 0; run < options->warmup + options->repeat; run++) {
+        InputList inputList = {NULL, 0, 0};
+        if (addInputFile(&inputList, fileName, 0) == -1) {
+            freeInputList(&inputList);
+            return -1;
+        }
+
+        // The whole pipeline is timed, the report is written to /dev/null
+        double start = nowSeconds();
+        void **states = countInputs(&inputList, &programOptions, 1);
+        int report = states != NULL ? writeReportOfPlayersSortedByMVPCount(strategy, states[0], "/dev/null") : -1;
+        double elapsed = nowSeconds() - start;
+
+        if (states != NULL) {
+            destroyStates(strategy, states, 1);
+        }
+        freeInputList(&inputList);
+        if (report == -1) {
+            return -1;
+        }
+
+        if (run >= options->warmup) {
+            seconds[run - options->warmup] = elapsed;
+        }
+    }
+
+    return 0;
+}
+
+/* Compares two seasons: both inputs (files, directories or snapshots) are
+ * aggregated at the same time and the per-player deltas and rank changes are
+ * written to reporte_diff.txt */
+int runDiffCommand(int argc, char *argv[], const char *programName) {
+    ProgramOptions options;
+    if (parseProgramOptions(argc, argv, &options) == -1 || options.numInputs != 2) {
+        fprintf(stderr, "Usage: %s diff <anterior> <actual> num_hebras [opciones]\n", programName);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+    const AggregationStrategy *strategy = options.strategy;
+    statistics.enabled = options.stats;
+    perfReport.enabled = options.perf;
+    if (options.traceFileName != NULL) {
+        traceLog.fileName = options.traceFileName;
+        traceLog.originSeconds = nowSeconds();
+        threadTraceRing = addTraceRing("main");
+    }
+    deadlineTimer.milliseconds = options.deadlineMilliseconds;
+
+    // Snapshots are loaded directly, the rest of inputs are scanned together
+    // so both tables are built concurrently (group 0 and 1)
+    InputList inputList = {NULL, 0, 0};
+    int isSnapshot[2];
+    for (int i = 0; i < 2; i++) {
+        isSnapshot[i] = isSnapshotFile(options.inputs[i]);
+        if (!isSnapshot[i] && addInputPath(&inputList, options.inputs[i], i) == -1) {
+            freeInputList(&inputList);
+            free(options.inputs);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int *groupLineCounts = countInputLines(&inputList, 2);
+    if (groupLineCounts == NULL) {
+        freeInputList(&inputList);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (isSnapshot[i]) {
+            groupLineCounts[i] = getLineCountFromFile(options.inputs[i]);
+        }
+    }
+
+    void **states = createStates(strategy, groupLineCounts, 2, options.numberOfThreads);
+    free(groupLineCounts);
+    if (states == NULL) {
+        freeInputList(&inputList);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+
+    // The snapshots are loaded before the scan, so every state is merged
+    // once with the rest of them (a merged state takes no more batches)
+    int status = EXIT_SUCCESS;
+    for (int i = 0; i < 2 && status == EXIT_SUCCESS; i++) {
+        if (isSnapshot[i] && loadSnapshot(strategy, states[i], options.inputs[i], 0) == -1) {
+            fprintf(stderr, "Error while loading the snapshot '%s'.\n", options.inputs[i]);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    // The deadline only bounds the scan, the snapshots are loaded whole
+    pthread_t deadlineThread;
+    if (status == EXIT_SUCCESS && options.deadlineMilliseconds > 0 &&
+        startDeadlineTimer(&deadlineTimer, &deadlineThread, options.deadlineMilliseconds) == -1) {
+        status = EXIT_FAILURE;
+    }
+    if (status == EXIT_FAILURE) {
+        destroyStates(strategy, states, 2);
+        freeInputList(&inputList);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+
+    if (inputList.count > 0) {
+        // Merges both states, the scanned and the loaded ones
+        if (aggregateInputs(&inputList, &options, states, 2) == -1) {
+            status = EXIT_FAILURE;
+        }
+    } else {
+        strategy->merge(states[0]);
+        strategy->merge(states[1]);
+    }
+
+    int incomplete = 0;
+    if (options.deadlineMilliseconds > 0) {
+        stopDeadlineTimer(&deadlineTimer, deadlineThread);
+        incomplete = inputList.count > 0 && deadlineTimer.expired &&
+                     deadlineTimer.scannedBytes < deadlineTimer.totalBytes;
+    }
+    if (incomplete) {
+        fprintf(stderr, "Deadline of %ld ms reached: %ld of %ld bytes processed, the report is incomplete.\n",
+                options.deadlineMilliseconds, deadlineTimer.scannedBytes, deadlineTimer.totalBytes);
+    }
+
+    if (status == EXIT_SUCCESS && (writeDiffReport(strategy, states[0], states[1], "reporte_diff.txt") == -1 ||
+                                   (incomplete && appendIncompleteMarker("reporte_diff.txt", deadlineTimer.scannedBytes,
+                                                                         deadlineTimer.totalBytes) == -1))) {
+        fprintf(stderr, "Error while writing the diff report.\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (statistics.enabled) {
+        printStatistics(&inputList);
+        printHashTableDiagnostics(strategy->resultTable(states[0]), "previous");
+        printHashTableDiagnostics(strategy->resultTable(states[1]), "current");
+        printMemoryStatistics();
+    }
+    if (perfReport.enabled) {
+        printPerfReport();
+    }
+    if (traceLog.fileName != NULL) {
+        if (writeTraceFile() == -1) {
+            fprintf(stderr, "Error while writing the trace file.\n");
+            status = EXIT_FAILURE;
+        }
+        freeTraceLog();
+    }
+
+    destroyStates(strategy, states, 2);
+    freeInputList(&inputList);
+    free(options.inputs);
+    releaseDeadlineGroups();
+
+    return status;
+}
+
+/* Runs the counting engine over the inputs: counts their lines to size the
+ * tables, creates a state per group and aggregates and merges them.
+ * Returns the merged states (numGroups) or NULL on error */
+void **countInputs(InputList *inputList, ProgramOptions *options, size_t numGroups) {
+    // Count total lines of the inputs, they are used to size the tables
+    int *groupLineCounts = countInputLines(inputList, numGroups);
+    if (groupLineCounts == NULL) {
+        return NULL;
+    }
+
+    // Create the states of the strategy, a combined one or one per file
+    void **states = createStates(options->strategy, groupLineCounts, numGroups, options->numberOfThreads);
+    free(groupLineCounts);
+    if (states == NULL) {
+        return NULL;
+    }
+
+    if (aggregateInputs(inputList, options, states, numGroups) == -1) {
+        destroyStates(options->strategy, states, numGroups);
+        return NULL;
+    }
+
+    return states;
+}
+
+/* Counts the lines of every input file and adds them up by group
+ * returns an array with the lines of every group or NULL on error */
+int *countInputLines(InputList *list, size_t numGroups) {
+    double phaseStart = startPhaseTime();
+
+    int *groupLineCounts = calloc(numGroups, sizeof(int));
+    if (groupLineCounts == NULL) {
+        perror("Error allocating memory for line counts");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        // With a deadline the time is kept for the scan, the lines are
+        // estimated from the size
+        if (deadlineTimer.milliseconds > 0) {
+            list->files[i].lineCount = list->files[i].size / ESTIMATED_LINE_LENGTH + 1;
+            groupLineCounts[list->files[i].group] += list->files[i].lineCount;
+            continue;
+        }
+        list->files[i].lineCount = getLineCountFromFile(list->files[i].path);
+        if (list->files[i].lineCount == -1) {
+            fprintf(stderr, "Error while counting lines in the file.\n");
+            free(groupLineCounts);
+            return NULL;
+        }
+        groupLineCounts[list->files[i].group] += list->files[i].lineCount;
+    }
+
+    addPhaseTime(PHASE_LINE_COUNT, phaseStart);
+
+    return groupLineCounts;
+}
+
+/* Creates a state of the strategy per group, each one sized with the number
+ * of lines of its group. Returns the array of states or NULL on error */
+void **createStates(const AggregationStrategy *strategy, const int *groupLineCounts,
+                    size_t numGroups, int numberOfThreads) {
+    void **states = calloc(numGroups, sizeof(void *));
+    if (states == NULL) {
+        fprintf(stderr, "Error allocating memory for states.\n");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < numGroups; i++) {
+        int capacity = groupLineCounts[i];
+        states[i] = strategy->init(capacity > 0 ? capacity : 1, numberOfThreads);
+        if (states[i] == NULL) {
+            fprintf(stderr, "Error creating hash table.\n");
+            destroyStates(strategy, states, i);
+            return NULL;
+        }
+    }
+
+    return states;
+}
+
+/* Destroys the first numStates states and the array that holds them */
+void destroyStates(const AggregationStrategy *strategy, void **states, size_t numStates) {
+    for (size_t i = 0; i < numStates; i++) {
+        strategy->destroy(states[i]);
+    }
+    free(states);
+}
+
+/* Empties the states for another run over them (--repeat) */
+void resetStates(const AggregationStrategy *strategy, void **states, size_t numStates) {
+    for (size_t i = 0; i < numStates; i++) {
+        strategy->reset(states[i]);
+    }
+}
+
+/* Splits the input files among the threads, counts the keys of every file
+ * into the state of its group and merges the states.
+ * Returns 0 on success or -1 on error */
+int aggregateInputs(InputList *inputList, ProgramOptions *options, void **states, size_t numGroups) {
+    int numberOfThreads = options->numberOfThreads;
+    const AggregationStrategy *strategy = options->strategy;
+
+    // Pick the extraction loop specialized for the shape of the query
+    const ParserVariant *parser = selectParserVariant(&options->query);
+
+    // Split the files in chunks, big files are split so their work can be
+    // shared and small files are kept whole
+    size_t numUnits;
+    WorkUnit *units = splitIntoWorkUnits(inputList, numberOfThreads,
+                                         options->memoDirName != NULL ? options->memoBlockSize : 0, &numUnits);
+
+    // Dynamically allocate memory for an  array of pthread_t to store ids
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+
+    // Dynamically allocate memory for an array of data (ThreadData) for threads
+    ThreadData *threadData = calloc(numberOfThreads, sizeof(ThreadData));
+
+    // Distribute the chunks among threads, largest first, always to the thread
+    // with less assigned bytes so all of them finish at the same time
+    WorkUnit *assignedUnits = NULL;
+    if (units != NULL && threadData != NULL) {
+        assignedUnits = assignWorkUnits(units, numUnits, threadData, numberOfThreads);
+    }
+
+    // Set of the records already counted, shared by all the threads
+    DedupFilter *dedup = NULL;
+    if (options->dedup) {
+        dedup = createDedupFilter(inputList);
+    }
+
+    // Per thread statistics, filled by the threads themselves
+    if (statistics.enabled) {
+        free(statistics.threads);
+        free(statistics.locks);
+        statistics.threads = calloc(numberOfThreads, sizeof(ThreadStats));
+        statistics.locks = calloc((size_t) numberOfThreads * NUMBER_OF_PROFILED_LOCKS, sizeof(LockStats));
+        statistics.numberOfThreads = statistics.threads != NULL ? numberOfThreads : 0;
+    }
+    if (perfReport.enabled) {
+        free(perfReport.threads);
+        perfReport.threads = calloc(numberOfThreads, sizeof(PerfCounters));
+        perfReport.numberOfThreads = perfReport.threads != NULL ? numberOfThreads : 0;
+    }
+
+    // Bytes of every group, to tell which reports a deadline left incomplete
+    int deadlineGroups = deadlineTimer.milliseconds > 0;
+    if (deadlineGroups) {
+        releaseDeadlineGroups();
+        deadlineTimer.groupScannedBytes = calloc(numGroups, sizeof(long));
+        deadlineTimer.groupTotalBytes = calloc(numGroups, sizeof(long));
+        for (size_t i = 0; units != NULL && deadlineTimer.groupTotalBytes != NULL && i < numUnits; i++) {
+            deadlineTimer.groupTotalBytes[inputList->files[units[i].fileIndex].group] +=
+                units[i].endOffset - units[i].startOffset;
+        }
+    }
+
+    if (units == NULL || threads == NULL || threadData == NULL || assignedUnits == NULL ||
+        (options->dedup && dedup == NULL) || reserveKeyBuffers(numberOfThreads) == -1 ||
+        (deadlineGroups && (deadlineTimer.groupScannedBytes == NULL || deadlineTimer.groupTotalBytes == NULL))) {
+        fprintf(stderr, "Error allocating memory for threads.\n");
+        free(units);
+        free(assignedUnits);
+        free(threads);
+        free(threadData);
+        freeDedupFilter(dedup);
+        return -1;
+    }
+
+    // Every worker records its spans in a ring of its own with --trace
+    if (traceLog.fileName != NULL) {
+        for (int i = 0; i < numberOfThreads; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "worker %d", i);
+            threadData[i].traceRing = addTraceRing(name);
+        }
+    }
+
+    // Memoized blocks are only valid for the same query
+    uint64_t memoSeed = 0;
+    if (options->memoDirName != NULL) {
+        char query[512];
+        snprintf(query, sizeof(query), "column=%d delimiter=%d filter=%d:%s", options->query.column,
+                 options->query.delimiter, options->query.filterColumn,
+                 options->query.filterPrefix != NULL ? options->query.filterPrefix : "");
+        memoSeed = hashBytes(14695981039346656037ULL, (unsigned char *) query, strlen(query));
+    }
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        // Configure thread parameters
+        threadData[i].tid = i;
+        threadData[i].files = inputList->files;
+        threadData[i].strategy = strategy;
+        threadData[i].states = states;
+        threadData[i].parser = parser;
+        threadData[i].query = &options->query;
+        threadData[i].dedup = dedup;
+        threadData[i].memoDirName = options->memoDirName;
+        threadData[i].memoSeed = memoSeed;
+        threadData[i].keys = runScratch.keys + (size_t) i * KEY_BATCH_SIZE;
+        threadData[i].keyBuffer = runScratch.keyBuffers + (size_t) i * KEY_BUFFER_SIZE;
+    }
+
+    // The progress line is printed by its own thread, a failure to start it
+    // only loses the progress line
+    ProgressMonitor monitor;
+    pthread_t monitorThread;
+    int monitored = options->progress &&
+                    startProgressMonitor(&monitor, &monitorThread, threadData, numberOfThreads) == 0;
+
+    double phaseStart = startPhaseTime();
+
+    // Create threads to count player occurrences in the files
+    // Each thread will process its chunks of the files
+    for (int i = 0; i < numberOfThreads; i++) {
+        pthread_create(&threads[i], NULL, countPlayerOccurrences, (void *) &threadData[i]);
+    }
+
+    // Wait for all threads to complete their processing before continuing
+    // This ensures all MVP data has been processed before printing results
+    for (int i = 0; i < numberOfThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (monitored) {
+        stopProgressMonitor(&monitor, monitorThread);
+    }
+
+    // How much of the inputs the result covers, less than all of them if the
+    // deadline stopped the threads
+    deadlineTimer.scannedBytes = 0;
+    deadlineTimer.totalBytes = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        deadlineTimer.scannedBytes += threadData[i].scannedBytes;
+        deadlineTimer.totalBytes += threadData[i].assignedBytes;
+    }
+
+    addPhaseTime(PHASE_SCAN, phaseStart);
+    phaseStart = startPhaseTime();
+
+    // Combine the partial results of the threads (if the strategy has any)
+    for (size_t i = 0; i < numGroups; i++) {
+        strategy->merge(states[i]);
+    }
+
+    addPhaseTime(PHASE_MERGE, phaseStart);
+
+    if (dedup != NULL) {
+        fprintf(stderr, "Skipped %zu duplicated records (filter of %zu KiB).\n", dedup->duplicates,
+                (dedup->mask + 1) * sizeof(uint64_t) / 1024);
+        freeDedupFilter(dedup);
+    }
+
+    // A unit that couldn't be read or loaded leaves the counts incomplete
+    int failed = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        failed |= threadData[i].failed;
+    }
+
+    free(threads);
+    free(threadData);
+    free(units);
+    free(assignedUnits);
+    if (!runScratch.enabled) {
+        releaseKeyBuffers();
+    }
+
+    if (failed) {
+        fprintf(stderr, "Error: some chunks of the inputs couldn't be counted.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Makes sure the key buffers of runScratch have room for numberOfThreads
+ * threads, they are only allocated again if they are too small.
+ * Returns 0 on success or -1 on error */
+int reserveKeyBuffers(int numberOfThreads) {
+    if (runScratch.keys != NULL && runScratch.numberOfThreads >= numberOfThreads) {
+        return 0;
+    }
+
+    releaseKeyBuffers();
+    runScratch.keys = trackedMalloc(MEMORY_PARSER, (size_t) numberOfThreads * KEY_BATCH_SIZE * sizeof(char *));
+    runScratch.keyBuffers = trackedMalloc(MEMORY_PARSER, (size_t) numberOfThreads * KEY_BUFFER_SIZE);
+    if (runScratch.keys == NULL || runScratch.keyBuffers == NULL) {
+        perror("Error allocating memory for the key buffers");
+        releaseKeyBuffers();
+        return -1;
+    }
+    runScratch.numberOfThreads = numberOfThreads;
+
+    return 0;
+}
+
+/* Frees the key buffers of runScratch */
+void releaseKeyBuffers(void) {
+    trackedFree(MEMORY_PARSER, runScratch.keys,
+                (size_t) runScratch.numberOfThreads * KEY_BATCH_SIZE * sizeof(char *));
+    trackedFree(MEMORY_PARSER, runScratch.keyBuffers, (size_t) runScratch.numberOfThreads * KEY_BUFFER_SIZE);
+    runScratch.keys = NULL;
+    runScratch.keyBuffers = NULL;
+    runScratch.numberOfThreads = 0;
+}
+
+/* Parses the command line: the input files or directories followed by the
+ * number of threads, and the options (--name=value) anywhere.
+ * Returns 0 on success or -1 if the arguments are incorrect, in both cases
+ * the caller must free options->inputs */
+int parseProgramOptions(int argc, char *argv[], ProgramOptions *options) {
+    options->inputs = malloc(argc * sizeof(char *));
+    if (options->inputs == NULL) {
+        perror("Error allocating memory for inputs");
+        return -1;
+    }
+    options->numInputs = 0;
+    options->numberOfThreads = 0;
+    options->strategy = &strategies[0];
+    options->query = (ParserQuery) {-1, ',', -1, NULL, 0};
+    options->perFile = 0;
+    options->snapshotFileName = NULL;
+    options->dedup = 0;
+    options->stats = 0;
+    options->perf = 0;
+    options->traceFileName = NULL;
+    options->progress = 0;
+    options->cacheDirName = NULL;
+    options->cacheSample = 0;
+    options->memoDirName = NULL;
+    options->memoBlockSize = DEFAULT_MEMO_BLOCK_SIZE;
+    options->deadlineMilliseconds = 0;
+    options->repeat = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--strategy=", 11) == 0) {
+            options->strategy = findStrategy(argv[i] + 11);
+            if (options->strategy == NULL) {
+                fprintf(stderr, "Error: unknown strategy '%s'.\n", argv[i] + 11);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--sketch-size=", 14) == 0) {
+            int capacity = atoi(argv[i] + 14);
+            if (capacity <= 0) {
+                fprintf(stderr, "Error: sketch size must be greater than 0.\n");
+                return -1;
+            }
+            sketchCapacity = capacity;
+        } else if (strncmp(argv[i], "--column=", 9) == 0) {
+            // A number (-1 is the last one too) or last, nothing after it
+            char *end = NULL;
+            long column = strcmp(argv[i] + 9, "last") == 0 ? -1 : strtol(argv[i] + 9, &end, 10);
+            if ((end != NULL && (end == argv[i] + 9 || *end != '\0')) || column < -1 || column > INT_MAX) {
+                fprintf(stderr, "Error: invalid column '%s'.\n", argv[i] + 9);
+                return -1;
+            }
+            options->query.column = column;
+        } else if (strncmp(argv[i], "--delimiter=", 12) == 0) {
+            if (strlen(argv[i] + 12) != 1) {
+                fprintf(stderr, "Error: the delimiter must be a single character.\n");
+                return -1;
+            }
+            options->query.delimiter = argv[i][12];
+        } else if (strncmp(argv[i], "--filter=", 9) == 0) {
+            if (parseFilter(argv[i] + 9, &options->query) == -1) {
+                fprintf(stderr, "Error: the filter must be <column>:<prefix>.\n");
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--per-file") == 0) {
+            options->perFile = 1;
+        } else if (strncmp(argv[i], "--snapshot=", 11) == 0) {
+            options->snapshotFileName = argv[i] + 11;
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            options->dedup = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            options->stats = 1;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            options->perf = 1;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            options->traceFileName = argv[i] + 8;
+        } else if (strcmp(argv[i], "--progress") == 0) {
+            options->progress = 1;
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            options->cacheDirName = argv[i] + 12;
+        } else if (strcmp(argv[i], "--cache-sample") == 0) {
+            options->cacheSample = 1;
+        } else if (strncmp(argv[i], "--memo-dir=", 11) == 0) {
+            options->memoDirName = argv[i] + 11;
+        } else if (strncmp(argv[i], "--memo-block=", 13) == 0) {
+            options->memoBlockSize = parseByteSize(argv[i] + 13);
+            if (options->memoBlockSize <= 0) {
+                fprintf(stderr, "Error: the block size must be a number of bytes (K, M or G suffix allowed).\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--deadline=", 11) == 0) {
+            char *end;
+            errno = 0;
+            options->deadlineMilliseconds = strtol(argv[i] + 11, &end, 10);
+            if (end == argv[i] + 11 || *end != '\0' || errno == ERANGE || options->deadlineMilliseconds <= 0) {
+                fprintf(stderr, "Error: the deadline must be a number of milliseconds greater than 0.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            char *end;
+            errno = 0;
+            long repeat = strtol(argv[i] + 9, &end, 10);
+            options->repeat = repeat;
+            if (end == argv[i] + 9 || *end != '\0' || errno == ERANGE || repeat <= 0 || repeat > INT_MAX) {
+                fprintf(stderr, "Error: the number of runs must be greater than 0.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Error: unknown option '%s'.\n", argv[i]);
+            return -1;
+        } else {
+            options->inputs[options->numInputs++] = argv[i];
+        }
+    }
+
+    // A memoized block must not depend on the records of other blocks
+    if (options->memoDirName != NULL && options->dedup) {
+        fprintf(stderr, "Error: --memo-dir can't be used with --dedup.\n");
+        return -1;
+    }
+
+    // Every run must scan the same inputs to the end, a cached or memoized
+    // run doesn't and a deadline would cut them
+    if (options->repeat > 1 &&
+        (options->cacheDirName != NULL || options->memoDirName != NULL || options->deadlineMilliseconds > 0)) {
+        fprintf(stderr, "Error: --repeat can't be used with --cache-dir, --memo-dir or --deadline.\n");
+        return -1;
+    }
+
+    // The number of threads is the last positional
+    if (options->numInputs < 1) {
+        return -1;
+    }
+    options->numInputs--;
+
+    // Parse the number of threads
+    options->numberOfThreads = atoi(options->inputs[options->numInputs]);
+    if (options->numberOfThreads <= 0) {
+        fprintf(stderr, "Error: threads number must be greater than 0.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Appends a regular file to the input list with its size and group
+ * returns 0 on success or -1 on error */
+int addInputFile(InputList *list, const char *path, int group) {
+    struct stat fileStat;
+    if (stat(path, &fileStat) == -1) {
+        perror("Error opening file");
+        return -1;
+    }
+
+    if (list->count == list->capacity) {
+        size_t newCapacity = list->capacity == 0 ? 8 : list->capacity * 2;
+        InputFile *newFiles = realloc(list->files, newCapacity * sizeof(InputFile));
+        if (newFiles == NULL) {
+            perror("Error allocating memory for input files");
+            return -1;
+        }
+        list->files = newFiles;
+        list->capacity = newCapacity;
+    }
+
+    InputFile *file = &list->files[list->count];
+    file->path = strdup(path);
+    if (file->path == NULL) {
+        perror("Error allocating memory for input file path");
+        return -1;
+    }
+    file->size = fileStat.st_size;
+    file->lineCount = 0;
+    file->group = group;
+    list->count++;
+
+    return 0;
+}
+
+/* Comparison function for qsort to sort the file names of a directory */
+int compareFileNames(const void *a, const void *b) {
+    return strcmp(*(char **) a, *(char **) b);
+}
+
+/* Adds a file, or every regular file of a directory (sorted by name and
+ * skipping hidden files), to the input list in the given group
+ * returns 0 on success or -1 on error */
+int addInputPath(InputList *list, const char *path, int group) {
+    struct stat pathStat;
+    if (stat(path, &pathStat) == -1) {
+        fprintf(stderr, "Error opening '%s': ", path);
+        perror(NULL);
+        return -1;
+    }
+
+    if (!S_ISDIR(pathStat.st_mode)) {
+        return addInputFile(list, path, group);
+    }
+
+    DIR *directory = opendir(path);
+    if (directory == NULL) {
+        perror("Error opening directory");
+        return -1;
+    }
+
+    // Collect the paths of the regular files of the directory
+    char **paths = NULL;
+    size_t numPaths = 0;
+    size_t capacity = 0;
+    int status = 0;
+    struct dirent *entry;
+    while (status == 0 && (entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        size_t length = strlen(path) + strlen(entry->d_name) + 2;
+        char *filePath = malloc(length);
+        if (filePath == NULL) {
+            perror("Error allocating memory for input file path");
+            status = -1;
+            break;
+        }
+        snprintf(filePath, length, "%s/%s", path, entry->d_name);
+
+        struct stat fileStat;
+        if (stat(filePath, &fileStat) == -1 || !S_ISREG(fileStat.st_mode)) {
+            free(filePath);
+            continue;
+        }
+
+        if (numPaths == capacity) {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            char **newPaths = realloc(paths, capacity * sizeof(char *));
+            if (newPaths == NULL) {
+                perror("Error allocating memory for input files");
+                free(filePath);
+                status = -1;
+                break;
+            }
+            paths = newPaths;
+        }
+        paths[numPaths++] = filePath;
+    }
+    closedir(directory);
+
+    // Sort them so the order of the inputs doesn't depend on the file system
+    if (numPaths > 0) {
+        qsort(paths, numPaths, sizeof(char *), compareFileNames);
+    }
+    for (size_t i = 0; i < numPaths; i++) {
+        if (status == 0) {
+            status = addInputFile(list, paths[i], group);
+        }
+        free(paths[i]);
+    }
+    free(paths);
+
+    return status;
+}
+
+/* Frees the paths and the array of the input list */
+void freeInputList(InputList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->files[i].path);
+    }
+    free(list->files);
+    list->files = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/* Comparison function for qsort to sort work units by size (descending) */
+int compareWorkUnitsBySize(const void *a, const void *b) {
+    const WorkUnit *unitA = a;
+    const WorkUnit *unitB = b;
+    long sizeA = unitA->endOffset - unitA->startOffset;
+    long sizeB = unitB->endOffset - unitB->startOffset;
+
+    if (sizeA != sizeB) {
+        return sizeA < sizeB ? 1 : -1;
+    }
+    // Same size: keep the file order to make the schedule deterministic
+    if (unitA->fileIndex != unitB->fileIndex) {
+        return unitA->fileIndex - unitB->fileIndex;
+    }
+    return unitA->startOffset < unitB->startOffset ? -1 : 1;
+}
+
+/* Splits the input files into work units of about the same size, so every
+ * thread gets several of them. Files smaller than the chunk size are a single
+ * unit. With a fixedChunkSize (> 0) the units are the content blocks of
+ * about that size of splitIntoContentBlocks, whatever the number of threads.
+ * The units are returned sorted by size (largest first), or NULL on error */
+WorkUnit *splitIntoWorkUnits(InputList *list, int numberOfThreads, long fixedChunkSize, size_t *numUnits) {
+    if (fixedChunkSize > 0) {
+        return splitIntoContentBlocks(list, fixedChunkSize, numUnits);
+    }
+
+    long totalBytes = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        totalBytes += list->files[i].size;
+    }
+
+    long chunkSize = totalBytes / ((long) numberOfThreads * CHUNKS_PER_THREAD);
+    if (chunkSize < MIN_CHUNK_SIZE) {
+        chunkSize = MIN_CHUNK_SIZE;
+    }
+
+    // Count the units first to allocate them at once
+    size_t count = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        long size = list->files[i].size;
+        count += size <= chunkSize ? 1 : (size + chunkSize - 1) / chunkSize;
+    }
+
+    WorkUnit *units = malloc(count * sizeof(WorkUnit));
+    if (units == NULL) {
+        perror("Error allocating memory for work units");
+        return NULL;
+    }
+
+    size_t unitIndex = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        long size = list->files[i].size;
+        long startOffset = 0;
+        do {
+            long endOffset = startOffset + chunkSize < size ? startOffset + chunkSize : size;
+            units[unitIndex].fileIndex = i;
+            units[unitIndex].startOffset = startOffset;
+            units[unitIndex].endOffset = endOffset;
+            unitIndex++;
+            startOffset = endOffset;
+        } while (startOffset < size);
+    }
+
+    qsort(units, count, sizeof(WorkUnit), compareWorkUnitsBySize);
+
+    *numUnits = count;
+    return units;
+}
+
+/* Splits the input files into blocks for --memo-dir that end after a line
+ * chosen by its content (isContentBoundary), so inserting or removing lines
+ * only changes the blocks around the edit and the rest keep their content
+ * and their memoized aggregate. Blocks have at least a quarter of blockSize
+ * and are cut anyway at four times blockSize. The units are returned sorted
+ * by size (largest first), or NULL on error */
+WorkUnit *splitIntoContentBlocks(InputList *list, long blockSize, size_t *numUnits) {
+    size_t count = 0;
+    size_t capacity = 64;
+    WorkUnit *units = malloc(capacity * sizeof(WorkUnit));
+    if (units == NULL) {
+        perror("Error allocating memory for work units");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        int descriptor = open(list->files[i].path, O_RDONLY);
+        struct stat fileStat;
+        if (descriptor == -1 || fstat(descriptor, &fileStat) == -1) {
+            perror("Error opening file");
+            if (descriptor != -1) {
+                close(descriptor);
+            }
+            free(units);
+            return NULL;
+        }
+
+        long size = fileStat.st_size;
+        const char *data = NULL;
+        if (size > 0) {
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data == MAP_FAILED) {
+                perror("Error mapping file");
+                close(descriptor);
+                free(units);
+                return NULL;
+            }
+            madvise((void *) data, size, MADV_SEQUENTIAL);
+        }
+        close(descriptor);
+
+        // An empty file is still a unit, like in the split by threads
+        long startOffset = 0;
+        long position = 0;
+        do {
+            long endOffset = size;
+            while (position < size) {
+                const char *newline = memchr(data + position, '\n', size - position);
+                long lineEnd = newline != NULL ? newline - data + 1 : size;
+                long blockLength = lineEnd - startOffset;
+                int boundary = blockLength >= 4 * blockSize ||
+                               (blockLength >= blockSize / 4 &&
+                                isContentBoundary(data + position, lineEnd - position, blockSize));
+                position = lineEnd;
+                if (boundary) {
+                    endOffset = lineEnd;
+                    break;
+                }
+            }
+
+            if (count == capacity) {
+                capacity *= 2;
+                WorkUnit *grown = realloc(units, capacity * sizeof(WorkUnit));
+                if (grown == NULL) {
+                    perror("Error allocating memory for work units");
+                    if (data != NULL) {
+                        munmap((void *) data, size);
+                    }
+                    free(units);
+                    return NULL;
+                }
+                units = grown;
+            }
+            units[count].fileIndex = i;
+            units[count].startOffset = startOffset;
+            units[count].endOffset = endOffset;
+            count++;
+            startOffset = endOffset;
+        } while (startOffset < size);
+
+        if (data != NULL) {
+            munmap((void *) data, size);
+        }
+    }
+
+    qsort(units, count, sizeof(WorkUnit), compareWorkUnitsBySize);
+
+    *numUnits = count;
+    return units;
+}
+
+/* Decides if a block ends after a line of the given length (with its '\n'):
+ * the hash of its last bytes is below its length out of blockSize, so a
+ * boundary comes about every blockSize bytes whatever the line lengths.
+ * Identical lines give the same answer, long runs of them are cut by the
+ * maximum size of the block */
+int isContentBoundary(const char *line, long length, long blockSize) {
+    long tail = length < MEMO_BOUNDARY_BYTES ? length : MEMO_BOUNDARY_BYTES;
+    uint64_t hashValue = hashWords(14695981039346656037ULL, (const unsigned char *) line + length - tail, tail);
+
+    return (long) (hashValue % (uint64_t) blockSize) < length;
+}
+
+/* Assigns the units (sorted largest first) to the threads, each one goes to
+ * the thread with fewer assigned bytes (longest processing time first).
+ * Returns a new array with the units grouped by thread, every ThreadData
+ * points to its group, or NULL on error */
+WorkUnit *assignWorkUnits(WorkUnit *units, size_t numUnits, ThreadData *threadData, int numberOfThreads) {
+    int *owners = malloc(numUnits * sizeof(int));
+    WorkUnit *assignedUnits = malloc(numUnits * sizeof(WorkUnit));
+    if (owners == NULL || assignedUnits == NULL) {
+        perror("Error allocating memory for the schedule");
+        free(owners);
+        free(assignedUnits);
+        return NULL;
+    }
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        threadData[i].numUnits = 0;
+        threadData[i].assignedBytes = 0;
+    }
+
+    for (size_t i = 0; i < numUnits; i++) {
+        int leastLoaded = 0;
+        for (int j = 1; j < numberOfThreads; j++) {
+            if (threadData[j].assignedBytes < threadData[leastLoaded].assignedBytes) {
+                leastLoaded = j;
+            }
+        }
+        owners[i] = leastLoaded;
+        threadData[leastLoaded].assignedBytes += units[i].endOffset - units[i].startOffset;
+        threadData[leastLoaded].numUnits++;
+    }
+
+    // Point every thread to its group of units
+    size_t offset = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        threadData[i].units = &assignedUnits[offset];
+        offset += threadData[i].numUnits;
+        threadData[i].numUnits = 0;
+    }
+
+    // Copy the units to the group of their owner keeping the largest first order
+    for (size_t i = 0; i < numUnits; i++) {
+        ThreadData *owner = &threadData[owners[i]];
+        owner->units[owner->numUnits++] = units[i];
+    }
+
+    free(owners);
+    return assignedUnits;
+}
+
+/* Builds the name of the report of the index-th input file with --per-file:
+ * reporte_mvp_<file name without directory nor extension>.txt. When earlier
+ * files have the same name (a/x.txt and b/x.txt) the name ends with _<n>,
+ * n being the position of the file among them (reporte_mvp_x_2.txt) */
+void buildPerFileReportName(const InputList *list, size_t index, char *reportFileName, size_t size) {
+    const char *stem;
+    int length = findFileStem(list->files[index].path, &stem);
+
+    int position = 1;
+    for (size_t i = 0; i < index; i++) {
+        const char *otherStem;
+        int otherLength = findFileStem(list->files[i].path, &otherStem);
+        position += otherLength == length && strncmp(otherStem, stem, length) == 0;
+    }
+
+    if (position == 1) {
+        snprintf(reportFileName, size, "reporte_mvp_%.*s.txt", length, stem);
+    } else {
+        snprintf(reportFileName, size, "reporte_mvp_%.*s_%d.txt", length, stem, position);
+    }
+}
+
+/* Finds the name of a file without directory nor extension, stores where it
+ * starts in stem and returns its length */
+int findFileStem(const char *path, const char **stem) {
+    const char *baseName = strrchr(path, '/');
+    baseName = baseName != NULL ? baseName + 1 : path;
+
+    const char *extension = strrchr(baseName, '.');
+    *stem = baseName;
+    return extension != NULL && extension != baseName ? (int) (extension - baseName) : (int) strlen(baseName);
+}
+
+/* Checks that no two inputs get the same report with --per-file, which the
+ * suffixes of buildPerFileReportName can still give (x.txt, x.csv and x_2.txt).
+ * Returns 0 if every name is unique or -1 (with a message) otherwise */
+int checkPerFileReportNames(const InputList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        char reportFileName[4096];
+        buildPerFileReportName(list, i, reportFileName, sizeof(reportFileName));
+        for (size_t j = 0; j < i; j++) {
+            char otherFileName[4096];
+            buildPerFileReportName(list, j, otherFileName, sizeof(otherFileName));
+            if (strcmp(reportFileName, otherFileName) == 0) {
+                fprintf(stderr, "Error: '%s' and '%s' would both be reported in %s, rename one of them.\n",
+                        list->files[j].path, list->files[i].path, reportFileName);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Prints the usage message with the list of available strategies */
+void printUsage(const char *programName) {
+    fprintf(stderr, "Usage: %s archivo.txt|directorio [...] num_hebras [--strategy=<name>]\n"
+                    "       [--sketch-size=<n>] [--column=<n|last>] [--delimiter=<c>]\n"
+                    "       [--filter=<column>:<prefix>] [--per-file] [--snapshot=<file>]\n"
+                    "       [--dedup] [--stats] [--perf] [--trace=<file.json>] [--progress]\n"
+                    "       [--cache-dir=<directory>] [--cache-sample] [--memo-dir=<directory>]\n"
+                    "       [--memo-block=<n>[K|M|G]] [--deadline=<ms>] [--repeat=<n>]\n"
+                    "       %s diff <anterior> <actual> num_hebras [opciones]\n"
+                    "       %s generate <salida.txt> [--lines=<n>|--size=<n>[K|M|G]] [--players=<n>]\n"
+                    "       [--skew=<s>] [--utf8=<fraction>] [--line-length=<min>:<max>] [--seed=<n>]\n"
+                    "       %s bench [--threads=<n,...>] [--strategies=<name,...>] [--sizes=<n,...>]\n"
+                    "       [--skews=<s,...>] [--players=<n>] [--repeat=<n>] [--warmup=<n>]\n"
+                    "       [--output=<file.json>] [--dir=<directory>]\n"
+                    "       %s microbench [--keys=<n>] [--players=<n>] [--skew=<s>] [--threads=<n>]\n"
+                    "       %s verify [archivo.txt ...] [--expected=<reporte.txt>] [opciones de bench]\n"
+                    "       %s stress [--threads=<n,...>] [--strategies=<name,...>] [--keys=<n>]\n"
+                    "       [--collisions=<n>] [--output=<file.json>]\n"
+                    "       %s reports archivo.txt|directorio [...] num_hebras [--group-by=<n|last>,...]\n"
+                    "       [--score-column=<n>] [--filter=<column>:<prefix>] [--delimiter=<c>]\n"
+                    "       [--teams[=<jugadores.txt>]] [--stats]\n"
+                    "       %s query \"<SELECT ...>\" archivo.txt|directorio [...] num_hebras\n"
+                    "       [--score-column=<n>] [--delimiter=<c>] [--output=<file>] [--stats]\n",
+            programName, programName, programName, programName, programName, programName, programName,
+            programName, programName);
+    fprintf(stderr, "Strategies:\n");
+    for (size_t i = 0; i < NUMBER_OF_STRATEGIES; i++) {
+        fprintf(stderr, "  %-10s %s%s\n", strategies[i].name, strategies[i].description,
+                i == 0 ? " (default)" : "");
+    }
+}
+
+/* Parses a filter written as <column>:<prefix> into the query
+ * returns 0 on success or -1 if it is malformed */
+int parseFilter(const char *argument, ParserQuery *query) {
+    const char *separator = strchr(argument, ':');
+    if (separator == NULL || separator == argument) {
+        return -1;
+    }
+
+    char *end;
+    long column = strtol(argument, &end, 10);
+    if (end != separator || column < 0) {
+        return -1;
+    }
+
+    query->filterColumn = column;
+    query->filterPrefix = separator + 1;
+    query->filterPrefixLength = strlen(separator + 1);
+
+    return 0;
+}
+
+/* Looks for a strategy by its name, returns NULL if it doesn't exist */
+const AggregationStrategy *findStrategy(const char *name) {
+    for (size_t i = 0; i < NUMBER_OF_STRATEGIES; i++) {
+        if (strcmp(strategies[i].name, name) == 0) {
+            return &strategies[i];
+        }
+    }
+    return NULL;
+}
+
+/* Calculates the ceiling division of two integers (division rounded up) */
+int ceilDivision(int numerator, int divisor) {
+    if (numerator % divisor == 0) {
+        return numerator / divisor;
+    } else {
+        return (numerator / divisor) + 1;
+    }
+}
+
+/* Creates an initializes a hash table with capacity defined by the given size
+ * Returns a pointer to the table or NULL if it fails */
+HashTable *createHashTable(int size) {
+    // Allocate memory for the table structure
+    HashTable *table = trackedMalloc(MEMORY_BUCKETS, sizeof(HashTable));
+    if (table == NULL) {
+        perror("Failed to allocate memory for hash table.");
+        return NULL;
+    }
+
+    // Create a zero-initialized items array
+    table->items = trackedCalloc(MEMORY_BUCKETS, size, sizeof(HashItem *));
+    if (table->items == NULL) {
+        perror("Failed to allocate memory for hash table items.");
+        trackedFree(MEMORY_BUCKETS, table, sizeof(HashTable));
+        return NULL;
+    }
+
+    // Initializes table properties
+    table->count = 0;
+    table->size = size;
+    table->arenas = NULL;
+    table->numArenas = 0;
+
+    return table;
+}
+
+/* Creates a hash table whose items are taken from numArenas arenas, one per
+ * thread that inserts in it. Returns a pointer to the table or NULL if it
+ * fails */
+HashTable *createArenaHashTable(int size, int numArenas) {
+    HashTable *table = createHashTable(size);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->arenas = trackedCalloc(MEMORY_BUCKETS, numArenas, sizeof(Arena));
+    if (table->arenas == NULL) {
+        perror("Failed to allocate memory for hash table arenas.");
+        freeHashTable(table);
+        return NULL;
+    }
+    table->numArenas = numArenas;
+
+    return table;
+}
+
+/* Creates and initializes a hash item for insertion into the hash table.
+ * Handles collision by including a next pointer to chain items
+ *
+ * Collision handling is used because:
+ * 1. Different player names may hash to the same index (hash collision)
+ * 2. Collision handling avoid newer players overwriting previous ones
+ * with the same hash
+ */
+HashItem *createHashItem(char *key, int value) {
+    // Allocate memory for the hash item
+    HashItem *item = trackedMalloc(MEMORY_HASH_ITEMS, sizeof(HashItem));
+    if (item == NULL) {
+        perror("Failed to allocate memory for hash item.");
+        return NULL;
+    }
+
+    // Copy the key string into the allocated memory and append null terminator
+    item->key = trackedStrdup(MEMORY_KEYS, key);
+    if (item->key == NULL) {
+        perror("Failed to allocate memory for hash item key.");
+        trackedFree(MEMORY_HASH_ITEMS, item, sizeof(HashItem));
+        return NULL;
+    }
+
+    // Set initial value (mvp count) and next pointer for collision handling
+    item->value = value;
+    item->next = NULL;
+
+    return item;
+}
+
+/* Creates a hash item for the table, taking it and its key from the given
+ * arena of the table if it has arenas. Only one thread at a time may use an
+ * arena. Returns the item or NULL if it fails */
+HashItem *allocateHashItem(HashTable *table, int arena, char *key, int value) {
+    if (table->arenas == NULL) {
+        return createHashItem(key, value);
+    }
+
+    // The key is stored right after the item
+    size_t keySize = strlen(key) + 1;
+    HashItem *item = arenaAllocate(&table->arenas[arena], sizeof(HashItem) + keySize);
+    if (item == NULL) {
+        perror("Failed to allocate memory for hash item.");
+        return NULL;
+    }
+    item->key = (char *) (item + 1);
+    memcpy(item->key, key, keySize);
+    item->value = value;
+    item->next = NULL;
+
+    return item;
+}
+
+/* Generate a hash value for a given key using a polynomial rolling hash. */
+unsigned int hashGenerator(char *key, int size) {
+    unsigned int hashValue = 0;
+    for (size_t i = 0; key[i] != '\0'; i++) {
+        // Multiply by 31, add current char, and keep within bounds with modulo
+        hashValue = (hashValue * 31 + key[i]) % size;
+    }
+
+    return hashValue;
+}
+
+/* Accounts a lookup that compared the key with comparisons items of a
+ * chain, only when the thread collects lookup statistics (--stats) */
+static inline void recordLookup(size_t comparisons) {
+    LookupStats *lookupStats = threadLookupStats;
+    if (lookupStats != NULL) {
+        lookupStats->lookups++;
+        lookupStats->comparisons += comparisons;
+    }
+}
+
+/* Adds value to the count of an existing key or inserts a new item with that
+ * value. It doesn't lock anything, the caller must guarantee that no other
+ * thread is modifying the same table. Returns 0 on success or -1 on error */
+int addToHashItem(HashTable *table, char *key, int value) {
+    // Calculates item index for this key
+    unsigned int index = hashGenerator(key, table->size);
+
+    // Search for the key
+    HashItem *current = table->items[index];
+    size_t comparisons = 0;
+    while (current != NULL) {
+        // check if the key already exists in the hash table
+        comparisons++;
+        if (strcmp(current->key, key) == 0) {
+            // Key found, increment his value
+            current->value += value;
+            recordLookup(comparisons);
+            return 0;
+        }
+        // Moves to the next item in chain
+        current = current->next;
+    }
+    recordLookup(comparisons);
+
+    // Key doesn't exist so create a new item with the provided key and value
+    HashItem *newItem = allocateHashItem(table, 0, key, value);
+    if (newItem == NULL) {
+        perror("Failed to create a hash item.");
+        return -1;
+    }
+
+    // Insert the new item at the beginning of the collision chain
+    newItem->next = table->items[index];
+    table->items[index] = newItem;
+    table->count++;
+    MVP_PROBE2(key_insert, newItem->key, value);
+
+    return 0;
+}
+
+/* Increments count for an existing key or inserts new item in the hash table.
+ * This function is thread-safe by using mutex locking and unlocking. */
+void incrementOrInsertHashItem(HashTable *table, char *key, int value) {
+    // Lock mutex to prevent race conditions on the shared hash table
+    // Lock the entire table since it has to look for the key and navigate
+    // the chain, determine if it should increment or add another item
+    // all of this has to be done in a single lock since is an atomic operation
+    lockMutex(&tableMutex, TABLE_MUTEX_LOCK_ID);
+
+    addToHashItem(table, key, value);
+
+    // Unlock the mutex to allow other threads to access the table
+    pthread_mutex_unlock(&tableMutex);
+}
+
+/* Calls visit for every item of the hash table (including collisions) */
+void iterateHashTable(HashTable *table, ItemVisitor visit, void *context) {
+    for (size_t i = 0; i < table->size; i++) {
+        for (HashItem *current = table->items[i]; current != NULL; current = current->next) {
+            visit(current->key, current->value, context);
+        }
+    }
+}
+
+/* ---- mutex strategy: the original shared table with a global mutex ---- */
+
+/* Creates the shared table, the global mutex is initialized statically.
+ * The threads insert holding the mutex, so they can share an arena */
+void *mutexInit(size_t capacity, int numberOfThreads) {
+    (void) numberOfThreads;
+
+    return createArenaHashTable(capacity, 1);
+}
+
+/* Adds every key of the batch taking the global mutex for each one */
+void mutexAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys) {
+    (void) tid;
+
+    // incrementOrInsertHashItem manages the mutex to prevent race conditions
+    for (size_t i = 0; i < numKeys; i++) {
+        incrementOrInsertHashItem(state, keys[i], counts ? counts[i] : 1);
+    }
+}
+
+/* Nothing to merge, every thread wrote to the shared table */
+void mutexMerge(void *state) {
+    (void) state;
+}
+
+void mutexIterate(void *state, ItemVisitor visit, void *context) {
+    iterateHashTable(state, visit, context);
+}
+
+void mutexDestroy(void *state) {
+    freeHashTable(state);
+}
+
+HashTable *mutexResultTable(void *state) {
+    return state;
+}
+
+void mutexReset(void *state) {
+    resetHashTable(state);
+}
+
+/* ---- striped strategy: shared table with a mutex per group of buckets ---- */
+
+/* Creates the shared table and the mutexes of the stripes */
+void *stripedInit(size_t capacity, int numberOfThreads) {
+    StripedState *striped = malloc(sizeof(StripedState));
+    if (striped == NULL) {
+        perror("Failed to allocate memory for striped state.");
+        return NULL;
+    }
+
+    // Threads on different stripes insert at the same time, every thread
+    // takes its items from an arena of its own
+    striped->table = createArenaHashTable(capacity, numberOfThreads);
+    if (striped->table == NULL) {
+        free(striped);
+        return NULL;
+    }
+
+    for (int i = 0; i < NUMBER_OF_STRIPES; i++) {
+        pthread_mutex_init(&striped->stripes[i], NULL);
+    }
+
+    return striped;
+}
+
+/* Adds every key of the batch locking only the stripe of its bucket, so
+ * threads working on different buckets don't wait for each other */
+void stripedAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys) {
+    StripedState *striped = state;
+    HashTable *table = striped->table;
+
+    for (size_t i = 0; i < numKeys; i++) {
+        int value = counts ? counts[i] : 1;
+        unsigned int index = hashGenerator(keys[i], table->size);
+        pthread_mutex_t *stripe = &striped->stripes[index % NUMBER_OF_STRIPES];
+
+        lockMutex(stripe, STRIPE_LOCK_ID(index % NUMBER_OF_STRIPES));
+
+        HashItem *current = table->items[index];
+        size_t comparisons = 0;
+        while (current != NULL && (comparisons++, strcmp(current->key, keys[i]) != 0)) {
+            current = current->next;
+        }
+        recordLookup(comparisons);
+
+        if (current != NULL) {
+            current->value += value;
+        } else {
+            HashItem *newItem = allocateHashItem(table, tid, keys[i], value);
+            if (newItem != NULL) {
+                newItem->next = table->items[index];
+                table->items[index] = newItem;
+
+                // Different stripes insert at the same time, so the count
+                // needs an atomic increment
+                __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+                MVP_PROBE2(key_insert, newItem->key, value);
+            }
+        }
+
+        pthread_mutex_unlock(stripe);
+    }
+}
+
+/* Nothing to merge, every thread wrote to the shared table */
+void stripedMerge(void *state) {
+    (void) state;
+}
+
+void stripedIterate(void *state, ItemVisitor visit, void *context) {
+    iterateHashTable(((StripedState *) state)->table, visit, context);
+}
+
+HashTable *stripedResultTable(void *state) {
+    return ((StripedState *) state)->table;
+}
+
+void stripedReset(void *state) {
+    resetHashTable(((StripedState *) state)->table);
+}
+
+/* Frees the table and destroys the mutexes of the stripes */
+void stripedDestroy(void *state) {
+    StripedState *striped = state;
+    if (striped == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < NUMBER_OF_STRIPES; i++) {
+        pthread_mutex_destroy(&striped->stripes[i]);
+    }
+    freeHashTable(striped->table);
+    free(striped);
+}
+
+/* ---- local strategy: private table per thread merged at the end ---- */
+
+/* Creates one private table per thread, each one sized for its share of the
+ * lines, the global table is created when merging */
+void *localInit(size_t capacity, int numberOfThreads) {
+    LocalState *local = calloc(1, sizeof(LocalState));
+    if (local == NULL) {
+        perror("Failed to allocate memory for local state.");
+        return NULL;
+    }
+
+    local->numberOfThreads = numberOfThreads;
+    local->localTables = calloc(numberOfThreads, sizeof(HashTable *));
+    if (local->localTables == NULL) {
+        perror("Failed to allocate memory for local tables.");
+        free(local);
+        return NULL;
+    }
+
+    // A thread can't see more different players than lines it processes
+    size_t localCapacity = ceilDivision(capacity, numberOfThreads);
+    if (localCapacity == 0) {
+        localCapacity = 1;
+    }
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        local->localTables[i] = createArenaHashTable(localCapacity, 1);
+        if (local->localTables[i] == NULL) {
+            localDestroy(local);
+            return NULL;
+        }
+    }
+
+    local->table = createArenaHashTable(capacity, 1);
+    if (local->table == NULL) {
+        localDestroy(local);
+        return NULL;
+    }
+
+    return local;
+}
+
+/* Adds every key of the batch to the private table of the thread, no locks
+ * are needed because no other thread touches that table */
+void localAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys) {
+    LocalState *local = state;
+    HashTable *table = local->localTables[tid];
+
+    for (size_t i = 0; i < numKeys; i++) {
+        addToHashItem(table, keys[i], counts ? counts[i] : 1);
+    }
+}
+
+/* Folds every private table into the global one and empties them, their
+ * memory is kept for the next run */
+void localMerge(void *state) {
+    LocalState *local = state;
+
+    for (int i = 0; i < local->numberOfThreads; i++) {
+        HashTable *localTable = local->localTables[i];
+        for (size_t j = 0; j < localTable->size; j++) {
+            for (HashItem *current = localTable->items[j]; current != NULL; current = current->next) {
+                addToHashItem(local->table, current->key, current->value);
+            }
+        }
+        resetHashTable(localTable);
+    }
+}
+
+void localIterate(void *state, ItemVisitor visit, void *context) {
+    iterateHashTable(((LocalState *) state)->table, visit, context);
+}
+
+HashTable *localResultTable(void *state) {
+    return ((LocalState *) state)->table;
+}
+
+/* The private tables were already emptied by the merge */
+void localReset(void *state) {
+    resetHashTable(((LocalState *) state)->table);
+}
+
+/* Frees the private tables and the global table */
+void localDestroy(void *state) {
+    LocalState *local = state;
+    if (local == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < local->numberOfThreads; i++) {
+        freeHashTable(local->localTables[i]);
+    }
+    free(local->localTables);
+    freeHashTable(local->table);
+    free(local);
+}
+
+/* ---- lockfree strategy: shared table updated with atomic operations ---- */
+
+/* Creates the shared table with an arena per thread, the threads insert at
+ * the same time */
+void *lockFreeInit(size_t capacity, int numberOfThreads) {
+    return createArenaHashTable(capacity, numberOfThreads);
+}
+
+/* Adds every key of the batch without locks. Existing items are incremented
+ * with an atomic add and new items are pushed at the head of the chain with a
+ * compare-and-swap, retrying if another thread changed the head meanwhile */
+void lockFreeAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys) {
+    HashTable *table = state;
+
+    for (size_t i = 0; i < numKeys; i++) {
+        int value = counts ? counts[i] : 1;
+        unsigned int index = hashGenerator(keys[i], table->size);
+        HashItem *newItem = NULL;
+
+        HashItem *head = __atomic_load_n(&table->items[index], __ATOMIC_ACQUIRE);
+        HashItem *scanned = NULL;   // Part of the chain already checked
+        size_t comparisons = 0;
+        while (1) {
+            // Items are only pushed at the head, so only the items added since
+            // the last attempt need to be checked
+            HashItem *current = head;
+            while (current != scanned && (comparisons++, strcmp(current->key, keys[i]) != 0)) {
+                current = current->next;
+            }
+
+            if (current != scanned) {
+                recordLookup(comparisons);
+                __atomic_fetch_add(&current->value, value, __ATOMIC_RELAXED);
+                if (newItem != NULL && table->arenas == NULL) {
+                    // Another thread inserted the same key first
+                    trackedFreeString(MEMORY_KEYS, newItem->key);
+                    trackedFree(MEMORY_HASH_ITEMS, newItem, sizeof(HashItem));
+                }
+                // An item taken from an arena stays unused until the reset
+                break;
+            }
+
+            if (newItem == NULL) {
+                newItem = allocateHashItem(table, tid, keys[i], value);
+                if (newItem == NULL) {
+                    break;
+                }
+            }
+
+            scanned = head;
+            newItem->next = head;
+            if (__atomic_compare_exchange_n(&table->items[index], &head, newItem, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+                recordLookup(comparisons);
+                __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+                MVP_PROBE2(key_insert, newItem->key, value);
+                break;
+            }
+            // The CAS failed and head now has the new head of the chain
+        }
+    }
+}
+
+/* Nothing to merge, every thread wrote to the shared table */
+void lockFreeMerge(void *state) {
+    (void) state;
+}
+
+void lockFreeIterate(void *state, ItemVisitor visit, void *context) {
+    iterateHashTable(state, visit, context);
+}
+
+void lockFreeDestroy(void *state) {
+    freeHashTable(state);
+}
+
+HashTable *lockFreeResultTable(void *state) {
+    return state;
+}
+
+void lockFreeReset(void *state) {
+    resetHashTable(state);
+}
+
+/* ---- sketch strategy: Space-Saving sketch per thread ---- */
+
+/* Swaps two counters of the heap keeping their heap index updated */
+void sketchSwap(Sketch *sketch, size_t a, size_t b) {
+    SketchCounter *temp = sketch->heap[a];
+    sketch->heap[a] = sketch->heap[b];
+    sketch->heap[b] = temp;
+    sketch->heap[a]->heapIndex = a;
+    sketch->heap[b]->heapIndex = b;
+}
+
+/* Moves a counter down the heap after its value increased */
+void sketchSiftDown(Sketch *sketch, size_t index) {
+    while (1) {
+        size_t smallest = index;
+        size_t left = 2 * index + 1;
+        size_t right = 2 * index + 2;
+
+        if (left < sketch->used && sketch->heap[left]->value < sketch->heap[smallest]->value) {
+            smallest = left;
+        }
+        if (right < sketch->used && sketch->heap[right]->value < sketch->heap[smallest]->value) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+
+        sketchSwap(sketch, index, smallest);
+        index = smallest;
+    }
+}
+
+/* Moves a counter up the heap after it was appended at the end */
+void sketchSiftUp(Sketch *sketch, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (sketch->heap[parent]->value <= sketch->heap[index]->value) {
+            return;
+        }
+        sketchSwap(sketch, index, parent);
+        index = parent;
+    }
+}
+
+/* Adds value to key in the sketch. When the sketch is full the counter with
+ * the smallest value is reused for the new key and it inherits its count, so
+ * the counts are never underestimated */
+void sketchAdd(Sketch *sketch, char *key, int value) {
+    unsigned int index = hashGenerator(key, sketch->capacity);
+
+    SketchCounter *current = sketch->buckets[index];
+    size_t comparisons = 0;
+    while (current != NULL && (comparisons++, strcmp(current->key, key) != 0)) {
+        current = current->next;
+    }
+    recordLookup(comparisons);
+
+    if (current != NULL) {
+        current->value += value;
+        sketchSiftDown(sketch, current->heapIndex);
+        return;
+    }
+
+    if (sketch->used < sketch->capacity) {
+        // Free counter available
+        current = &sketch->counters[sketch->used];
+        current->key = trackedStrdup(MEMORY_KEYS, key);
+        if (current->key == NULL) {
+            perror("Failed to allocate memory for sketch key.");
+            return;
+        }
+        current->value = value;
+        current->heapIndex = sketch->used;
+        sketch->heap[sketch->used] = current;
+        sketch->used++;
+        MVP_PROBE2(key_insert, current->key, value);
+        sketchSiftUp(sketch, current->heapIndex);
+    } else {
+        // Replace the counter with the smallest value
+        current = sketch->heap[0];
+        char *newKey = trackedStrdup(MEMORY_KEYS, key);
+        if (newKey == NULL) {
+            perror("Failed to allocate memory for sketch key.");
+            return;
+        }
+
+        // Unlink it from the bucket of its old key
+        SketchCounter **link = &sketch->buckets[hashGenerator(current->key, sketch->capacity)];
+        while (*link != current) {
+            link = &(*link)->next;
+        }
+        *link = current->next;
+
+        trackedFreeString(MEMORY_KEYS, current->key);
+        current->key = newKey;
+        current->value += value;
+        MVP_PROBE2(key_insert, current->key, current->value);
+        sketchSiftDown(sketch, 0);
+    }
+
+    current->next = sketch->buckets[index];
+    sketch->buckets[index] = current;
+}
+
+/* Creates one sketch per thread with sketchCapacity counters each */
+void *sketchInit(size_t capacity, int numberOfThreads) {
+    SketchState *sketchState = calloc(1, sizeof(SketchState));
+    if (sketchState == NULL) {
+        perror("Failed to allocate memory for sketch state.");
+        return NULL;
+    }
+
+    sketchState->numberOfThreads = numberOfThreads;
+    sketchState->sketches = calloc(numberOfThreads, sizeof(Sketch));
+    if (sketchState->sketches == NULL) {
+        perror("Failed to allocate memory for sketches.");
+        free(sketchState);
+        return NULL;
+    }
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        Sketch *sketch = &sketchState->sketches[i];
+        sketch->capacity = sketchCapacity;
+        sketch->counters = trackedCalloc(MEMORY_HASH_ITEMS, sketchCapacity, sizeof(SketchCounter));
+        sketch->heap = trackedCalloc(MEMORY_BUCKETS, sketchCapacity, sizeof(SketchCounter *));
+        sketch->buckets = trackedCalloc(MEMORY_BUCKETS, sketchCapacity, sizeof(SketchCounter *));
+        if (sketch->counters == NULL || sketch->heap == NULL || sketch->buckets == NULL) {
+            perror("Failed to allocate memory for sketch.");
+            sketchDestroy(sketchState);
+            return NULL;
+        }
+    }
+
+    // The merged table never holds more players than the counters of all the
+    // sketches together
+    size_t tableCapacity = sketchCapacity * numberOfThreads;
+    if (capacity < tableCapacity) {
+        tableCapacity = capacity;
+    }
+    sketchState->table = createArenaHashTable(tableCapacity > 0 ? tableCapacity : 1, 1);
+    if (sketchState->table == NULL) {
+        sketchDestroy(sketchState);
+        return NULL;
+    }
+
+    return sketchState;
+}
+
+/* Adds every key of the batch to the sketch of the thread (no locks) */
+void sketchAddBatch(void *state, int tid, char **keys, const int *counts, size_t numKeys) {
+    Sketch *sketch = &((SketchState *) state)->sketches[tid];
+
+    for (size_t i = 0; i < numKeys; i++) {
+        sketchAdd(sketch, keys[i], counts ? counts[i] : 1);
+    }
+}
+
+/* Sums the counters of every sketch into the merged table */
+void sketchMerge(void *state) {
+    SketchState *sketchState = state;
+
+    for (int i = 0; i < sketchState->numberOfThreads; i++) {
+        Sketch *sketch = &sketchState->sketches[i];
+        for (size_t j = 0; j < sketch->used; j++) {
+            addToHashItem(sketchState->table, sketch->counters[j].key, sketch->counters[j].value);
+        }
+    }
+}
+
+void sketchIterate(void *state, ItemVisitor visit, void *context) {
+    iterateHashTable(((SketchState *) state)->table, visit, context);
+}
+
+HashTable *sketchResultTable(void *state) {
+    return ((SketchState *) state)->table;
+}
+
+/* Frees the keys of every sketch and empties the sketches and the merged
+ * table. The keys of a sketch are still duplicated one by one, a counter
+ * replaced by eviction needs its own copy of the new key */
+void sketchReset(void *state) {
+    SketchState *sketchState = state;
+
+    for (int i = 0; i < sketchState->numberOfThreads; i++) {
+        Sketch *sketch = &sketchState->sketches[i];
+        for (size_t j = 0; j < sketch->used; j++) {
+            trackedFreeString(MEMORY_KEYS, sketch->counters[j].key);
+        }
+        memset(sketch->buckets, 0, sketch->capacity * sizeof(SketchCounter *));
+        sketch->used = 0;
+    }
+    resetHashTable(sketchState->table);
+}
+
+/* Frees the keys of every sketch, the sketches and the merged table */
+void sketchDestroy(void *state) {
+    SketchState *sketchState = state;
+    if (sketchState == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < sketchState->numberOfThreads; i++) {
+        Sketch *sketch = &sketchState->sketches[i];
+        for (size_t j = 0; j < sketch->used; j++) {
+            trackedFreeString(MEMORY_KEYS, sketch->counters[j].key);
+        }
+        trackedFree(MEMORY_HASH_ITEMS, sketch->counters, sketch->capacity * sizeof(SketchCounter));
+        trackedFree(MEMORY_BUCKETS, sketch->heap, sketch->capacity * sizeof(SketchCounter *));
+        trackedFree(MEMORY_BUCKETS, sketch->buckets, sketch->capacity * sizeof(SketchCounter *));
+    }
+    free(sketchState->sketches);
+    freeHashTable(sketchState->table);
+    free(sketchState);
+}
+
+/* Counts visible UTF-8 characters (not bytes) so it handles multibyte chars
+ * to avoid displacing the columns in the report. (happens with
+ * characters like ñ, á, é, ü, etc.) */
+int countVisibleCharacters(const char *str) {
+    int count = 0;
+    int i = 0;
+
+    // Iterate through the string and count visible characters
+    while (str[i] != '\0') {
+        // Check if the current byte is the start of a multibyte character
+        if ((str[i] & 0xC0) != 0x80) {
+            count++;
+        }
+        i++;
+    }
+
+    return count;
+}
+
+/* ItemVisitor that appends a (player, count) pair to a SortableList,
+ * the array grows by doubling its capacity */
+void appendSortableItem(const char *key, int value, void *context) {
+    SortableList *list = context;
+
+    if (list->count == list->capacity) {
+        size_t newCapacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        SortableItem *newItems = trackedRealloc(MEMORY_NAMES, list->items, list->capacity * sizeof(SortableItem),
+                                                newCapacity * sizeof(SortableItem));
+        if (newItems == NULL) {
+            perror("Failed to allocate memory for sortable items.");
+            return;
+        }
+        list->items = newItems;
+        list->capacity = newCapacity;
+    }
+
+    list->items[list->count].key = (char *) key;
+    list->items[list->count].value = value;
+    list->count++;
+}
+
+/* Writes a report of players sorted by their MVP counts (descending)
+ * return 0 on success or -1 on error */
+int writeReportOfPlayersSortedByMVPCount(const AggregationStrategy *strategy, void *state, const char *reportFileName) {
+
+    double phaseStart = startPhaseTime();
+    MVP_PROBE1(report_write_start, reportFileName);
+
+    // Copy all the entries of the aggregation to a sortable array, with
+    // --repeat the array of the previous run is reused
+    SortableList localList = {NULL, 0, 0};
+    SortableList *list = runScratch.enabled ? &runScratch.sortList : &localList;
+    list->count = 0;
+    strategy->iterate(state, appendSortableItem, list);
+    SortableItem *sortedItems = list->items;
+
+    // Sort by MVP count (descending), a run stopped by the deadline before
+    // any line may have nothing to sort
+    if (list->count > 0) {
+        qsort(sortedItems, list->count, sizeof(SortableItem), compareByMVPCounts);
+    }
+
+    addPhaseTime(PHASE_SORT, phaseStart);
+    phaseStart = startPhaseTime();
+
+    // Write the sorted result to the report file (reporte_mvp.txt by default)
+    FILE *fptr;
+    fptr = fopen(reportFileName, "w");
+    if (fptr == NULL) {
+        perror("Error creating report file");
+        trackedFree(MEMORY_NAMES, localList.items, localList.capacity * sizeof(SortableItem));
+        return -1;
+    }
+
+    // Report header
+    fprintf(fptr, "Jugador MVP%*s|\tPremios\n", 13, "");
+    fprintf(fptr, "-----------------------------------\n");
+
+    // Write each entry procuring aligned columns
+    for (size_t i = 0; i < list->count; i++) {
+        writeReportLine(fptr, sortedItems[i].key, sortedItems[i].value);
+    }
+
+    fclose(fptr);
+    trackedFree(MEMORY_NAMES, localList.items, localList.capacity * sizeof(SortableItem));
+
+    MVP_PROBE2(report_write_end, reportFileName, list->count);
+    addPhaseTime(PHASE_REPORT, phaseStart);
+
+    return 0;
+}
+
+/* Writes the line of a player in the report with the name padded to 24
+ * visible characters */
+void writeReportLine(FILE *file, const char *key, int value) {
+    // Pad the player name with spaces so all names have the same display
+    // width, counting visible characters (not bytes)
+    int padding = 24 - countVisibleCharacters(key);
+    fprintf(file, "%s%*s|\t%d\n", key, padding > 0 ? padding : 0, "", value);
+}
+
+/* Frees the memory allocated for the hash table and its items */
+void freeHashTable(HashTable *table) {
+    if (table == NULL) {
+        return;
+    }
+
+    // Items taken from arenas are freed with them, the rest one by one
+    if (table->arenas != NULL) {
+        for (int i = 0; i < table->numArenas; i++) {
+            freeArena(&table->arenas[i]);
+        }
+        trackedFree(MEMORY_BUCKETS, table->arenas, table->numArenas * sizeof(Arena));
+    } else {
+        freeHashItems(table);
+    }
+
+    // Free the array of item pointers and the hash table itself
+    trackedFree(MEMORY_BUCKETS, table->items, table->size * sizeof(HashItem *));
+    trackedFree(MEMORY_BUCKETS, table, sizeof(HashTable));
+}
+
+/* Frees every item of a table without arenas (including collisions) */
+void freeHashItems(HashTable *table) {
+    for (size_t i = 0; i < table->size; i++) {
+        HashItem *item = table->items[i];
+
+        while (item != NULL) {
+            // Save reference to current item before moving to next
+            HashItem *temp = item;
+            item = item->next;
+
+            // Free the item key and the item itself
+            trackedFreeString(MEMORY_KEYS, temp->key);
+            trackedFree(MEMORY_HASH_ITEMS, temp, sizeof(HashItem));
+        }
+    }
+}
+
+/* Empties the table for another run keeping its bucket array. The arenas are
+ * rewound, so the items of the next run reuse their blocks, and items
+ * allocated one by one are freed */
+void resetHashTable(HashTable *table) {
+    if (table->arenas != NULL) {
+        for (int i = 0; i < table->numArenas; i++) {
+            resetArena(&table->arenas[i]);
+        }
+    } else {
+        freeHashItems(table);
+    }
+
+    memset(table->items, 0, table->size * sizeof(HashItem *));
+    table->count = 0;
+}
+
+/* Hands out size bytes of the arena (aligned for a HashItem), taking them from
+ * the current block, from the next blocks kept by a reset or from a new
+ * block. Returns NULL if a new block can't be allocated */
+void *arenaAllocate(Arena *arena, size_t size) {
+    size = (size + _Alignof(HashItem) - 1) & ~(_Alignof(HashItem) - 1);
+
+    // Blocks left behind are skipped, their tail is only a small loss
+    ArenaBlock *block = arena->current;
+    while (block != NULL && block->used + size > block->size && block->next != NULL) {
+        block = block->next;
+    }
+
+    if (block == NULL || block->used + size > block->size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *newBlock = trackedMalloc(MEMORY_ARENAS, sizeof(ArenaBlock) + blockSize);
+        if (newBlock == NULL) {
+            return NULL;
+        }
+        newBlock->next = NULL;
+        newBlock->size = blockSize;
+        newBlock->used = 0;
+
+        if (block == NULL) {
+            arena->first = newBlock;
+        } else {
+            block->next = newBlock;
+        }
+        block = newBlock;
+    }
+
+    arena->current = block;
+    void *pointer = block->data + block->used;
+    block->used += size;
+
+    return pointer;
+}
+
+/* Rewinds the arena to its first block, keeping every block for reuse */
+void resetArena(Arena *arena) {
+    for (ArenaBlock *block = arena->first; block != NULL; block = block->next) {
+        block->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+/* Frees every block of the arena */
+void freeArena(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        trackedFree(MEMORY_ARENAS, block, sizeof(ArenaBlock) + block->size);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+/* Looks for a key in the hash table without locking
+ * returns its item or NULL if it isn't in the table */
+HashItem *findHashItem(HashTable *table, char *key) {
+    HashItem *current = table->items[hashGenerator(key, table->size)];
+    while (current != NULL && strcmp(current->key, key) != 0) {
+        current = current->next;
+    }
+    return current;
+}
+
+/* ItemVisitor that writes a (player, count) pair as a snapshot line */
+void writeSnapshotItem(const char *key, int value, void *context) {
+    fprintf((FILE *) context, "%d\t%s\n", value, key);
+}
+
+/* Saves the merged aggregate of a state to a snapshot file: a header line,
+ * a "# fingerprint" line if fingerprint isn't NULL and a "count<TAB>player"
+ * line per player. Returns 0 on success or -1 on error */
+int writeSnapshot(const AggregationStrategy *strategy, void *state, const char *snapshotFileName,
+                  const char *fingerprint) {
+    FILE *file = fopen(snapshotFileName, "w");
+    if (file == NULL) {
+        perror("Error creating snapshot file");
+        return -1;
+    }
+
+    fprintf(file, "%s\n", SNAPSHOT_HEADER);
+    if (fingerprint != NULL) {
+        fprintf(file, "# fingerprint %s\n", fingerprint);
+    }
+    strategy->iterate(state, writeSnapshotItem, file);
+
+    if (fclose(file) == EOF) {
+        perror("Error writing snapshot file");
+        return -1;
+    }
+    return 0;
+}
+
+/* Returns 1 if the path is a snapshot file (starts with the header) */
+int isSnapshotFile(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char buffer[64];
+    int isSnapshot = fgets(buffer, sizeof(buffer), file) != NULL &&
+                     strncmp(buffer, SNAPSHOT_HEADER, strlen(SNAPSHOT_HEADER)) == 0;
+    fclose(file);
+
+    return isSnapshot;
+}
+
+/* Adds the counts of a snapshot file to a state (before merging it), in
+ * batches as the thread tid. Returns 0 on success or -1 on error */
+int loadSnapshot(const AggregationStrategy *strategy, void *state, const char *snapshotFileName, int tid) {
+    FILE *file = fopen(snapshotFileName, "r");
+    if (file == NULL) {
+        perror("Error opening snapshot file");
+        return -1;
+    }
+
+    char *buffer = NULL;
+    size_t capacity = 0;
+    char *keys[KEY_BATCH_SIZE];
+    int counts[KEY_BATCH_SIZE];
+    size_t numKeys = 0;
+
+    // Skip the header
+    if (getline(&buffer, &capacity, file) == -1) {
+        free(buffer);
+        fclose(file);
+        return -1;
+    }
+
+    int status = 0;
+    while (getline(&buffer, &capacity, file) != -1) {
+        // Lines starting with # (like the fingerprint) aren't counts
+        char *separator = strchr(buffer, '\t');
+        if (buffer[0] == '#' || separator == NULL) {
+            continue;
+        }
+        *separator = '\0';
+        char *key = separator + 1;
+        key[strcspn(key, "\r\n")] = '\0';
+
+        keys[numKeys] = strdup(key);
+        if (keys[numKeys] == NULL) {
+            perror("Error allocating memory for snapshot key");
+            status = -1;
+            break;
+        }
+        counts[numKeys] = atoi(buffer);
+        numKeys++;
+
+        if (numKeys == KEY_BATCH_SIZE) {
+            strategy->addBatch(state, tid, keys, counts, numKeys);
+            for (size_t i = 0; i < numKeys; i++) {
+                free(keys[i]);
+            }
+            numKeys = 0;
+        }
+    }
+
+    strategy->addBatch(state, tid, keys, counts, numKeys);
+    for (size_t i = 0; i < numKeys; i++) {
+        free(keys[i]);
+    }
+
+    free(buffer);
+    fclose(file);
+    return status;
+}
+
+/* Describes the inputs and the query in a single line: the options that
+ * change the counts and the path, size, modification and change times,
+ * device and inode of every file (and the hash of sampled blocks with
+ * --cache-sample). The change time can't be set back by the user, so an
+ * edit hidden with touch -r still changes the fingerprint.
+ * Returns the fingerprint (freed by the caller) or NULL on error */
+char *buildCacheFingerprint(InputList *inputList, ProgramOptions *options) {
+    char *fingerprint = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&fingerprint, &length);
+    if (stream == NULL) {
+        perror("Error building the cache fingerprint");
+        return NULL;
+    }
+
+    // Every exact strategy gives the same counts, the sketch depends on its size
+    const ParserQuery *query = &options->query;
+    fprintf(stream, "column=%d delimiter=%d filter=%d:%s dedup=%d", query->column, query->delimiter,
+            query->filterColumn, query->filterPrefix != NULL ? query->filterPrefix : "", options->dedup);
+    if (strcmp(options->strategy->name, "sketch") == 0) {
+        fprintf(stream, " sketch=%zu", sketchCapacity);
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < inputList->count; i++) {
+        struct stat fileStat;
+        if (stat(inputList->files[i].path, &fileStat) == -1) {
+            status = -1;
+            break;
+        }
+        fprintf(stream, " | %s %lld %lld.%09ld %lld.%09ld %llu %llu", inputList->files[i].path,
+                (long long) fileStat.st_size, (long long) fileStat.st_mtim.tv_sec, fileStat.st_mtim.tv_nsec,
+                (long long) fileStat.st_ctim.tv_sec, fileStat.st_ctim.tv_nsec,
+                (unsigned long long) fileStat.st_dev, (unsigned long long) fileStat.st_ino);
+        if (options->cacheSample) {
+            fprintf(stream, " %016llx",
+                    (unsigned long long) hashSampledBlocks(inputList->files[i].path, fileStat.st_size));
+        }
+    }
+
+    if (fclose(stream) == EOF || status == -1) {
+        free(fingerprint);
+        return NULL;
+    }
+    return fingerprint;
+}
+
+/* Hashes CACHE_SAMPLES blocks spread evenly over a file, the first one at
+ * the start and the last one at the end */
+uint64_t hashSampledBlocks(const char *path, long size) {
+    uint64_t hashValue = 14695981039346656037ULL;
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor == -1) {
+        return 0;
+    }
+
+    unsigned char block[CACHE_SAMPLE_SIZE];
+    long last = size > CACHE_SAMPLE_SIZE ? size - CACHE_SAMPLE_SIZE : 0;
+    for (int i = 0; i < CACHE_SAMPLES; i++) {
+        ssize_t bytesRead = pread(descriptor, block, sizeof(block), last / (CACHE_SAMPLES - 1) * i);
+        if (bytesRead > 0) {
+            hashValue = hashBytes(hashValue, block, bytesRead);
+        }
+    }
+
+    close(descriptor);
+    return hashValue;
+}
+
+/* Continues a 64 bits FNV-1a hash with the given bytes */
+uint64_t hashBytes(uint64_t hashValue, const unsigned char *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hashValue ^= bytes[i];
+        hashValue *= 1099511628211ULL;
+    }
+    return hashValue;
+}
+
+/* Continues a hash with the given bytes 8 at a time, each word is mixed with
+ * a multiplication and a shift. The last word is padded with zeros and
+ * carries the length, so the same bytes with different lengths differ */
+uint64_t hashWords(uint64_t hashValue, const unsigned char *bytes, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hashValue = (hashValue ^ word) * 0x9E3779B97F4A7C15ULL;
+        hashValue ^= hashValue >> 32;
+    }
+
+    uint64_t word = (uint64_t) length << 56;
+    for (size_t j = 0; i + j < length; j++) {
+        word ^= (uint64_t) bytes[i + j] << (8 * j);
+    }
+    hashValue = (hashValue ^ word) * 0x9E3779B97F4A7C15ULL;
+    hashValue ^= hashValue >> 32;
+
+    return hashValue;
+}
+
+/* Loads a cached aggregate into a new merged state, only if its fingerprint
+ * line is the given fingerprint. Returns the states (one) or NULL if there
+ * isn't a valid entry */
+void **loadCacheEntry(const AggregationStrategy *strategy, const char *cacheFileName, const char *fingerprint,
+                      int numberOfThreads) {
+    FILE *file = fopen(cacheFileName, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    // The header and the fingerprint must be the first two lines
+    char *line = NULL;
+    size_t capacity = 0;
+    int valid = getline(&line, &capacity, file) != -1 &&
+                strncmp(line, SNAPSHOT_HEADER, strlen(SNAPSHOT_HEADER)) == 0 &&
+                getline(&line, &capacity, file) != -1 &&
+                strncmp(line, "# fingerprint ", 14) == 0;
+    if (valid) {
+        line[strcspn(line, "\n")] = '\0';
+        valid = strcmp(line + 14, fingerprint) == 0;
+    }
+    free(line);
+    fclose(file);
+    if (!valid) {
+        return NULL;
+    }
+
+    int lineCount = getLineCountFromFile(cacheFileName);
+    void **states = createStates(strategy, &lineCount, 1, numberOfThreads);
+    if (states == NULL) {
+        return NULL;
+    }
+    if (loadSnapshot(strategy, states[0], cacheFileName, 0) == -1) {
+        destroyStates(strategy, states, 1);
+        return NULL;
+    }
+    strategy->merge(states[0]);
+
+    fprintf(stderr, "Aggregate loaded from the cache (%s).\n", cacheFileName);
+    return states;
+}
+
+/* Saves the aggregate of a state in the cache with its fingerprint. It is
+ * written to a temporary file and renamed, so a concurrent run never reads
+ * a partial entry. Returns 0 on success or -1 on error */
+int storeCacheEntry(const AggregationStrategy *strategy, void *state, const char *cacheFileName,
+                    const char *fingerprint) {
+    char temporaryFileName[4200];
+    snprintf(temporaryFileName, sizeof(temporaryFileName), "%s.%d.tmp", cacheFileName, (int) getpid());
+
+    if (writeSnapshot(strategy, state, temporaryFileName, fingerprint) == -1) {
+        remove(temporaryFileName);
+        return -1;
+    }
+    if (rename(temporaryFileName, cacheFileName) == -1) {
+        perror("Error storing the cache entry");
+        remove(temporaryFileName);
+        return -1;
+    }
+    return 0;
+}
+
+/* ItemVisitor that interns a player of one side of the diff: the first time
+ * a name is seen it gets the next ID, and its count is stored in the entry of
+ * that ID for the side being visited */
+void internDiffItem(const char *key, int value, void *context) {
+    DiffJoin *join = context;
+
+    HashItem *item = findHashItem(join->ids, (char *) key);
+    if (item == NULL) {
+        if (join->count == join->capacity) {
+            size_t newCapacity = join->capacity == 0 ? 64 : join->capacity * 2;
+            DiffEntry *newEntries = trackedRealloc(MEMORY_NAMES, join->entries, join->capacity * sizeof(DiffEntry),
+                                                   newCapacity * sizeof(DiffEntry));
+            if (newEntries == NULL) {
+                perror("Failed to allocate memory for diff entries.");
+                return;
+            }
+            join->entries = newEntries;
+            join->capacity = newCapacity;
+        }
+
+        if (addToHashItem(join->ids, (char *) key, join->count) == -1) {
+            return;
+        }
+        join->entries[join->count] = (DiffEntry) {(char *) key, 0, 0, 0, 0};
+        item = findHashItem(join->ids, (char *) key);
+        join->count++;
+    }
+
+    DiffEntry *entry = &join->entries[item->value];
+    if (join->side == 0) {
+        entry->previousCount = value;
+    } else {
+        entry->currentCount = value;
+    }
+}
+
+// Side whose count is used by compareDiffEntries (qsort has no context)
+int diffSortSide = 1;
+
+/* Comparison function for qsort to sort diff entries by the count of
+ * diffSortSide (descending), then by the other count and by name */
+int compareDiffEntries(const void *a, const void *b) {
+    const DiffEntry *entryA = a;
+    const DiffEntry *entryB = b;
+    int countA = diffSortSide == 0 ? entryA->previousCount : entryA->currentCount;
+    int countB = diffSortSide == 0 ? entryB->previousCount : entryB->currentCount;
+    int otherA = diffSortSide == 0 ? entryA->currentCount : entryA->previousCount;
+    int otherB = diffSortSide == 0 ? entryB->currentCount : entryB->previousCount;
+
+    if (countA != countB) {
+        return countB - countA;
+    }
+    if (otherA != otherB) {
+        return otherB - otherA;
+    }
+    return strcmp(entryA->key, entryB->key);
+}
+
+/* Sorts the entries by the count of a side and stores the rank of every
+ * player on that side. Players with the same count share the rank (1, 2, 2, 4)
+ * and players absent from that side get rank 0 */
+void rankDiffEntries(DiffEntry *entries, size_t count, int side) {
+    diffSortSide = side;
+    qsort(entries, count, sizeof(DiffEntry), compareDiffEntries);
+
+    for (size_t i = 0; i < count; i++) {
+        int value = side == 0 ? entries[i].previousCount : entries[i].currentCount;
+        int previousValue = i == 0 ? -1 : (side == 0 ? entries[i - 1].previousCount : entries[i - 1].currentCount);
+        int previousRank = i == 0 ? 0 : (side == 0 ? entries[i - 1].previousRank : entries[i - 1].currentRank);
+        int rank = value == 0 ? 0 : (value == previousValue ? previousRank : (int) i + 1);
+
+        if (side == 0) {
+            entries[i].previousRank = rank;
+        } else {
+            entries[i].currentRank = rank;
+        }
+    }
+}
+
+/* Joins the players of two merged states through interned IDs and writes the
+ * count of each input, the delta and the rank change of every player, sorted
+ * by the current count. Returns 0 on success or -1 on error */
+int writeDiffReport(const AggregationStrategy *strategy, void *previousState, void *currentState,
+                    const char *reportFileName) {
+    DiffJoin join = {NULL, NULL, 0, 0, 0};
+
+    // Count the players of both sides to size the ID table
+    SortableList previousList = {NULL, 0, 0};
+    SortableList currentList = {NULL, 0, 0};
+    strategy->iterate(previousState, appendSortableItem, &previousList);
+    strategy->iterate(currentState, appendSortableItem, &currentList);
+    size_t capacity = previousList.count + currentList.count;
+    trackedFree(MEMORY_NAMES, previousList.items, previousList.capacity * sizeof(SortableItem));
+    trackedFree(MEMORY_NAMES, currentList.items, currentList.capacity * sizeof(SortableItem));
+
+    join.ids = createHashTable(capacity > 0 ? capacity : 1);
+    if (join.ids == NULL) {
+        return -1;
+    }
+
+    // Intern the players of both sides, the counts are joined by ID
+    join.side = 0;
+    strategy->iterate(previousState, internDiffItem, &join);
+    join.side = 1;
+    strategy->iterate(currentState, internDiffItem, &join);
+
+    rankDiffEntries(join.entries, join.count, 0);
+    rankDiffEntries(join.entries, join.count, 1);
+
+    FILE *fptr = fopen(reportFileName, "w");
+    if (fptr == NULL) {
+        perror("Error creating diff report file");
+        trackedFree(MEMORY_NAMES, join.entries, join.capacity * sizeof(DiffEntry));
+        freeHashTable(join.ids);
+        return -1;
+    }
+
+    // Report header
+    fprintf(fptr, "Jugador MVP%*s|\tAnterior\t|\tActual\t|\tDelta\t|\tRanking\n", 13, "");
+    fprintf(fptr, "---------------------------------------------------------------------------\n");
+
+    for (size_t i = 0; i < join.count; i++) {
+        DiffEntry *entry = &join.entries[i];
+        char buffer[100] = {0};
+        snprintf(buffer, sizeof(buffer), "%s", entry->key);
+
+        // Pad player name with spaces so all names have the same display width
+        for (int j = countVisibleCharacters(buffer); j < 24 && strlen(buffer) < sizeof(buffer) - 1; j++) {
+            strcat(buffer, " ");
+        }
+
+        // Rank change: positive when the player climbed
+        char rankChange[64];
+        if (entry->previousRank == 0) {
+            snprintf(rankChange, sizeof(rankChange), "- -> %d (nuevo)", entry->currentRank);
+        } else if (entry->currentRank == 0) {
+            snprintf(rankChange, sizeof(rankChange), "%d -> - (sale)", entry->previousRank);
+        } else {
+            snprintf(rankChange, sizeof(rankChange), "%d -> %d (%+d)", entry->previousRank,
+                     entry->currentRank, entry->previousRank - entry->currentRank);
+        }
+
+        fprintf(fptr, "%s|\t%d\t\t|\t%d\t|\t%+d\t|\t%s\n", buffer, entry->previousCount,
+                entry->currentCount, entry->currentCount - entry->previousCount, rankChange);
+    }
+
+    fclose(fptr);
+    trackedFree(MEMORY_NAMES, join.entries, join.capacity * sizeof(DiffEntry));
+    freeHashTable(join.ids);
+
+    return 0;
+}
+
+/* Returns the time of the monotonic clock in seconds */
+double nowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Returns the start time of a phase, without reading the clock when neither
+ * --stats nor --trace will use it */
+double startPhaseTime(void) {
+    return statistics.enabled || threadTraceRing != NULL ? nowSeconds() : 0;
+}
+
+/* Adds the time elapsed since startSeconds to a phase (only with --stats)
+ * and records it in the trace of the thread (only with --trace) */
+void addPhaseTime(Phase phase, double startSeconds) {
+    if (!statistics.enabled && threadTraceRing == NULL) {
+        return;
+    }
+
+    double endSeconds = nowSeconds();
+    if (statistics.enabled) {
+        statistics.phaseSeconds[phase] += endSeconds - startSeconds;
+    }
+    traceEvent(phaseNames[phase], startSeconds, endSeconds);
+}
+
+/* Prints the time of every phase and thread and the throughput of the run */
+void printStatistics(InputList *inputList) {
+    long bytes = 0;
+    long lines = 0;
+    for (size_t i = 0; i < inputList->count; i++) {
+        bytes += inputList->files[i].size;
+        lines += inputList->files[i].lineCount;
+    }
+
+    double totalSeconds = 0;
+    for (int i = 0; i < NUMBER_OF_PHASES; i++) {
+        totalSeconds += statistics.phaseSeconds[i];
+    }
+
+    fprintf(stderr, "\n--- Statistics ---\n");
+    fprintf(stderr, "Input: %zu files, %ld bytes, %ld lines\n", inputList->count, bytes, lines);
+    fprintf(stderr, "%-20s %12s %8s\n", "Phase", "Time (ms)", "%");
+    for (int i = 0; i < NUMBER_OF_PHASES; i++) {
+        fprintf(stderr, "%-20s %12.3f %7.1f%%\n", phaseNames[i], statistics.phaseSeconds[i] * 1e3,
+                totalSeconds > 0 ? 100 * statistics.phaseSeconds[i] / totalSeconds : 0);
+    }
+    fprintf(stderr, "%-20s %12.3f\n", "total", totalSeconds * 1e3);
+
+    // Throughput of the scan alone and of the whole run
+    double scanSeconds = statistics.phaseSeconds[PHASE_SCAN];
+    if (scanSeconds > 0) {
+        fprintf(stderr, "Scan throughput:  %10.2f MB/s %14.0f lines/s\n", bytes / scanSeconds / 1e6,
+                lines / scanSeconds);
+    }
+    if (totalSeconds > 0) {
+        fprintf(stderr, "Total throughput: %10.2f MB/s %14.0f lines/s\n", bytes / totalSeconds / 1e6,
+                lines / totalSeconds);
+    }
+
+    if (statistics.threads == NULL) {
+        return;
+    }
+
+    fprintf(stderr, "%-6s %6s %10s %10s %12s %12s %14s %12s\n", "Thread", "Chunks", "Lines", "Keys", "Bytes",
+            "Extract (ms)", "Aggregate (ms)", "Total (ms)");
+    for (int i = 0; i < statistics.numberOfThreads; i++) {
+        ThreadStats *threadStats = &statistics.threads[i];
+        fprintf(stderr, "%-6d %6ld %10ld %10ld %12ld %12.3f %14.3f %12.3f\n", i, threadStats->units,
+                threadStats->lines, threadStats->keys, threadStats->bytes, threadStats->extractSeconds * 1e3,
+                threadStats->aggregateSeconds * 1e3, threadStats->totalSeconds * 1e3);
+    }
+
+    // Blocks reused with --memo-dir
+    long memoLoaded = 0;
+    long memoScanned = 0;
+    for (int i = 0; i < statistics.numberOfThreads; i++) {
+        memoLoaded += statistics.threads[i].memoLoaded;
+        memoScanned += statistics.threads[i].memoScanned;
+    }
+    if (memoLoaded + memoScanned > 0) {
+        fprintf(stderr, "Memoized blocks: %ld loaded, %ld scanned\n", memoLoaded, memoScanned);
+    }
+
+    // Key comparisons per lookup measured by the threads
+    LookupStats lookupStats = {0};
+    for (int i = 0; i < statistics.numberOfThreads; i++) {
+        lookupStats.lookups += statistics.threads[i].lookupStats.lookups;
+        lookupStats.comparisons += statistics.threads[i].lookupStats.comparisons;
+    }
+    if (lookupStats.lookups > 0) {
+        fprintf(stderr, "Lookups: %ld, key comparisons per lookup: %.3f\n", lookupStats.lookups,
+                (double) lookupStats.comparisons / lookupStats.lookups);
+    }
+
+    printLockStatistics();
+}
+
+/* Prints the current and peak bytes and the allocations of every subsystem
+ * and the peak resident set size of the process */
+void printMemoryStatistics(void) {
+    fprintf(stderr, "%-16s %14s %14s %12s\n", "Memory", "Current (B)", "Peak (B)", "Allocations");
+    for (int i = 0; i < NUMBER_OF_MEMORY_SUBSYSTEMS; i++) {
+        fprintf(stderr, "%-16s %14ld %14ld %12ld\n", memorySubsystemNames[i],
+                __atomic_load_n(&statistics.memory[i].currentBytes, __ATOMIC_RELAXED),
+                __atomic_load_n(&statistics.memory[i].peakBytes, __ATOMIC_RELAXED),
+                __atomic_load_n(&statistics.memory[i].allocations, __ATOMIC_RELAXED));
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // ru_maxrss is in kilobytes on Linux
+        fprintf(stderr, "%-16s %14s %14ld\n", "peak RSS", "", usage.ru_maxrss * 1024L);
+    }
+}
+
+/* Prints the quality of a hash table: bucket occupancy, load factor, a
+ * histogram of the chain lengths, the longest chain and the comparisons an
+ * average successful lookup needs given the current chains */
+void printHashTableDiagnostics(HashTable *table, const char *label) {
+    if (table == NULL || table->size == 0) {
+        return;
+    }
+
+    // Chains of HISTOGRAM_BUCKETS - 1 or more items share the last bucket
+    enum { HISTOGRAM_BUCKETS = 9 };
+    size_t histogram[HISTOGRAM_BUCKETS] = {0};
+    size_t usedBuckets = 0;
+    size_t longestChain = 0;
+    size_t items = 0;
+    double successfulComparisons = 0;   // Sum of the position of every item
+
+    for (size_t i = 0; i < table->size; i++) {
+        size_t length = 0;
+        for (HashItem *current = table->items[i]; current != NULL; current = current->next) {
+            length++;
+        }
+
+        histogram[length < HISTOGRAM_BUCKETS ? length : HISTOGRAM_BUCKETS - 1]++;
+        if (length > 0) {
+            usedBuckets++;
+        }
+        if (length > longestChain) {
+            longestChain = length;
+        }
+        items += length;
+        successfulComparisons += length * (length + 1) / 2.0;
+    }
+
+    fprintf(stderr, "\n--- Hash table (%s) ---\n", label);
+    fprintf(stderr, "Buckets: %zu, items: %zu, load factor: %.3f\n", table->size, items,
+            (double) items / table->size);
+    fprintf(stderr, "Used buckets: %zu (%.2f%%), longest chain: %zu\n", usedBuckets,
+            100.0 * usedBuckets / table->size, longestChain);
+    if (items > 0) {
+        fprintf(stderr, "Comparisons per lookup: %.3f (successful), %.3f (unsuccessful)\n",
+                successfulComparisons / items, (double) items / table->size);
+    }
+    fprintf(stderr, "Chain length histogram:\n");
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (histogram[i] == 0) {
+            continue;
+        }
+        fprintf(stderr, "  %s%d %12zu\n", i == HISTOGRAM_BUCKETS - 1 ? ">=" : "  ", i, histogram[i]);
+    }
+}
+
+/* Takes a mutex. When the thread profiles its locks (or is traced, or the
+ * lock_wait probe is attached), it first
+ * tries to take it without waiting and only if it is already taken it
+ * measures how long it waits for it, so uncontended acquisitions don't read
+ * the clock */
+void lockMutex(pthread_mutex_t *mutex, int lockId) {
+    LockStats *lockStats = threadLockStats;
+    if (lockStats == NULL && threadTraceRing == NULL && !MVP_PROBE_ENABLED(lock_wait)) {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+
+    if (lockStats != NULL) {
+        lockStats = &lockStats[lockId];
+        lockStats->acquisitions++;
+    }
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return;
+    }
+
+    double waitStart = nowSeconds();
+    pthread_mutex_lock(mutex);
+    double waitEnd = nowSeconds();
+    double waitSeconds = waitEnd - waitStart;
+
+    // Contended acquisitions show up in the trace as lock wait spans
+    traceEvent(lockId == TABLE_MUTEX_LOCK_ID ? "wait tableMutex" : "wait stripe", waitStart, waitEnd);
+    MVP_PROBE2(lock_wait, lockId, (long) (waitSeconds * 1e9));
+    if (lockStats == NULL) {
+        return;
+    }
+
+    lockStats->contended++;
+    lockStats->totalWaitSeconds += waitSeconds;
+    if (waitSeconds > lockStats->maxWaitSeconds) {
+        lockStats->maxWaitSeconds = waitSeconds;
+    }
+}
+
+/* Accumulates the statistics of a lock into a total */
+void addLockStats(LockStats *total, const LockStats *lockStats) {
+    total->acquisitions += lockStats->acquisitions;
+    total->contended += lockStats->contended;
+    total->totalWaitSeconds += lockStats->totalWaitSeconds;
+    if (lockStats->maxWaitSeconds > total->maxWaitSeconds) {
+        total->maxWaitSeconds = lockStats->maxWaitSeconds;
+    }
+}
+
+/* Starts the thread that prints the --progress line and gives every worker
+ * its counter. Returns 0 on success or -1 on error */
+int startProgressMonitor(ProgressMonitor *monitor, pthread_t *thread, ThreadData *threadData, int numberOfThreads) {
+    // calloc only aligns to 16 bytes, the counters must start a cache line
+    // each (the size of a counter is a multiple of 64, as aligned_alloc needs)
+    monitor->threads = aligned_alloc(64, numberOfThreads * sizeof(ProgressCounter));
+    if (monitor->threads == NULL) {
+        perror("Failed to allocate memory for progress counters.");
+        return -1;
+    }
+    memset(monitor->threads, 0, numberOfThreads * sizeof(ProgressCounter));
+    monitor->numberOfThreads = numberOfThreads;
+    monitor->totalBytes = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        monitor->totalBytes += threadData[i].assignedBytes;
+    }
+    monitor->startSeconds = nowSeconds();
+    monitor->finished = 0;
+    pthread_mutex_init(&monitor->mutex, NULL);
+    pthread_cond_init(&monitor->finishedCondition, NULL);
+
+    if (pthread_create(thread, NULL, reportProgress, monitor) != 0) {
+        fprintf(stderr, "Error creating the progress thread.\n");
+        pthread_mutex_destroy(&monitor->mutex);
+        pthread_cond_destroy(&monitor->finishedCondition);
+        free(monitor->threads);
+        return -1;
+    }
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        threadData[i].progress = &monitor->threads[i];
+    }
+    return 0;
+}
+
+/* Wakes up the progress thread so it prints the final line, waits for it
+ * and frees the counters */
+void stopProgressMonitor(ProgressMonitor *monitor, pthread_t thread) {
+    pthread_mutex_lock(&monitor->mutex);
+    monitor->finished = 1;
+    pthread_cond_signal(&monitor->finishedCondition);
+    pthread_mutex_unlock(&monitor->mutex);
+
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&monitor->mutex);
+    pthread_cond_destroy(&monitor->finishedCondition);
+    free(monitor->threads);
+}
+
+/* Thread function of --progress: every PROGRESS_INTERVAL_MS sums the counters
+ * of the workers and rewrites the progress line, until the scan finishes */
+void *reportProgress(void *arg) {
+    ProgressMonitor *monitor = arg;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    pthread_mutex_lock(&monitor->mutex);
+    while (!monitor->finished) {
+        deadline.tv_nsec += PROGRESS_INTERVAL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        if (pthread_cond_timedwait(&monitor->finishedCondition, &monitor->mutex, &deadline) == ETIMEDOUT) {
+            printProgressLine(monitor, "\r");
+        }
+    }
+    pthread_mutex_unlock(&monitor->mutex);
+
+    printProgressLine(monitor, "\n");
+    return NULL;
+}
+
+/* Prints the bytes scanned by all the workers, the rate since the start and
+ * the estimated time left, followed by end */
+void printProgressLine(ProgressMonitor *monitor, const char *end) {
+    long bytes = 0;
+    for (int i = 0; i < monitor->numberOfThreads; i++) {
+        bytes += __atomic_load_n(&monitor->threads[i].bytes, __ATOMIC_RELAXED);
+    }
+
+    double elapsedSeconds = nowSeconds() - monitor->startSeconds;
+    double rate = elapsedSeconds > 0 ? bytes / elapsedSeconds : 0;
+    double percentage = monitor->totalBytes > 0 ? 100.0 * bytes / monitor->totalBytes : 100;
+
+    fprintf(stderr, "Progress: %5.1f%% %10.1f / %.1f MB %9.2f MB/s ", percentage, bytes / 1e6,
+            monitor->totalBytes / 1e6, rate / 1e6);
+    if (rate > 0 && bytes < monitor->totalBytes) {
+        fprintf(stderr, "ETA %7.1f s%s", (monitor->totalBytes - bytes) / rate, end);
+    } else {
+        fprintf(stderr, "%-13s%s", bytes < monitor->totalBytes ? "ETA -" : "done", end);
+    }
+    fflush(stderr);
+}
+
+/* Starts the thread that sets expired once the given milliseconds from now
+ * are over. The wait is measured with the monotonic clock, so changes of the
+ * wall clock don't move the deadline. Returns 0 on success or -1 on error */
+int startDeadlineTimer(DeadlineTimer *timer, pthread_t *thread, long milliseconds) {
+    timer->milliseconds = milliseconds;
+    timer->expired = 0;
+    timer->finished = 0;
+    clock_gettime(CLOCK_MONOTONIC, &timer->deadline);
+    timer->deadline.tv_sec += milliseconds / 1000;
+    timer->deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+    timer->deadline.tv_sec += timer->deadline.tv_nsec / 1000000000L;
+    timer->deadline.tv_nsec %= 1000000000L;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_mutex_init(&timer->mutex, NULL);
+    pthread_cond_init(&timer->finishedCondition, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    if (pthread_create(thread, NULL, waitForDeadline, timer) != 0) {
+        fprintf(stderr, "Error creating the deadline thread.\n");
+        pthread_mutex_destroy(&timer->mutex);
+        pthread_cond_destroy(&timer->finishedCondition);
+        return -1;
+    }
+    return 0;
+}
+
+/* Wakes up the deadline thread if the time isn't over yet and waits for it */
+void stopDeadlineTimer(DeadlineTimer *timer, pthread_t thread) {
+    pthread_mutex_lock(&timer->mutex);
+    timer->finished = 1;
+    pthread_cond_signal(&timer->finishedCondition);
+    pthread_mutex_unlock(&timer->mutex);
+
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&timer->mutex);
+    pthread_cond_destroy(&timer->finishedCondition);
+}
+
+/* Thread function of --deadline: sleeps until the deadline or until the run
+ * finishes, whatever happens first, and in the first case tells the workers
+ * to stop */
+void *waitForDeadline(void *arg) {
+    DeadlineTimer *timer = arg;
+
+    pthread_mutex_lock(&timer->mutex);
+    while (!timer->finished) {
+        if (pthread_cond_timedwait(&timer->finishedCondition, &timer->mutex, &timer->deadline) == ETIMEDOUT) {
+            __atomic_store_n(&timer->expired, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timer->mutex);
+
+    return NULL;
+}
+
+/* Appends to a report written after the deadline a line saying that it is
+ * incomplete and the fraction of the bytes of its inputs it covers
+ * returns 0 on success or -1 on error */
+int appendIncompleteMarker(const char *reportFileName, long scannedBytes, long totalBytes) {
+    FILE *file = fopen(reportFileName, "a");
+    if (file == NULL) {
+        perror("Error opening the report");
+        return -1;
+    }
+
+    double fraction = totalBytes > 0 ? (double) scannedBytes / totalBytes : 0;
+    fprintf(file, "-----------------------------------\n");
+    fprintf(file, "INCOMPLETO: %.1f%% de los bytes procesados (%ld de %ld) en el plazo de %ld ms\n",
+            fraction * 100, scannedBytes, totalBytes, deadlineTimer.milliseconds);
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/* Adds the bytes scanned (or loaded) of a work unit to its group, only with
+ * --deadline */
+void addGroupScannedBytes(ThreadData *threadData, const WorkUnit *unit, long bytes) {
+    if (deadlineTimer.groupScannedBytes != NULL) {
+        __atomic_fetch_add(&deadlineTimer.groupScannedBytes[threadData->files[unit->fileIndex].group], bytes,
+                           __ATOMIC_RELAXED);
+    }
+}
+
+/* Frees the bytes of every group of the last run with --deadline */
+void releaseDeadlineGroups(void) {
+    free(deadlineTimer.groupScannedBytes);
+    free(deadlineTimer.groupTotalBytes);
+    deadlineTimer.groupScannedBytes = NULL;
+    deadlineTimer.groupTotalBytes = NULL;
+}
+
+/* Adds bytes (negative when freeing) to the usage of a subsystem and raises
+ * its peak, only with --stats */
+void addMemoryUsage(MemorySubsystem subsystem, long bytes) {
+    if (!statistics.enabled) {
+        return;
+    }
+
+    MemoryUsage *usage = &statistics.memory[subsystem];
+    long current = __atomic_add_fetch(&usage->currentBytes, bytes, __ATOMIC_RELAXED);
+    long peak = __atomic_load_n(&usage->peakBytes, __ATOMIC_RELAXED);
+    while (current > peak &&
+           !__atomic_compare_exchange_n(&usage->peakBytes, &peak, current, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/* Accounts a call to the allocator made by a subsystem, only with --stats */
+void addAllocation(MemorySubsystem subsystem) {
+    if (statistics.enabled) {
+        __atomic_fetch_add(&statistics.memory[subsystem].allocations, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Calls to the allocator made so far by all the subsystems */
+long countAllocations(void) {
+    long allocations = 0;
+    for (int i = 0; i < NUMBER_OF_MEMORY_SUBSYSTEMS; i++) {
+        allocations += __atomic_load_n(&statistics.memory[i].allocations, __ATOMIC_RELAXED);
+    }
+    return allocations;
+}
+
+/* Clears what --stats added up during a run of --repeat (the phase times and
+ * the allocations), so the figures of the next run aren't mixed with it. The
+ * memory in use is kept and its peak starts again from it. The statistics of
+ * the threads are allocated again by every scan */
+void resetRunStatistics(void) {
+    memset(statistics.phaseSeconds, 0, sizeof(statistics.phaseSeconds));
+    for (int i = 0; i < NUMBER_OF_MEMORY_SUBSYSTEMS; i++) {
+        MemoryUsage *usage = &statistics.memory[i];
+        __atomic_store_n(&usage->peakBytes, __atomic_load_n(&usage->currentBytes, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&usage->allocations, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/* malloc that accounts the bytes to a subsystem */
+void *trackedMalloc(MemorySubsystem subsystem, size_t size) {
+    void *pointer = malloc(size);
+    if (pointer != NULL) {
+        addMemoryUsage(subsystem, size);
+        addAllocation(subsystem);
+    }
+    return pointer;
+}
+
+/* calloc that accounts the bytes to a subsystem */
+void *trackedCalloc(MemorySubsystem subsystem, size_t count, size_t size) {
+    void *pointer = calloc(count, size);
+    if (pointer != NULL) {
+        addMemoryUsage(subsystem, count * size);
+        addAllocation(subsystem);
+    }
+    return pointer;
+}
+
+/* realloc that moves the accounted bytes of a subsystem from oldSize to
+ * newSize, on failure the old block is kept (and still accounted) */
+void *trackedRealloc(MemorySubsystem subsystem, void *pointer, size_t oldSize, size_t newSize) {
+    void *newPointer = realloc(pointer, newSize);
+    if (newPointer != NULL) {
+        addMemoryUsage(subsystem, (long) newSize - (long) oldSize);
+        addAllocation(subsystem);
+    }
+    return newPointer;
+}
+
+/* strdup that accounts the bytes to a subsystem */
+char *trackedStrdup(MemorySubsystem subsystem, const char *string) {
+    char *copy = strdup(string);
+    if (copy != NULL) {
+        addMemoryUsage(subsystem, strlen(copy) + 1);
+        addAllocation(subsystem);
+    }
+    return copy;
+}
+
+/* free of a block of size bytes allocated for a subsystem */
+void trackedFree(MemorySubsystem subsystem, void *pointer, size_t size) {
+    if (pointer == NULL) {
+        return;
+    }
+    addMemoryUsage(subsystem, -(long) size);
+    free(pointer);
+}
+
+/* free of a string allocated with trackedStrdup, its length is only measured
+ * when the usage is accounted */
+void trackedFreeString(MemorySubsystem subsystem, char *string) {
+    if (string != NULL && statistics.enabled) {
+        addMemoryUsage(subsystem, -(long) (strlen(string) + 1));
+    }
+    free(string);
+}
+
+/* Prints the contention of tableMutex and the stripe mutexes, in total, for
+ * the most contended stripe and per thread */
+void printLockStatistics(void) {
+    if (statistics.locks == NULL) {
+        return;
+    }
+
+    LockStats table = {0};
+    LockStats stripes = {0};
+    LockStats byStripe[NUMBER_OF_STRIPES] = {{0}};
+    for (int i = 0; i < statistics.numberOfThreads; i++) {
+        LockStats *threadLocks = &statistics.locks[(size_t) i * NUMBER_OF_PROFILED_LOCKS];
+        addLockStats(&table, &threadLocks[TABLE_MUTEX_LOCK_ID]);
+        for (int j = 0; j < NUMBER_OF_STRIPES; j++) {
+            addLockStats(&stripes, &threadLocks[STRIPE_LOCK_ID(j)]);
+            addLockStats(&byStripe[j], &threadLocks[STRIPE_LOCK_ID(j)]);
+        }
+    }
+
+    if (table.acquisitions == 0 && stripes.acquisitions == 0) {
+        return;
+    }
+
+    fprintf(stderr, "%-16s %12s %12s %10s %14s %12s\n", "Lock", "Acquisitions", "Contended", "%",
+            "Wait (ms)", "Max (us)");
+    const char *names[2] = {"tableMutex", "stripes (all)"};
+    LockStats *totals[2] = {&table, &stripes};
+    for (int i = 0; i < 2; i++) {
+        if (totals[i]->acquisitions == 0) {
+            continue;
+        }
+        fprintf(stderr, "%-16s %12ld %12ld %9.2f%% %14.3f %12.1f\n", names[i], totals[i]->acquisitions,
+                totals[i]->contended, 100.0 * totals[i]->contended / totals[i]->acquisitions,
+                totals[i]->totalWaitSeconds * 1e3, totals[i]->maxWaitSeconds * 1e6);
+    }
+
+    if (stripes.acquisitions > 0) {
+        int worst = 0;
+        for (int j = 1; j < NUMBER_OF_STRIPES; j++) {
+            if (byStripe[j].totalWaitSeconds > byStripe[worst].totalWaitSeconds) {
+                worst = j;
+            }
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "stripe %d (max)", worst);
+        fprintf(stderr, "%-16s %12ld %12ld %9.2f%% %14.3f %12.1f\n", name, byStripe[worst].acquisitions,
+                byStripe[worst].contended,
+                byStripe[worst].acquisitions > 0 ? 100.0 * byStripe[worst].contended / byStripe[worst].acquisitions : 0,
+                byStripe[worst].totalWaitSeconds * 1e3, byStripe[worst].maxWaitSeconds * 1e6);
+    }
+
+    // Share of every thread's scan spent waiting for locks
+    fprintf(stderr, "%-6s %12s %12s %14s %12s %10s\n", "Thread", "Acquisitions", "Contended", "Wait (ms)",
+            "Max (us)", "% of scan");
+    for (int i = 0; i < statistics.numberOfThreads; i++) {
+        LockStats total = {0};
+        LockStats *threadLocks = &statistics.locks[(size_t) i * NUMBER_OF_PROFILED_LOCKS];
+        for (int j = 0; j < NUMBER_OF_PROFILED_LOCKS; j++) {
+            addLockStats(&total, &threadLocks[j]);
+        }
+        double scanSeconds = statistics.threads != NULL ? statistics.threads[i].totalSeconds : 0;
+        fprintf(stderr, "%-6d %12ld %12ld %14.3f %12.1f %9.2f%%\n", i, total.acquisitions, total.contended,
+                total.totalWaitSeconds * 1e3, total.maxWaitSeconds * 1e6,
+                scanSeconds > 0 ? 100 * total.totalWaitSeconds / scanSeconds : 0);
+    }
+}
+
+/* Opens the hardware counters of the calling thread as a group, disabled
+ * until setPerfSessionEnabled. Events that can't be opened are skipped; if
+ * not even the first one can be opened (perf events not permitted or not
+ * supported) the reason is printed once. Returns 0 on success or -1 */
+int openPerfSession(PerfSession *session) {
+    session->leader = -1;
+    session->numOpened = 0;
+
+    for (int i = 0; i < NUMBER_OF_PERF_EVENTS; i++) {
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = perfEvents[i].type;
+        attributes.config = perfEvents[i].config;
+        attributes.disabled = session->leader == -1;    // The group follows its leader
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                 PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Count the calling thread on any CPU
+        int descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, session->leader, 0);
+        if (descriptor == -1) {
+            continue;
+        }
+
+        if (session->leader == -1) {
+            session->leader = descriptor;
+        }
+        session->descriptors[session->numOpened] = descriptor;
+        session->order[session->numOpened] = i;
+        session->numOpened++;
+    }
+
+    if (session->leader == -1) {
+        int error = errno;
+        if (!__atomic_exchange_n(&perfReport.failureReported, 1, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "Warning: hardware counters not available (%s), check "
+                            "/proc/sys/kernel/perf_event_paranoid. Continuing without --perf.\n",
+                    strerror(error));
+        }
+        return -1;
+    }
+
+    ioctl(session->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    return 0;
+}
+
+/* Enables or disables every counter of the group at once */
+void setPerfSessionEnabled(PerfSession *session, int enabled) {
+    ioctl(session->leader, enabled ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/* Reads the group of counters. If the kernel multiplexed them (more events
+ * than hardware counters) the values are scaled by enabled / running time */
+void readPerfSession(PerfSession *session, PerfCounters *counters) {
+    uint64_t buffer[3 + NUMBER_OF_PERF_EVENTS];
+    memset(counters, 0, sizeof(PerfCounters));
+
+    ssize_t bytesRead = read(session->leader, buffer, sizeof(buffer));
+    if (bytesRead < (ssize_t) (3 * sizeof(uint64_t))) {
+        return;
+    }
+
+    uint64_t numValues = buffer[0];
+    double scale = buffer[2] > 0 ? (double) buffer[1] / buffer[2] : 1;
+    for (uint64_t i = 0; i < numValues && i < (uint64_t) session->numOpened; i++) {
+        int event = session->order[i];
+        counters->values[event] = buffer[3 + i] * scale;
+        counters->supported[event] = 1;
+    }
+    counters->opened = 1;
+}
+
+/* Closes every counter of the group */
+void closePerfSession(PerfSession *session) {
+    for (int i = 0; i < session->numOpened; i++) {
+        close(session->descriptors[i]);
+    }
+    session->numOpened = 0;
+    session->leader = -1;
+}
+
+/* Prints the counters of every thread and in total, with the IPC and the
+ * misses per input line */
+void printPerfReport(void) {
+    if (perfReport.threads == NULL) {
+        return;
+    }
+
+    PerfCounters total = {0};
+    for (int i = 0; i < perfReport.numberOfThreads; i++) {
+        PerfCounters *counters = &perfReport.threads[i];
+        if (!counters->opened) {
+            continue;
+        }
+        total.opened = 1;
+        total.lines += counters->lines;
+        for (int j = 0; j < NUMBER_OF_PERF_EVENTS; j++) {
+            total.values[j] += counters->values[j];
+            total.supported[j] |= counters->supported[j];
+        }
+    }
+
+    if (!total.opened) {
+        return;
+    }
+
+    fprintf(stderr, "\n--- Hardware counters (aggregation phase) ---\n");
+    fprintf(stderr, "%-6s %10s %14s %14s %6s %12s %12s %12s\n", "Thread", "Lines", "Cycles", "Instructions",
+            "IPC", "Cache m/ln", "Branch m/ln", "dTLB m/ln");
+    for (int i = 0; i <= perfReport.numberOfThreads; i++) {
+        // The last row is the total
+        PerfCounters *counters = i < perfReport.numberOfThreads ? &perfReport.threads[i] : &total;
+        if (!counters->opened) {
+            continue;
+        }
+
+        char row[16];
+        snprintf(row, sizeof(row), i < perfReport.numberOfThreads ? "%d" : "total", i);
+        fprintf(stderr, "%-6s %10ld", row, counters->lines);
+
+        for (int j = PERF_CYCLES; j <= PERF_INSTRUCTIONS; j++) {
+            if (counters->supported[j]) {
+                fprintf(stderr, " %14llu", (unsigned long long) counters->values[j]);
+            } else {
+                fprintf(stderr, " %14s", "n/a");
+            }
+        }
+
+        if (counters->supported[PERF_CYCLES] && counters->supported[PERF_INSTRUCTIONS] &&
+            counters->values[PERF_CYCLES] > 0) {
+            fprintf(stderr, " %6.2f", (double) counters->values[PERF_INSTRUCTIONS] / counters->values[PERF_CYCLES]);
+        } else {
+            fprintf(stderr, " %6s", "n/a");
+        }
+
+        for (int j = PERF_CACHE_MISSES; j <= PERF_DTLB_MISSES; j++) {
+            if (counters->supported[j] && counters->lines > 0) {
+                fprintf(stderr, " %12.4f", (double) counters->values[j] / counters->lines);
+            } else {
+                fprintf(stderr, " %12s", "n/a");
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+/* Allocates the ring of trace events of a thread before the thread starts,
+ * so recording never allocates. Returns the ring or NULL if it can't be
+ * allocated (that thread is then not traced) */
+TraceRing *addTraceRing(const char *name) {
+    TraceRing **newRings = realloc(traceLog.rings, (traceLog.numRings + 1) * sizeof(TraceRing *));
+    if (newRings == NULL) {
+        perror("Failed to allocate memory for trace rings.");
+        return NULL;
+    }
+    traceLog.rings = newRings;
+
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (ring == NULL) {
+        perror("Failed to allocate memory for trace ring.");
+        return NULL;
+    }
+    ring->events = malloc(TRACE_RING_CAPACITY * sizeof(TraceEvent));
+    if (ring->events == NULL) {
+        perror("Failed to allocate memory for trace events.");
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = TRACE_RING_CAPACITY;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+
+    traceLog.rings[traceLog.numRings++] = ring;
+    return ring;
+}
+
+/* Records a span in the ring of the calling thread, it does nothing if the
+ * thread isn't traced */
+void traceEvent(const char *name, double startSeconds, double endSeconds) {
+    TraceRing *ring = threadTraceRing;
+    if (ring == NULL) {
+        return;
+    }
+
+    TraceEvent *event = &ring->events[ring->written % ring->capacity];
+    event->name = name;
+    event->startSeconds = startSeconds;
+    event->durationSeconds = endSeconds - startSeconds;
+    ring->written++;
+}
+
+/* Writes the events of every ring to the trace file in Trace Event JSON
+ * format (complete "X" events, one track per thread)
+ * returns 0 on success or -1 on error */
+int writeTraceFile(void) {
+    FILE *file = fopen(traceLog.fileName, "w");
+    if (file == NULL) {
+        perror("Error creating trace file");
+        return -1;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int first = 1;
+    for (int i = 0; i < traceLog.numRings; i++) {
+        TraceRing *ring = traceLog.rings[i];
+
+        // Name of the track of the thread
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                      "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", i, ring->name);
+        first = 0;
+
+        // Only the last capacity events survive in the ring
+        size_t firstEvent = ring->written > ring->capacity ? ring->written - ring->capacity : 0;
+        for (size_t j = firstEvent; j < ring->written; j++) {
+            TraceEvent *event = &ring->events[j % ring->capacity];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                          "\"ts\": %.3f, \"dur\": %.3f}", event->name, i,
+                    (event->startSeconds - traceLog.originSeconds) * 1e6, event->durationSeconds * 1e6);
+        }
+
+        if (firstEvent > 0) {
+            fprintf(stderr, "Warning: the trace of %s lost its %zu oldest events.\n", ring->name, firstEvent);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) == EOF) {
+        perror("Error writing trace file");
+        return -1;
+    }
+    return 0;
+}
+
+/* Frees every ring of the trace */
+void freeTraceLog(void) {
+    for (int i = 0; i < traceLog.numRings; i++) {
+        free(traceLog.rings[i]->events);
+        free(traceLog.rings[i]);
+    }
+    free(traceLog.rings);
+    traceLog.rings = NULL;
+    traceLog.numRings = 0;
+    threadTraceRing = NULL;
+}
+
+/* Hashes a record 8 bytes at a time (multiply and rotate mixing), it is
+ * much faster than a byte by byte hash for lines of tens of bytes */
+uint64_t hashRecord(const char *data, size_t length, uint64_t seed) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = seed ^ (length * prime);
+    size_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data + i, sizeof(chunk));
+        hash = (hash ^ chunk) * prime;
+        hash ^= hash >> 29;
+    }
+
+    // Remaining bytes (less than 8)
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    hash = (hash ^ tail) * prime;
+
+    // Final mix so every input bit affects the low bits used as index
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ULL;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/* Creates the deduplication filter for the input files, with room for twice
+ * their total number of lines. The inputs can't be larger than 1 TiB in
+ * total (the offsets stored in the slots have 40 bits). Returns the filter
+ * or NULL on error */
+DedupFilter *createDedupFilter(InputList *inputList) {
+    DedupFilter *filter = calloc(1, sizeof(DedupFilter));
+    if (filter == NULL) {
+        perror("Failed to allocate memory for dedup filter.");
+        return NULL;
+    }
+
+    size_t totalLines = 0;
+    uint64_t totalSize = 0;
+    for (size_t i = 0; i < inputList->count; i++) {
+        totalLines += inputList->files[i].lineCount;
+        totalSize += inputList->files[i].size;
+    }
+    if (totalSize >= DEDUP_LOCATION_MASK) {
+        fprintf(stderr, "Error: --dedup supports up to 1 TiB of input files\n");
+        free(filter);
+        return NULL;
+    }
+
+    // Power of two size to index with a mask, at most half full
+    size_t size = 16;
+    while (size < totalLines * 2) {
+        size *= 2;
+    }
+    filter->mask = size - 1;
+    filter->slots = calloc(size, sizeof(uint64_t));
+
+    filter->numFiles = inputList->count;
+    filter->descriptors = malloc(inputList->count * sizeof(int));
+    filter->fileStarts = malloc(inputList->count * sizeof(uint64_t));
+    int *groups = malloc(inputList->count * sizeof(int));
+    filter->groups = groups;
+    if (filter->slots == NULL || filter->descriptors == NULL || filter->fileStarts == NULL || groups == NULL) {
+        perror("Failed to allocate memory for dedup filter.");
+        filter->numFiles = 0;
+        freeDedupFilter(filter);
+        return NULL;
+    }
+
+    uint64_t fileStart = 0;
+    for (size_t i = 0; i < inputList->count; i++) {
+        groups[i] = inputList->files[i].group;
+        filter->fileStarts[i] = fileStart;
+        fileStart += inputList->files[i].size;
+        filter->descriptors[i] = open(inputList->files[i].path, O_RDONLY);
+        if (filter->descriptors[i] == -1) {
+            perror("Error opening file");
+            filter->numFiles = i;
+            freeDedupFilter(filter);
+            return NULL;
+        }
+    }
+
+    return filter;
+}
+
+/* Reads the record stored at a location and compares it with a line of a
+ * file, recordLength is the length of the whole line and length the part of
+ * it in line. Lines longer than the buffer of the readers are compared
+ * reading both records from their files. Returns 1 if they are the same record */
+int isSameRecord(DedupFilter *filter, uint64_t location, int fileIndex, long offset, const char *line,
+                 size_t length, size_t recordLength) {
+    // Find the file of the stored record (the last one starting before it)
+    location = (location & DEDUP_LOCATION_MASK) - 1;
+    size_t low = 0;
+    size_t high = filter->numFiles - 1;
+    while (low < high) {
+        size_t middle = (low + high + 1) / 2;
+        if (filter->fileStarts[middle] <= location) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    int storedFile = filter->descriptors[low];
+    off_t storedOffset = location - filter->fileStarts[low];
+
+    // Read one extra byte to check that the stored record ends there too
+    char buffer[4097];
+    if (length == recordLength) {
+        ssize_t bytesRead = pread(storedFile, buffer, length + 1, storedOffset);
+        if (bytesRead < (ssize_t) length || memcmp(buffer, line, length) != 0) {
+            return 0;
+        }
+        return bytesRead == (ssize_t) length || buffer[length] == '\n' || buffer[length] == '\r';
+    }
+
+    char other[4096];
+    size_t compared = 0;
+    while (compared < recordLength) {
+        size_t chunk = recordLength - compared < sizeof(other) ? recordLength - compared : sizeof(other);
+        ssize_t bytesRead = pread(storedFile, buffer, chunk + 1, storedOffset + compared);
+        if (bytesRead < (ssize_t) chunk ||
+            pread(filter->descriptors[fileIndex], other, chunk, offset + compared) != (ssize_t) chunk ||
+            memcmp(buffer, other, chunk) != 0) {
+            return 0;
+        }
+        compared += chunk;
+        if (compared == recordLength) {
+            return bytesRead == (ssize_t) chunk || buffer[chunk] == '\n' || buffer[chunk] == '\r';
+        }
+    }
+
+    return 0;
+}
+
+/* Checks if a line was already seen in the same group, and records it if it
+ * wasn't. The set is lock-free: a new record is claimed with a
+ * compare-and-swap of its slot and a repeated fingerprint is verified against
+ * the original line, so only exact copies are reported as duplicates. A line
+ * longer than the buffer of the readers is hashed by its first bytes and its
+ * whole length (recordLength), and compared in full.
+ * Returns 1 if the line is a duplicate */
+int isDuplicateRecord(DedupFilter *filter, int fileIndex, long offset, const char *line, size_t length,
+                      size_t recordLength) {
+    uint64_t seed = (filter->groups[fileIndex] + 1) * 0x100000001B3ULL + recordLength;
+    uint64_t fingerprint = hashRecord(line, length, seed);
+    uint64_t tag = fingerprint & ~DEDUP_LOCATION_MASK;
+    uint64_t record = tag | (filter->fileStarts[fileIndex] + (uint64_t) offset + 1);
+
+    size_t index = fingerprint & filter->mask;
+    for (size_t probes = 0; probes <= filter->mask; probes++) {
+        uint64_t *slot = &filter->slots[index];
+        uint64_t current = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+        if (current == 0) {
+            if (__atomic_compare_exchange_n(slot, &current, record, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return 0;
+            }
+            // Another thread claimed the slot first, current has its record
+        }
+
+        if ((current & ~DEDUP_LOCATION_MASK) == tag &&
+            isSameRecord(filter, current, fileIndex, offset, line, length, recordLength)) {
+            __atomic_fetch_add(&filter->duplicates, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+
+        index = (index + 1) & filter->mask;
+    }
+
+    // The set is full (can't happen with twice the lines), count the line
+    return 0;
+}
+
+/* Closes the descriptors and frees the deduplication filter */
+void freeDedupFilter(DedupFilter *filter) {
+    if (filter == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < filter->numFiles; i++) {
+        close(filter->descriptors[i]);
+    }
+    free(filter->descriptors);
+    free((int *) filter->groups);
+    free(filter->fileStarts);
+    free(filter->slots);
+    free(filter);
+}
+
+/* Finds the column-th field of a line (column -1 means the last one) and
+ * stores its length without the line break. Returns a pointer to the field
+ * inside the line or NULL if the line has fewer columns */
+static inline __attribute__((always_inline))
+const char *findField(const char *line, int column, char delimiter, size_t *length) {
+    const char *start = line;
+
+    if (column < 0) {
+        // Last column: everything after the last delimiter
+        const char *lastDelimiter = strrchr(line, delimiter);
+        if (lastDelimiter != NULL) {
+            start = lastDelimiter + 1;
+        }
+        *length = strcspn(start, "\r\n");
+        return start;
+    }
+
+    // Skip the previous columns
+    for (int i = 0; i < column; i++) {
+        start = strchr(start, delimiter);
+        if (start == NULL) {
+            return NULL;
+        }
+        start++;
+    }
+
+    const char *end = start;
+    while (*end != '\0' && *end != delimiter && *end != '\n' && *end != '\r') {
+        end++;
+    }
+    *length = end - start;
+
+    return start;
+}
+
+/* Opens a file to read the lines that start in [startOffset, endOffset).
+ * If the range starts in the middle of a line, that line belongs to the
+ * previous range so it is skipped. Returns 0 on success or -1 on error */
+int openLineReader(LineReader *reader, const char *fileName, long startOffset, long endOffset) {
+    reader->file = fopen(fileName, "r");
+    if (reader->file == NULL) {
+        perror("Error opening file");
+        return -1;
+    }
+
+    reader->position = startOffset;
+    reader->endOffset = endOffset;
+    reader->lineOffset = startOffset;
+    reader->linesRead = 0;
+    reader->fullLength = 0;
+    reader->fileIndex = 0;
+    reader->dedup = NULL;
+
+    if (startOffset > 0) {
+        // Look at the byte before the range to know if it starts a line
+        if (fseek(reader->file, startOffset - 1, SEEK_SET) == -1) {
+            perror("Error seeking in file");
+            fclose(reader->file);
+            return -1;
+        }
+
+        int c = fgetc(reader->file);
+        while (c != '\n' && c != EOF) {
+            c = fgetc(reader->file);
+            reader->position++;
+        }
+    }
+
+    return 0;
+}
+
+/* Reads the next line of the range into the buffer of the reader, returns
+ * the buffer or NULL when the range (or the file) is exhausted */
+static inline char *readLine(LineReader *reader) {
+    if (reader->position >= reader->endOffset ||
+        fgets(reader->buffer, sizeof(reader->buffer), reader->file) == NULL) {
+        return NULL;
+    }
+
+    size_t length = strlen(reader->buffer);
+    reader->lineOffset = reader->position;
+    reader->position += length;
+    reader->linesRead++;
+    reader->fullLength = 0;
+
+    // Lines longer than the buffer are truncated, the rest is discarded so it
+    // isn't read as another line (but its length is kept for --dedup)
+    if (length > 0 && reader->buffer[length - 1] != '\n') {
+        int last = reader->buffer[length - 1];
+        int c = fgetc(reader->file);
+        while (c != '\n' && c != EOF) {
+            last = c;
+            c = fgetc(reader->file);
+            reader->position++;
+        }
+        reader->fullLength = reader->position - reader->lineOffset - (last == '\r');
+        if (c == '\n') {
+            reader->position++;
+        }
+    }
+
+    return reader->buffer;
+}
+
+/* Extract the keys (values of a column) of up to maxKeys lines of the reader,
+ * skipping the lines rejected by the filter of the query. The keys are copied
+ * one after another to keyBuffer, the batch ends early when a key of a whole
+ * line might not fit in the rest of it.
+ * It is always inlined, so every parser variant gets its own copy of the loop
+ * with the column, filter column and delimiter as constants.
+ * Returns how many keys were stored in keys, finished is set to 1 once the
+ * range is exhausted */
+static inline __attribute__((always_inline))
+size_t extractKeysFromReader(LineReader *reader, const ParserQuery *query, char **keys, char *keyBuffer,
+                             size_t maxKeys, int *finished, int column, int filterColumn, char delimiter) {
+    size_t extracted = 0;
+    size_t used = 0;
+
+    while (extracted < maxKeys && used + sizeof(reader->buffer) <= KEY_BUFFER_SIZE) {
+        char *line = readLine(reader);
+        if (line == NULL) {
+            *finished = 1;
+            break;
+        }
+
+        // Skip the lines whose filter column doesn't start with the prefix
+        if (filterColumn >= 0) {
+            size_t filterLength;
+            const char *filterField = findField(line, filterColumn, delimiter, &filterLength);
+            if (filterField == NULL || filterLength < query->filterPrefixLength ||
+                strncmp(filterField, query->filterPrefix, query->filterPrefixLength) != 0) {
+                continue;
+            }
+        }
+
+        // Skip the lines that are copies of a line already counted
+        if (reader->dedup != NULL) {
+            size_t lineLength = strcspn(line, "\r\n");
+            size_t recordLength = reader->fullLength > 0 ? (size_t) reader->fullLength : lineLength;
+            if (isDuplicateRecord(reader->dedup, reader->fileIndex, reader->lineOffset,
+                                  line, lineLength, recordLength)) {
+                continue;
+            }
+        }
+
+        // Picks only the field without the delimiter before it nor the
+        // trailing line break
+        size_t length;
+        const char *field = findField(line, column, delimiter, &length);
+        if (field == NULL) {
+            continue;
+        }
+        keys[extracted] = keyBuffer + used;
+        memcpy(keys[extracted], field, length);
+        keys[extracted][length] = '\0';
+        used += length + 1;
+        extracted++;
+    }
+
+    return extracted;
+}
+
+// Define one extraction function per specialized variant with its constants
+#define DEFINE_PARSER_VARIANT(name, column, filterColumn, delimiter) \
+    size_t extractKeys##name(LineReader *reader, const ParserQuery *query, \
+                             char **keys, char *keyBuffer, size_t maxKeys, int *finished) { \
+        return extractKeysFromReader(reader, query, keys, keyBuffer, maxKeys, finished, \
+                                     column, filterColumn, delimiter); \
+    }
+PARSER_VARIANTS(DEFINE_PARSER_VARIANT)
+#undef DEFINE_PARSER_VARIANT
+
+/* Extraction function used when no specialized variant matches the query, the
+ * column, filter column and delimiter are read from the query for every line */
+size_t extractKeysGeneric(LineReader *reader, const ParserQuery *query,
+                          char **keys, char *keyBuffer, size_t maxKeys, int *finished) {
+    return extractKeysFromReader(reader, query, keys, keyBuffer, maxKeys, finished,
+                                 query->column, query->filterColumn, query->delimiter);
+}
+
+/* Picks the specialized variant whose constants match the query, or the
+ * generic one if there is none */
+const ParserVariant *selectParserVariant(const ParserQuery *query) {
+    for (size_t i = 0; i < NUMBER_OF_PARSER_VARIANTS; i++) {
+        if (parserVariants[i].column == query->column &&
+            parserVariants[i].filterColumn == query->filterColumn &&
+            parserVariants[i].delimiter == query->delimiter) {
+            return &parserVariants[i];
+        }
+    }
+    return &genericParserVariant;
+}
+
+/* Counts the total lines in a file, return line count or -1 on error */
+int getLineCountFromFile(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        return -1;
+    }
+
+    char buffer[1024];
+    int lineCount = 0;
+
+    // Count lines until EOF
+    while (fgets(buffer, sizeof(buffer), file)) {
+        lineCount++;
+    }
+
+    fclose(file);
+
+    return lineCount;
+}
+
+/** Thread function to count player occurrences in its chunks of the files */
+void *countPlayerOccurrences(void *arg) {
+    // Cast void* arg to ThreadData*, required because pthread_create passes
+    // arguments as void*
+    ThreadData *threadData = (ThreadData *) arg;
+
+    // Player names are extracted and counted in batches, in the key buffers
+    // reserved for the thread
+    char **playerNames = threadData->keys;
+
+    // Timings are only taken with --stats, the rest of the time the thread
+    // doesn't read the clock at all
+    // With --trace the thread records its spans in its own ring
+    threadTraceRing = threadData->traceRing;
+
+    int timed = (statistics.enabled && statistics.threads != NULL) || threadTraceRing != NULL;
+    ThreadStats threadStats = {0};
+    double threadStart = timed ? nowSeconds() : 0;
+
+    // Lookups and locks of this thread are profiled only with --stats
+    if (statistics.enabled) {
+        threadLookupStats = &threadStats.lookupStats;
+    }
+    if (statistics.enabled && statistics.locks != NULL) {
+        threadLockStats = &statistics.locks[(size_t) threadData->tid * NUMBER_OF_PROFILED_LOCKS];
+    }
+
+    // Hardware counters of this thread, only enabled while aggregating
+    PerfSession perfSession;
+    int counted = perfReport.enabled && perfReport.threads != NULL && openPerfSession(&perfSession) == 0;
+    long linesRead = 0;
+
+    // With --memo-dir the keys of a scanned block are also counted in a
+    // table of their own, saved as the memoized aggregate of the block
+    HashTable *partial = NULL;
+    if (threadData->memoDirName != NULL) {
+        partial = createHashTable(4096);
+        if (partial == NULL) {
+            threadData->failed = 1;
+        }
+    }
+    char memoFileName[4096];
+
+    LineReader reader;
+    for (size_t i = 0; i < threadData->numUnits && !threadData->failed &&
+                       !__atomic_load_n(&deadlineTimer.expired, __ATOMIC_RELAXED); i++) {
+        WorkUnit *unit = &threadData->units[i];
+        void *state = threadData->states[threadData->files[unit->fileIndex].group];
+        double unitStart = timed ? nowSeconds() : 0;
+        MVP_PROBE4(chunk_start, threadData->tid, unit->fileIndex, unit->startOffset, unit->endOffset);
+
+        // A memoized block with the same content is loaded instead of scanned
+        if (partial != NULL) {
+            long lines = 0;
+            if (counted) {
+                setPerfSessionEnabled(&perfSession, 1);
+            }
+            int loaded = loadMemoizedUnit(threadData, unit, state, memoFileName, sizeof(memoFileName), &lines);
+            if (counted) {
+                setPerfSessionEnabled(&perfSession, 0);
+            }
+            if (loaded == -1) {
+                threadData->failed = 1;
+                break;
+            }
+            if (loaded == 1) {
+                long bytes = unit->endOffset - unit->startOffset;
+                linesRead += lines;
+                threadStats.units++;
+                threadStats.lines += lines;
+                threadStats.bytes += bytes;
+                threadStats.memoLoaded++;
+                addGroupScannedBytes(threadData, unit, bytes);
+                if (timed) {
+                    double unitEnd = nowSeconds();
+                    threadStats.aggregateSeconds += unitEnd - unitStart;
+                    traceEvent("chunk", unitStart, unitEnd);
+                }
+                if (threadData->progress != NULL) {
+                    __atomic_store_n(&threadData->progress->bytes, threadStats.bytes, __ATOMIC_RELAXED);
+                }
+                MVP_PROBE4(chunk_end, threadData->tid, unit->fileIndex, lines, bytes);
+                continue;
+            }
+            resetHashTable(partial);
+        }
+
+        if (openLineReader(&reader, threadData->files[unit->fileIndex].path,
+                           unit->startOffset, unit->endOffset) == -1) {
+            fprintf(stderr, "Thread %d: Failed to read file content\n", threadData->tid);
+            threadData->failed = 1;
+            break;
+        }
+        reader.fileIndex = unit->fileIndex;
+        reader.dedup = threadData->dedup;
+
+        // The deadline is checked between batches, so a thread never goes on
+        // for more than a batch after it
+        int finished = 0;
+        while (!finished && !__atomic_load_n(&deadlineTimer.expired, __ATOMIC_RELAXED)) {
+            double batchStart = timed ? nowSeconds() : 0;
+
+            // Extract player names from the chunk with the parser variant
+            // selected for the query
+            size_t numKeys = threadData->parser->extractKeys(&reader, threadData->query, playerNames,
+                                                             threadData->keyBuffer, KEY_BATCH_SIZE, &finished);
+
+            double extractEnd = timed ? nowSeconds() : 0;
+
+            // Count the player names of the batch with the selected strategy,
+            // it takes care of any synchronization with the other threads
+            if (counted) {
+                setPerfSessionEnabled(&perfSession, 1);
+            }
+            threadData->strategy->addBatch(state, threadData->tid, playerNames, NULL, numKeys);
+            if (counted) {
+                setPerfSessionEnabled(&perfSession, 0);
+            }
+            for (size_t j = 0; partial != NULL && j < numKeys; j++) {
+                if (addToHashItem(partial, playerNames[j], 1) == -1) {
+                    threadData->failed = 1;
+                }
+            }
+
+            // Publish the bytes scanned so far, a plain store the progress
+            // thread reads whenever it wakes up
+            if (threadData->progress != NULL) {
+                __atomic_store_n(&threadData->progress->bytes,
+                                 threadStats.bytes + (long) (reader.position - unit->startOffset), __ATOMIC_RELAXED);
+            }
+
+            if (timed) {
+                double aggregateEnd = nowSeconds();
+                threadStats.extractSeconds += extractEnd - batchStart;
+                threadStats.aggregateSeconds += aggregateEnd - extractEnd;
+                threadStats.keys += numKeys;
+                traceEvent("extract", batchStart, extractEnd);
+                traceEvent("aggregate", extractEnd, aggregateEnd);
+            }
+        }
+
+        linesRead += reader.linesRead;
+        threadStats.units++;
+        threadStats.lines += reader.linesRead;
+        threadStats.bytes += reader.position - unit->startOffset;
+        addGroupScannedBytes(threadData, unit, reader.position - unit->startOffset);
+
+        fclose(reader.file);
+        MVP_PROBE4(chunk_end, threadData->tid, unit->fileIndex, reader.linesRead,
+                   reader.position - unit->startOffset);
+        if (threadTraceRing != NULL) {
+            traceEvent("chunk", unitStart, nowSeconds());
+        }
+
+        // A block cut by the deadline isn't complete, it isn't saved
+        if (partial != NULL && finished && !threadData->failed) {
+            threadStats.memoScanned++;
+            saveMemoizedUnit(threadData, unit, partial, memoFileName, reader.linesRead);
+        }
+    }
+    if (partial != NULL) {
+        freeHashTable(partial);
+    }
+
+    threadData->scannedBytes = threadStats.bytes;
+
+    if (statistics.enabled && statistics.threads != NULL) {
+        threadStats.totalSeconds = nowSeconds() - threadStart;
+        statistics.threads[threadData->tid] = threadStats;
+    }
+
+    // The lookup counters live in threadStats, on the stack of this thread
+    threadLookupStats = NULL;
+    threadLockStats = NULL;
+
+    if (counted) {
+        PerfCounters *counters = &perfReport.threads[threadData->tid];
+        readPerfSession(&perfSession, counters);
+        counters->lines = linesRead;
+        closePerfSession(&perfSession);
+    }
+
+    threadTraceRing = NULL;
+
+    // Terminates thread and return a void pointer as required by pthread API
+    pthread_exit(NULL);
+}
+
+/* Comparison function for qsort to sort players in descending order by mvp count
+ * Return negative if b < a, positive if b > a or 0 for equal */
+int compareByMVPCounts(const void *a, const void *b) {
+    // Cast the generic void pointers to SortableItem pointers
+    // This is necessary because qsort() uses void pointers
+    SortableItem *itemA = (SortableItem *) a;
+    SortableItem *itemB = (SortableItem *) b;
+
+    // Subtract a from b to sort in descending order
+    return itemB->value - itemA->value;
+}
+
+/* Parses the options of the generate command (argv[0] is "generate")
+ * returns 0 on success or -1 if the arguments are incorrect */
+int parseGeneratorOptions(int argc, char *argv[], GeneratorOptions *options) {
+    options->fileName = NULL;
+    options->targetLines = 0;
+    options->targetBytes = 0;
+    options->numberOfPlayers = 1000;
+    options->skew = 1.0;
+    options->utf8Fraction = 0.1;
+    options->minLineLength = 0;
+    options->maxLineLength = 0;
+    options->seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--lines=", 8) == 0) {
+            options->targetLines = atoll(argv[i] + 8);
+            if (options->targetLines <= 0) {
+                fprintf(stderr, "Error: the number of lines must be greater than 0.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--size=", 7) == 0) {
+            options->targetBytes = parseByteSize(argv[i] + 7);
+            if (options->targetBytes <= 0) {
+                fprintf(stderr, "Error: the size must be a number of bytes (K, M or G suffix allowed).\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--players=", 10) == 0) {
+            long players = atol(argv[i] + 10);
+            if (players <= 0) {
+                fprintf(stderr, "Error: the number of players must be greater than 0.\n");
+                return -1;
+            }
+            options->numberOfPlayers = players;
+        } else if (strncmp(argv[i], "--skew=", 7) == 0) {
+            options->skew = atof(argv[i] + 7);
+            if (options->skew < 0) {
+                fprintf(stderr, "Error: the skew can't be negative.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--utf8=", 7) == 0) {
+            options->utf8Fraction = atof(argv[i] + 7);
+            if (options->utf8Fraction < 0 || options->utf8Fraction > 1) {
+                fprintf(stderr, "Error: the UTF-8 fraction must be between 0 and 1.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--line-length=", 14) == 0) {
+            if (sscanf(argv[i] + 14, "%d:%d", &options->minLineLength, &options->maxLineLength) != 2 ||
+                options->minLineLength < 0 || options->maxLineLength < options->minLineLength ||
+                options->maxLineLength > 1000) {
+                fprintf(stderr, "Error: the line length must be <min>:<max> (up to 1000).\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            char *end;
+            errno = 0;
+            options->seed = strtoull(argv[i] + 7, &end, 10);
+            if (end == argv[i] + 7 || *end != '\0' || errno == ERANGE || !isdigit((unsigned char) argv[i][7])) {
+                fprintf(stderr, "Error: the seed must be a number between 0 and %llu.\n",
+                        (unsigned long long) UINT64_MAX);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Error: unknown option '%s'.\n", argv[i]);
+            return -1;
+        } else if (options->fileName == NULL) {
+            options->fileName = argv[i];
+        } else {
+            return -1;
+        }
+    }
+
+    if (options->fileName == NULL) {
+        return -1;
+    }
+    if (options->targetLines == 0 && options->targetBytes == 0) {
+        options->targetLines = 1000000;
+    }
+
+    return 0;
+}
+
+/* Parses a size in bytes with an optional K, M or G suffix (powers of 1024)
+ * returns the number of bytes or -1 if it is malformed */
+long long parseByteSize(const char *argument) {
+    char *end;
+    long long size = strtoll(argument, &end, 10);
+    if (end == argument || size < 0) {
+        return -1;
+    }
+
+    switch (*end) {
+        case '\0':
+            return size;
+        case 'K':
+        case 'k':
+            size <<= 10;
+            break;
+        case 'M':
+        case 'm':
+            size <<= 20;
+            break;
+        case 'G':
+        case 'g':
+            size <<= 30;
+            break;
+        default:
+            return -1;
+    }
+
+    return end[1] == '\0' ? size : -1;
+}
+
+/* Advances a SplitMix64 state and returns the next value, used to expand the
+ * seed into the state of the generator */
+uint64_t splitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Advances a xorshift64* state (never 0) and returns the next value */
+uint64_t xorShift64Star(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Returns a uniform double in [0, 1) from the 53 high bits of the generator */
+double nextRandomDouble(uint64_t *state) {
+    return (xorShift64Star(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Writes the name of the player with the given index in buffer (at least
+ * 64 bytes) and returns its length. The first name comes from the two low
+ * syllable digits of the index and the surname from the rest, so every index
+ * gives a different name. Accented names replace the first vowel of the
+ * surname with a two-byte UTF-8 character */
+size_t buildPlayerName(size_t index, int accented, char *buffer) {
+    const size_t base = sizeof(generatorSyllables) / sizeof(generatorSyllables[0]);
+    size_t length = 0;
+
+    // First name, two syllables
+    for (int i = 0; i < 2; i++) {
+        memcpy(buffer + length, generatorSyllables[index % base], 2);
+        length += 2;
+        index /= base;
+    }
+    buffer[0] -= 'a' - 'A';
+    buffer[length++] = ' ';
+
+    // Surname, at least two syllables
+    size_t surname = length;
+    for (int i = 0; i < 2 || index > 0; i++) {
+        memcpy(buffer + length, generatorSyllables[index % base], 2);
+        length += 2;
+        index /= base;
+    }
+
+    if (accented) {
+        // Every syllable ends with its vowel, the first one is at surname + 1
+        const char *vowels = "aeiou";
+        const char *replacements[] = {"á", "é", "í", "ö", "ü"};
+        const char *replacement = replacements[strchr(vowels, buffer[surname + 1]) - vowels];
+        memmove(buffer + surname + 3, buffer + surname + 2, length - surname - 2);
+        memcpy(buffer + surname + 1, replacement, 2);
+        length++;
+    }
+    buffer[surname] -= 'a' - 'A';
+    buffer[length] = '\0';
+
+    return length;
+}
+
+/* Builds the cumulative distribution of a Zipf law over the players: the
+ * player of rank k gets awards proportional to 1 / k^skew.
+ * Returns the table (numberOfPlayers entries) or NULL if it fails */
+double *buildZipfTable(size_t numberOfPlayers, double skew) {
+    double *cumulative = malloc(numberOfPlayers * sizeof(double));
+    if (cumulative == NULL) {
+        perror("Failed to allocate memory for the Zipf table.");
+        return NULL;
+    }
+
+    double sum = 0;
+    for (size_t i = 0; i < numberOfPlayers; i++) {
+        sum += pow((double) (i + 1), -skew);
+        cumulative[i] = sum;
+    }
+    for (size_t i = 0; i < numberOfPlayers; i++) {
+        cumulative[i] /= sum;
+    }
+
+    return cumulative;
+}
+
+/* Returns the first player whose cumulative probability reaches uniform
+ * (binary search over the Zipf table) */
+size_t sampleZipf(const double *cumulative, size_t numberOfPlayers, double uniform) {
+    size_t low = 0;
+    size_t high = numberOfPlayers - 1;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (cumulative[middle] < uniform) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/* Writes the synthetic matches to the output file through a large buffer,
+ * until the target lines or bytes are reached.
+ * Returns 0 on success or -1 on error */
+int generateInputFile(const GeneratorOptions *options) {
+    const size_t numberOfStages = sizeof(generatorStages) / sizeof(generatorStages[0]);
+    const size_t numberOfClubs = sizeof(generatorClubs) / sizeof(generatorClubs[0]);
+    const size_t bufferSize = 1 << 20;
+    const char *filler = "abcdefghijklmnopqrstuvwxyz";
+
+    uint64_t seedState = options->seed;
+    uint64_t state = splitMix64(&seedState);
+    if (state == 0) {
+        state = 1;
+    }
+
+    // Names of every player, whether they are accented is part of the seed
+    char (*names)[64] = malloc(options->numberOfPlayers * sizeof(*names));
+    unsigned char *nameLengths = malloc(options->numberOfPlayers);
+    double *cumulative = buildZipfTable(options->numberOfPlayers, options->skew);
+    char *buffer = malloc(bufferSize);
+    FILE *file = fopen(options->fileName, "w");
+    if (names == NULL || nameLengths == NULL || cumulative == NULL || buffer == NULL || file == NULL) {
+        perror("Error preparing the generator");
+        free(names);
+        free(nameLengths);
+        free(cumulative);
+        free(buffer);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+    for (size_t i = 0; i < options->numberOfPlayers; i++) {
+        nameLengths[i] = buildPlayerName(i, nextRandomDouble(&state) < options->utf8Fraction, names[i]);
+    }
+
+    long long lines = 0;
+    long long bytes = 0;
+    size_t used = 0;
+    int status = 0;
+    while (options->targetLines > 0 ? lines < options->targetLines : bytes < options->targetBytes) {
+        // Flush before the buffer can't hold the longest possible line
+        if (used + 2048 > bufferSize) {
+            if (fwrite(buffer, 1, used, file) != used) {
+                perror("Error writing the generated file");
+                status = -1;
+                break;
+            }
+            used = 0;
+        }
+
+        size_t home = xorShift64Star(&state) % numberOfClubs;
+        size_t away = (home + 1 + xorShift64Star(&state) % (numberOfClubs - 1)) % numberOfClubs;
+        size_t player = sampleZipf(cumulative, options->numberOfPlayers, nextRandomDouble(&state));
+        int homeGoals = xorShift64Star(&state) % 6;
+        int awayGoals = xorShift64Star(&state) % 6;
+        int lineLength = options->minLineLength;
+        if (options->maxLineLength > options->minLineLength) {
+            lineLength += xorShift64Star(&state) % (options->maxLineLength - options->minLineLength + 1);
+        }
+
+        size_t start = used;
+        const char *stage = generatorStages[xorShift64Star(&state) % numberOfStages];
+        size_t stageLength = strlen(stage);
+        size_t homeLength = strlen(generatorClubs[home]);
+        size_t awayLength = strlen(generatorClubs[away]);
+        memcpy(buffer + used, stage, stageLength);
+        used += stageLength;
+        buffer[used++] = ',';
+        memcpy(buffer + used, generatorClubs[home], homeLength);
+        used += homeLength;
+        buffer[used++] = ',';
+        memcpy(buffer + used, generatorClubs[away], awayLength);
+        used += awayLength;
+
+        buffer[used++] = ',';
+        buffer[used++] = '0' + homeGoals;
+        buffer[used++] = '-';
+        buffer[used++] = '0' + awayGoals;
+        buffer[used++] = ',';
+
+        // With --line-length every line has a filler field before the MVP
+        // (empty if the line is already long enough), so the clubs and the
+        // score are never touched and all the lines have the same fields
+        if (options->maxLineLength > 0) {
+            size_t restLength = 1 + nameLengths[player];    // "," and the name
+            for (size_t i = 0; used - start + restLength < (size_t) lineLength; i++) {
+                buffer[used++] = filler[i % 26];
+            }
+            buffer[used++] = ',';
+        }
+        memcpy(buffer + used, names[player], nameLengths[player]);
+        used += nameLengths[player];
+        buffer[used++] = '\n';
+
+        bytes += used - start;
+        lines++;
+    }
+
+    if (status == 0 && fwrite(buffer, 1, used, file) != used) {
+        perror("Error writing the generated file");
+        status = -1;
+    }
+    if (fclose(file) == EOF) {
+        perror("Error writing the generated file");
+        status = -1;
+    }
+    if (status == 0) {
+        fprintf(stderr, "Generated %lld lines (%lld bytes) with %zu players in %s.\n", lines, bytes,
+                options->numberOfPlayers, options->fileName);
+    }
+
+    free(names);
+    free(nameLengths);
+    free(cumulative);
+    free(buffer);
+    return status;
+}
+
+/* Parses the options of the bench command (argv[0] is "bench")
+ * returns 0 on success or -1 if the arguments are incorrect */
+int parseBenchOptions(int argc, char *argv[], BenchOptions *options) {
+    static const int defaultThreads[] = {1, 2, 4, 8};
+
+    memset(options, 0, sizeof(BenchOptions));
+    options->numThreads = sizeof(defaultThreads) / sizeof(defaultThreads[0]);
+    memcpy(options->threads, defaultThreads, sizeof(defaultThreads));
+    options->numStrategies = NUMBER_OF_STRATEGIES;
+    for (size_t i = 0; i < NUMBER_OF_STRATEGIES; i++) {
+        options->strategies[i] = &strategies[i];
+    }
+    options->sizes[0] = 16LL << 20;
+    options->numSizes = 1;
+    options->skews[0] = 1.0;
+    options->numSkews = 1;
+    options->numberOfPlayers = 1000;
+    options->repeat = 5;
+    options->warmup = 1;
+    options->outputFileName = NULL;
+    options->directory = ".";
+
+    for (int i = 1; i < argc; i++) {
+        char *items[MAX_BENCH_VALUES];
+        size_t numItems;
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            if (parseThreadList(argv[i] + 10, options->threads, &options->numThreads) == -1) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--strategies=", 13) == 0) {
+            if (parseStrategyList(argv[i] + 13, options->strategies, &options->numStrategies) == -1) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--sizes=", 8) == 0) {
+            if (splitList(argv[i] + 8, items, MAX_BENCH_VALUES, &numItems) == -1) {
+                return -1;
+            }
+            for (size_t j = 0; j < numItems; j++) {
+                options->sizes[j] = parseByteSize(items[j]);
+                if (options->sizes[j] <= 0) {
+                    fprintf(stderr, "Error: the size must be a number of bytes (K, M or G suffix allowed).\n");
+                    return -1;
+                }
+            }
+            options->numSizes = numItems;
+        } else if (strncmp(argv[i], "--skews=", 8) == 0) {
+            if (splitList(argv[i] + 8, items, MAX_BENCH_VALUES, &numItems) == -1) {
+                return -1;
+            }
+            for (size_t j = 0; j < numItems; j++) {
+                char *end;
+                options->skews[j] = strtod(items[j], &end);
+                if (end == items[j] || *end != '\0') {
+                    fprintf(stderr, "Error: invalid skew '%s'.\n", items[j]);
+                    return -1;
+                }
+                if (options->skews[j] < 0) {
+                    fprintf(stderr, "Error: the skew can't be negative.\n");
+                    return -1;
+                }
+            }
+            options->numSkews = numItems;
+        } else if (strncmp(argv[i], "--players=", 10) == 0) {
+            long players = atol(argv[i] + 10);
+            if (players <= 0) {
+                fprintf(stderr, "Error: the number of players must be greater than 0.\n");
+                return -1;
+            }
+            options->numberOfPlayers = players;
+        } else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            options->repeat = atoi(argv[i] + 9);
+            if (options->repeat <= 0) {
+                fprintf(stderr, "Error: the repetitions must be greater than 0.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--warmup=", 9) == 0) {
+            options->warmup = atoi(argv[i] + 9);
+            if (options->warmup < 0) {
+                fprintf(stderr, "Error: the warmup runs can't be negative.\n");
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            options->outputFileName = argv[i] + 9;
+        } else if (strncmp(argv[i], "--dir=", 6) == 0) {
+            options->directory = argv[i] + 6;
+        } else {
+            fprintf(stderr, "Error: unknown option '%s'.\n", argv[i]);
+            return -1;
+        }
+    }
+
+    if (options->numThreads == 0 || options->numStrategies == 0 || options->numSizes == 0 ||
+        options->numSkews == 0) {
+        fprintf(stderr, "Error: the lists can't be empty.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Splits a comma separated list in place into items and stores how many
+ * there are in numItems. Returns 0 on success or -1 if it has more than
+ * maxItems items */
+int splitList(char *argument, char **items, size_t maxItems, size_t *numItems) {
+    *numItems = 0;
+    char *savePointer;
+    for (char *item = strtok_r(argument, ",", &savePointer); item != NULL;
+         item = strtok_r(NULL, ",", &savePointer)) {
+        if (*numItems == maxItems) {
+            fprintf(stderr, "Error: a list can have at most %zu values.\n", maxItems);
+            return -1;
+        }
+        items[(*numItems)++] = item;
+    }
+    return 0;
+}
+
+/* Parses a comma separated list of numbers of threads (up to
+ * MAX_BENCH_VALUES) of the bench and stress commands. Returns 0 on success or
+ * -1 if it is empty, too long or has a value that isn't a positive number */
+int parseThreadList(char *argument, int *threads, size_t *numThreads) {
+    char *items[MAX_BENCH_VALUES];
+    size_t numItems;
+    if (splitList(argument, items, MAX_BENCH_VALUES, &numItems) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < numItems; i++) {
+        char *end;
+        errno = 0;
+        long value = strtol(items[i], &end, 10);
+        if (end == items[i] || *end != '\0' || errno == ERANGE || value <= 0 || value > INT_MAX) {
+            fprintf(stderr, "Error: invalid number of threads '%s', it must be greater than 0.\n", items[i]);
+            return -1;
+        }
+        threads[i] = value;
+    }
+    if (numItems == 0) {
+        fprintf(stderr, "Error: the list of threads can't be empty.\n");
+        return -1;
+    }
+
+    *numThreads = numItems;
+    return 0;
+}
+
+/* Parses a comma separated list of strategy names (up to MAX_BENCH_VALUES)
+ * of the bench and stress commands. Returns 0 on success or -1 if it is
+ * empty, too long or names an unknown strategy */
+int parseStrategyList(char *argument, const AggregationStrategy **selected, size_t *numStrategies) {
+    char *items[MAX_BENCH_VALUES];
+    size_t numItems;
+    if (splitList(argument, items, MAX_BENCH_VALUES, &numItems) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < numItems; i++) {
+        selected[i] = findStrategy(items[i]);
+        if (selected[i] == NULL) {
+            fprintf(stderr, "Error: unknown strategy '%s'.\n", items[i]);
+            return -1;
+        }
+    }
+    if (numItems == 0) {
+        fprintf(stderr, "Error: the list of strategies can't be empty.\n");
+        return -1;
+    }
+
+    *numStrategies = numItems;
+    return 0;
+}
+
+/* Comparison function for qsort to sort doubles in ascending order */
+int compareDoubles(const void *a, const void *b) {
+    double valueA = *(const double *) a;
+    double valueB = *(const double *) b;
+    return (valueA > valueB) - (valueA < valueB);
+}
+
+/* Times the hot functions one by one over a sequence of keys drawn from
+ * generated names with a Zipf distribution, and prints their ns/op */
+int runMicrobenchCommand(int argc, char *argv[], const char *programName) {
+    size_t numKeys = 1000000;
+    size_t numberOfPlayers = 1000;
+    double skew = 1.0;
+    int maxThreads = 8;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--keys=", 7) == 0 && atol(argv[i] + 7) > 0) {
+            numKeys = atol(argv[i] + 7);
+        } else if (strncmp(argv[i], "--players=", 10) == 0 && atol(argv[i] + 10) > 0) {
+            numberOfPlayers = atol(argv[i] + 10);
+        } else if (strncmp(argv[i], "--skew=", 7) == 0 && atof(argv[i] + 7) >= 0) {
+            skew = atof(argv[i] + 7);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0 && atoi(argv[i] + 10) > 0) {
+            maxThreads = atoi(argv[i] + 10);
+        } else {
+            fprintf(stderr, "Usage: %s microbench [--keys=<n>] [--players=<n>] [--skew=<s>] [--threads=<n>]\n",
+                    programName);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Names of the players (10% with UTF-8 characters) and the lines of the
+    // matches where they were the MVP, drawn with the same seed every time
+    char (*names)[64] = malloc(numberOfPlayers * sizeof(*names));
+    double *cumulative = buildZipfTable(numberOfPlayers, skew);
+    char **keys = malloc(numKeys * sizeof(char *));
+    char (*lines)[128] = malloc(numKeys * sizeof(*lines));
+    pthread_t *threads = malloc(maxThreads * sizeof(pthread_t));
+    MicrobenchThread *threadWork = malloc(maxThreads * sizeof(MicrobenchThread));
+    if (names == NULL || cumulative == NULL || keys == NULL || lines == NULL || threads == NULL ||
+        threadWork == NULL) {
+        perror("Error allocating memory for the microbenchmarks");
+        free(names);
+        free(cumulative);
+        free(keys);
+        free(lines);
+        free(threads);
+        free(threadWork);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < numberOfPlayers; i++) {
+        buildPlayerName(i, nextRandomDouble(&state) < 0.1, names[i]);
+    }
+    for (size_t i = 0; i < numKeys; i++) {
+        keys[i] = names[sampleZipf(cumulative, numberOfPlayers, nextRandomDouble(&state))];
+        snprintf(lines[i], sizeof(lines[i]), "Grupo MD1,%s,%s,%d-%d,%s\n",
+                 generatorClubs[i % 32], generatorClubs[(i + 7) % 32], (int) (i % 4), (int) (i % 3), keys[i]);
+    }
+
+    volatile unsigned long sink = 0;
+    double start;
+    printf("%-36s %12s\n", "Benchmark", "ns/op");
+
+    // Hash functions, reduced to a table of 1024 buckets
+    unsigned long hashes = 0;
+    start = nowSeconds();
+    for (size_t i = 0; i < numKeys; i++) {
+        hashes += hashGenerator(keys[i], 1024);
+    }
+    printMicrobenchResult("hashGenerator", nowSeconds() - start, numKeys);
+    start = nowSeconds();
+    for (size_t i = 0; i < numKeys; i++) {
+        hashes += hashFnv1a(keys[i], 1024);
+    }
+    printMicrobenchResult("hashFnv1a (alternative)", nowSeconds() - start, numKeys);
+    sink += hashes;
+
+    // Visible characters of the names
+    long characters = 0;
+    start = nowSeconds();
+    for (size_t i = 0; i < numKeys; i++) {
+        characters += countVisibleCharacters(keys[i]);
+    }
+    printMicrobenchResult("countVisibleCharacters", nowSeconds() - start, numKeys);
+    sink += characters;
+
+    // Extraction of the last and of the fifth field of the lines
+    size_t lengths = 0;
+    for (int column = -1; column <= 4; column += 5) {
+        start = nowSeconds();
+        for (size_t i = 0; i < numKeys; i++) {
+            size_t length;
+            if (findField(lines[i], column, ',', &length) != NULL) {
+                lengths += length;
+            }
+        }
+        printMicrobenchResult(column < 0 ? "findField (last column)" : "findField (column 4)",
+                              nowSeconds() - start, numKeys);
+    }
+    sink += lengths;
+
+    // incrementOrInsertHashItem on a shared table by 1, 2, 4, ... threads
+    // (the last run always uses maxThreads)
+    for (int numberOfThreads = 1; numberOfThreads <= maxThreads;
+         numberOfThreads = numberOfThreads * 2 > maxThreads ? maxThreads : numberOfThreads * 2) {
+        HashTable *table = createHashTable(numberOfPlayers);
+        if (table == NULL) {
+            break;
+        }
+
+        size_t keysPerThread = numKeys / numberOfThreads;
+        start = nowSeconds();
+        for (int i = 0; i < numberOfThreads; i++) {
+            threadWork[i] = (MicrobenchThread) {table, keys + i * keysPerThread, keysPerThread};
+            pthread_create(&threads[i], NULL, incrementKeysThread, &threadWork[i]);
+        }
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "incrementOrInsertHashItem (%d thr)", numberOfThreads);
+        printMicrobenchResult(name, nowSeconds() - start, keysPerThread * numberOfThreads);
+
+        // Keep the last table to sort it and format its report
+        if (numberOfThreads == maxThreads) {
+            SortableList list = {NULL, 0, 0};
+            iterateHashTable(table, appendSortableItem, &list);
+            SortableItem *copy = malloc(list.count * sizeof(SortableItem));
+            if (list.items != NULL && copy != NULL) {
+                // Sorts of the report, every one from the same unsorted copy
+                long rounds = 1 + numKeys / (list.count > 0 ? list.count : 1) / 10;
+                start = nowSeconds();
+                for (long round = 0; round < rounds; round++) {
+                    memcpy(copy, list.items, list.count * sizeof(SortableItem));
+                    qsort(copy, list.count, sizeof(SortableItem), compareByMVPCounts);
+                }
+                printMicrobenchResult("qsort (compareByMVPCounts) per item", nowSeconds() - start,
+                                      rounds * list.count);
+                start = nowSeconds();
+                for (long round = 0; round < rounds; round++) {
+                    memcpy(copy, list.items, list.count * sizeof(SortableItem));
+                    sortByCountsDescending(copy, list.count);
+                }
+                printMicrobenchResult("counting sort per item", nowSeconds() - start, rounds * list.count);
+
+                // Lines of the report, formatted to /dev/null
+                FILE *devNull = fopen("/dev/null", "w");
+                if (devNull != NULL) {
+                    start = nowSeconds();
+                    for (long round = 0; round < rounds; round++) {
+                        for (size_t i = 0; i < list.count; i++) {
+                            writeReportLine(devNull, copy[i].key, copy[i].value);
+                        }
+                    }
+                    printMicrobenchResult("writeReportLine", nowSeconds() - start, rounds * list.count);
+                    fclose(devNull);
+                }
+            }
+            free(copy);
+            free(list.items);
+            freeHashTable(table);
+            break;
+        }
+        freeHashTable(table);
+    }
+
+    free(names);
+    free(cumulative);
+    free(keys);
+    free(lines);
+    free(threads);
+    free(threadWork);
+
+    return sink == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* FNV-1a hash of a key reduced to the size of the table, an alternative to
+ * hashGenerator that needs a single modulo per key */
+unsigned int hashFnv1a(char *key, int size) {
+    uint32_t hashValue = 2166136261u;
+    for (size_t i = 0; key[i] != '\0'; i++) {
+        hashValue ^= (unsigned char) key[i];
+        hashValue *= 16777619u;
+    }
+    return hashValue % size;
+}
+
+/* Sorts the items by count in descending order with a counting sort over the
+ * counts, an alternative to qsort with compareByMVPCounts (stable) */
+void sortByCountsDescending(SortableItem *items, size_t count) {
+    int maxValue = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].value > maxValue) {
+            maxValue = items[i].value;
+        }
+    }
+
+    size_t *starts = calloc(maxValue + 2, sizeof(size_t));
+    SortableItem *sorted = malloc(count * sizeof(SortableItem));
+    if (starts == NULL || sorted == NULL) {
+        free(starts);
+        free(sorted);
+        qsort(items, count, sizeof(SortableItem), compareByMVPCounts);
+        return;
+    }
+
+    // Bigger counts go first, so the positions are accumulated from the top
+    for (size_t i = 0; i < count; i++) {
+        starts[maxValue - items[i].value + 1]++;
+    }
+    for (int i = 1; i <= maxValue + 1; i++) {
+        starts[i] += starts[i - 1];
+    }
+    for (size_t i = 0; i < count; i++) {
+        sorted[starts[maxValue - items[i].value]++] = items[i];
+    }
+
+    memcpy(items, sorted, count * sizeof(SortableItem));
+    free(starts);
+    free(sorted);
+}
+
+/* Thread function of the microbenchmark: increments its keys in the shared
+ * table with incrementOrInsertHashItem */
+void *incrementKeysThread(void *arg) {
+    MicrobenchThread *work = arg;
+    for (size_t i = 0; i < work->numKeys; i++) {
+        incrementOrInsertHashItem(work->table, work->keys[i], 1);
+    }
+    return NULL;
+}
+
+/* Prints the time per operation of a microbenchmark */
+void printMicrobenchResult(const char *name, double seconds, long operations) {
+    printf("%-36s %12.2f\n", name, operations > 0 ? seconds * 1e9 / operations : 0);
+}
+
+/* Checks every strategy and number of threads against a single-threaded
+ * reference over the given inputs and over generated ones */
+int runVerifyCommand(int argc, char *argv[], const char *programName) {
+    VerifyOptions options;
+    if (parseVerifyOptions(argc, argv, &options) == -1) {
+        fprintf(stderr, "Usage: %s verify [archivo.txt ...] [--expected=<reporte.txt>] [--threads=<n,...>]\n"
+                        "       [--strategies=<name,...>] [--sizes=<n,...>] [--skews=<s,...>] [--players=<n>]\n"
+                        "       [--dir=<directory>]\n", programName);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < options.numInputs; i++) {
+        failures += verifyInput(&options, options.inputs[i], i == 0 ? options.expectedFileName : NULL);
+    }
+
+    // Generated inputs with a mix of UTF-8 names and line lengths
+    for (size_t i = 0; i < options.sweep.numSizes; i++) {
+        for (size_t j = 0; j < options.sweep.numSkews; j++) {
+            char fileName[4096];
+            snprintf(fileName, sizeof(fileName), "%s/verify_%zu_%zu.txt", options.sweep.directory, i, j);
+            GeneratorOptions generatorOptions = {fileName, 0, options.sweep.sizes[i], options.sweep.numberOfPlayers,
+                                                 options.sweep.skews[j], 0.3, 20, 200, 1 + i * 31 + j};
+            if (generateInputFile(&generatorOptions) == -1) {
+                failures++;
+                continue;
+            }
+            failures += verifyInput(&options, fileName, NULL);
+            remove(fileName);
+        }
+    }
+
+    // Names longer than the padding of the report lines
+    char longKeyFileName[4096];
+    snprintf(longKeyFileName, sizeof(longKeyFileName), "%s/verify_long_keys.txt", options.sweep.directory);
+    if (writeLongKeyInput(longKeyFileName) == -1) {
+        failures++;
+    } else {
+        failures += verifyInput(&options, longKeyFileName, NULL);
+        remove(longKeyFileName);
+    }
+    free(options.inputs);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "All checks passed.\n");
+    return EXIT_SUCCESS;
+}
+
+/* Writes a small input whose MVP names (some of them with accents) are 100
+ * to 300 bytes long. Returns 0 on success or -1 on error */
+int writeLongKeyInput(const char *fileName) {
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        perror("Error creating the long key input");
+        return -1;
+    }
+
+    const size_t numSyllables = sizeof(generatorSyllables) / sizeof(generatorSyllables[0]);
+    for (int i = 0; i < 2000; i++) {
+        int player = i * 7 % 51;
+        char name[320];
+        size_t length = 0;
+        for (int j = 0; length < 100 + (size_t) player * 4; j++) {
+            length += snprintf(name + length, sizeof(name) - length, "%s",
+                               generatorSyllables[(player + j) % numSyllables]);
+        }
+        fprintf(file, "%s,%s,%s,%d-%d,%s%s\n", generatorStages[i % 10], generatorClubs[i % 32],
+                generatorClubs[(i + 5) % 32], i % 4, i % 3, name, player % 2 ? " José" : "");
+    }
+
+    if (fclose(file) == EOF) {
+        perror("Error writing the long key input");
+        return -1;
+    }
+    return 0;
+}
+
+/* Parses the options of the verify command (argv[0] is "verify"): the input
+ * files and --expected, the rest are parsed as options of bench.
+ * Returns 0 on success or -1 if the arguments are incorrect, in both cases
+ * the caller must free options->inputs */
+int parseVerifyOptions(int argc, char *argv[], VerifyOptions *options) {
+    options->inputs = malloc(argc * sizeof(char *));
+    options->numInputs = 0;
+    options->expectedFileName = NULL;
+    char **sweepArguments = malloc(argc * sizeof(char *));
+    if (options->inputs == NULL || sweepArguments == NULL) {
+        perror("Error allocating memory for the verify options");
+        free(sweepArguments);
+        return -1;
+    }
+
+    int numSweepArguments = 0;
+    int sizesGiven = 0;
+    int skewsGiven = 0;
+    sweepArguments[numSweepArguments++] = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--expected=", 11) == 0) {
+            options->expectedFileName = argv[i] + 11;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            sizesGiven |= strncmp(argv[i], "--sizes=", 8) == 0;
+            skewsGiven |= strncmp(argv[i], "--skews=", 8) == 0;
+            sweepArguments[numSweepArguments++] = argv[i];
+        } else {
+            options->inputs[options->numInputs++] = argv[i];
+        }
+    }
+
+    int status = parseBenchOptions(numSweepArguments, sweepArguments, &options->sweep);
+    free(sweepArguments);
+    if (status == -1 || (options->expectedFileName != NULL && options->numInputs == 0)) {
+        return -1;
+    }
+
+    // By default the generated inputs are small, with uniform and skewed awards
+    if (!sizesGiven) {
+        options->sweep.sizes[0] = 4LL << 20;
+        options->sweep.numSizes = 1;
+    }
+    if (!skewsGiven) {
+        options->sweep.skews[0] = 0;
+        options->sweep.skews[1] = 1.2;
+        options->sweep.numSkews = 2;
+    }
+
+    return 0;
+}
+
+/* Checks the reference of an input against its expected report (if given)
+ * and every strategy, number of threads and variant of verifyVariants
+ * against the reference of the variant. Returns the number of failed checks */
+int verifyInput(const VerifyOptions *options, const char *fileName, const char *expectedFileName) {
+    const size_t numVariants = sizeof(verifyVariants) / sizeof(verifyVariants[0]);
+    int failures = 0;
+
+    char snapshotFileName[4096];
+    snprintf(snapshotFileName, sizeof(snapshotFileName), "%s/verify_reference.snap", options->sweep.directory);
+    char reportFileName[4096];
+    snprintf(reportFileName, sizeof(reportFileName), "%s/verify_report.txt", options->sweep.directory);
+
+    for (size_t v = 0; v < numVariants; v++) {
+        const VerifyVariant *variant = &verifyVariants[v];
+        HashTable *reference = countReference(fileName, &variant->query, variant->dedup);
+        if (reference == NULL) {
+            failures++;
+            continue;
+        }
+
+        if (v == 0 && expectedFileName != NULL) {
+            // The padding of the report hides the trailing spaces of the
+            // names, so they are removed from the reference as well
+            HashTable *expected = loadReport(expectedFileName);
+            HashTable *trimmed = createHashTable(reference->size);
+            if (trimmed != NULL) {
+                iterateHashTable(reference, addTrimmedItem, trimmed);
+            }
+            size_t differences = expected != NULL && trimmed != NULL ? countTableDifferences(expected, trimmed) : 1;
+            fprintf(stderr, "%s %-40s reference vs %s (%zu differences)\n", differences == 0 ? "PASS" : "FAIL",
+                    fileName, expectedFileName, differences);
+            failures += differences != 0;
+            freeHashTable(expected);
+            freeHashTable(trimmed);
+        }
+
+        // The snapshot variant loads the reference itself
+        if (variant->snapshot) {
+            FILE *file = fopen(snapshotFileName, "w");
+            if (file == NULL) {
+                perror("Error creating the reference snapshot");
+                freeHashTable(reference);
+                failures++;
+                continue;
+            }
+            fprintf(file, "%s\n", SNAPSHOT_HEADER);
+            iterateHashTable(reference, writeSnapshotItem, file);
+            fclose(file);
+        }
+
+        for (size_t s = 0; s < options->sweep.numStrategies; s++) {
+            const AggregationStrategy *strategy = options->sweep.strategies[s];
+
+            // The sketch is only exact when every player has a counter
+            if (strcmp(strategy->name, "sketch") == 0 && reference->count > sketchCapacity) {
+                fprintf(stderr, "SKIP %-40s %-10s %-24s (%zu players, %zu counters)\n", fileName, strategy->name,
+                        variant->name, reference->count, sketchCapacity);
+                continue;
+            }
+
+            for (size_t t = 0; t < options->sweep.numThreads; t++) {
+                int numberOfThreads = options->sweep.threads[t];
+                size_t differences = verifyVariant(variant, strategy, numberOfThreads, fileName, reference,
+                                                   snapshotFileName, reportFileName);
+                fprintf(stderr, "%s %-40s %-10s %3d threads %-24s (%zu differences)\n",
+                        differences == 0 ? "PASS" : "FAIL", fileName, strategy->name, numberOfThreads,
+                        variant->name, differences);
+                failures += differences != 0;
+            }
+        }
+
+        if (variant->snapshot) {
+            remove(snapshotFileName);
+        }
+        freeHashTable(reference);
+    }
+
+    return failures;
+}
+
+/* Counts an input with a variant of verify, a strategy and a number of
+ * threads, and compares every group of the result with the reference (the
+ * report variant compares the report written to reportFileName instead).
+ * Returns the number of differences (1 if the count failed) */
+size_t verifyVariant(const VerifyVariant *variant, const AggregationStrategy *strategy, int numberOfThreads,
+                     const char *fileName, HashTable *reference, const char *snapshotFileName,
+                     const char *reportFileName) {
+    ProgramOptions programOptions = {0};
+    programOptions.query = variant->query;
+    programOptions.strategy = strategy;
+    programOptions.numberOfThreads = numberOfThreads;
+    programOptions.dedup = variant->dedup;
+    size_t numGroups = variant->perFile || variant->snapshot ? 2 : 1;
+
+    InputList inputList = {NULL, 0, 0};
+    int added = addInputFile(&inputList, fileName, 0) == 0 &&
+                (!variant->perFile || addInputFile(&inputList, fileName, 1) == 0);
+
+    void **states = NULL;
+    if (added && variant->snapshot) {
+        // Like diff: the snapshot is loaded in its group before the scan
+        // merges both of them
+        int *groupLineCounts = countInputLines(&inputList, 2);
+        if (groupLineCounts != NULL) {
+            groupLineCounts[1] = getLineCountFromFile(snapshotFileName);
+            states = createStates(strategy, groupLineCounts, 2, numberOfThreads);
+            free(groupLineCounts);
+        }
+        if (states != NULL && (loadSnapshot(strategy, states[1], snapshotFileName, 0) == -1 ||
+                               aggregateInputs(&inputList, &programOptions, states, 2) == -1)) {
+            destroyStates(strategy, states, 2);
+            states = NULL;
+        }
+    } else if (added) {
+        states = countInputs(&inputList, &programOptions, numGroups);
+    }
+    freeInputList(&inputList);
+
+    if (states == NULL) {
+        return 1;
+    }
+    size_t differences = 0;
+    if (variant->report) {
+        // The padding of the report hides the trailing spaces of the names
+        HashTable *loaded = writeReportOfPlayersSortedByMVPCount(strategy, states[0], reportFileName) == 0 ?
+                            loadReport(reportFileName) : NULL;
+        HashTable *trimmed = createHashTable(reference->size);
+        if (trimmed != NULL) {
+            iterateHashTable(reference, addTrimmedItem, trimmed);
+        }
+        differences = loaded != NULL && trimmed != NULL ? countTableDifferences(trimmed, loaded) : 1;
+        freeHashTable(loaded);
+        freeHashTable(trimmed);
+        remove(reportFileName);
+    } else {
+        for (size_t i = 0; i < numGroups; i++) {
+            differences += countTableDifferences(reference, strategy->resultTable(states[i]));
+        }
+    }
+    destroyStates(strategy, states, numGroups);
+
+    return differences;
+}
+
+/* Counts the keys of a file for a query line by line in a single thread, as
+ * simply as possible so it can be trusted as the reference: the lines whose
+ * filter column doesn't start with the prefix are skipped and, with dedup,
+ * the copies of a previous line. Returns the table of counts or NULL on error */
+HashTable *countReference(const char *fileName, const ParserQuery *query, int dedup) {
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        return NULL;
+    }
+
+    HashTable *table = createHashTable(4096);
+    HashTable *seenLines = dedup ? createHashTable(4096) : NULL;
+    if (dedup && seenLines == NULL) {
+        freeHashTable(table);
+        table = NULL;
+    }
+    char *line = NULL;
+    size_t capacity = 0;
+    while (table != NULL && getline(&line, &capacity, file) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        size_t length;
+        if (query->filterColumn >= 0) {
+            const char *field = findReferenceField(line, query->filterColumn, &length);
+            if (field == NULL || length < query->filterPrefixLength ||
+                strncmp(field, query->filterPrefix, query->filterPrefixLength) != 0) {
+                continue;
+            }
+        }
+
+        if (seenLines != NULL) {
+            if (findHashItem(seenLines, line) != NULL) {
+                continue;
+            }
+            if (addToHashItem(seenLines, line, 1) == -1) {
+                freeHashTable(table);
+                table = NULL;
+                break;
+            }
+        }
+
+        char *key = (char *) findReferenceField(line, query->column, &length);
+        if (key == NULL || length == 0) {
+            continue;
+        }
+        key[length] = '\0';
+        if (addToHashItem(table, key, 1) == -1) {
+            freeHashTable(table);
+            table = NULL;
+        }
+    }
+
+    if (seenLines != NULL) {
+        freeHashTable(seenLines);
+    }
+    free(line);
+    fclose(file);
+    return table;
+}
+
+/* Finds a field of a line (without its line break) for the reference, the
+ * last one if column is -1, and stores its length. Returns NULL if the line
+ * has fewer fields */
+const char *findReferenceField(const char *line, int column, size_t *length) {
+    const char *field = line;
+    if (column < 0) {
+        const char *separator = strrchr(line, ',');
+        field = separator != NULL ? separator + 1 : line;
+    } else {
+        for (int i = 0; i < column; i++) {
+            field = strchr(field, ',');
+            if (field == NULL) {
+                return NULL;
+            }
+            field++;
+        }
+    }
+
+    const char *end = strchr(field, ',');
+    *length = end != NULL && column >= 0 ? (size_t) (end - field) : strlen(field);
+    return field;
+}
+
+/* Reads the counts of a report written by writeReportOfPlayersSortedByMVPCount
+ * (two header lines, then "player<padding>|<TAB>count").
+ * Returns the table of counts or NULL on error */
+HashTable *loadReport(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        perror("Error opening the expected report");
+        return NULL;
+    }
+
+    HashTable *table = createHashTable(4096);
+    char buffer[1024];
+    int lineNumber = 0;
+    while (table != NULL && fgets(buffer, sizeof(buffer), file)) {
+        char *separator = strrchr(buffer, '|');
+        if (++lineNumber <= 2 || separator == NULL) {
+            continue;
+        }
+
+        // Remove the padding after the name
+        char *end = separator;
+        while (end > buffer && end[-1] == ' ') {
+            end--;
+        }
+        *end = '\0';
+        if (addToHashItem(table, buffer, atoi(separator + 1)) == -1) {
+            freeHashTable(table);
+            table = NULL;
+        }
+    }
+
+    fclose(file);
+    return table;
+}
+
+/* ItemVisitor that adds a (player, count) pair to a table without the
+ * trailing spaces of the name */
+void addTrimmedItem(const char *key, int value, void *context) {
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "%s", key);
+    size_t length = strlen(buffer);
+    while (length > 0 && buffer[length - 1] == ' ') {
+        buffer[--length] = '\0';
+    }
+    addToHashItem(context, buffer, value);
+}
+
+/* Returns the number of players whose count differs between two tables,
+ * including the players that are only in one of them */
+size_t countTableDifferences(HashTable *expected, HashTable *actual) {
+    size_t differences = 0;
+    size_t matched = 0;
+    for (size_t i = 0; i < expected->size; i++) {
+        for (HashItem *current = expected->items[i]; current != NULL; current = current->next) {
+            HashItem *item = findHashItem(actual, current->key);
+            if (item == NULL || item->value != current->value) {
+                differences++;
+            }
+            if (item != NULL) {
+                matched++;
+            }
+        }
+    }
+
+    // Players of actual that aren't in expected
+    size_t actualItems = 0;
+    for (size_t i = 0; i < actual->size; i++) {
+        for (HashItem *current = actual->items[i]; current != NULL; current = current->next) {
+            actualItems++;
+        }
+    }
+
+    return differences + (actualItems - matched);
+}
+
+// Names of the distributions of the stress command
+const char *stressDistributionNames[NUMBER_OF_STRESS_DISTRIBUTIONS] = {"single", "distinct", "colliding"};
+
+/* Runs every strategy with every number of threads over the adversarial key
+ * distributions and writes their throughput and batch latencies as JSON */
+int runStressCommand(int argc, char *argv[], const char *programName) {
+    static const int defaultThreads[] = {1, 2, 4, 8};
+    int threads[MAX_BENCH_VALUES];
+    size_t numThreads = sizeof(defaultThreads) / sizeof(defaultThreads[0]);
+    memcpy(threads, defaultThreads, sizeof(defaultThreads));
+    const AggregationStrategy *selected[MAX_BENCH_VALUES];
+    size_t numStrategies = NUMBER_OF_STRATEGIES;
+    for (size_t i = 0; i < NUMBER_OF_STRATEGIES; i++) {
+        selected[i] = &strategies[i];
+    }
+    size_t numKeys = 200000;
+    size_t numCollisions = 256;
+    const char *outputFileName = NULL;
+
+    int valid = 1;
+    for (int i = 1; i < argc && valid; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            valid = parseThreadList(argv[i] + 10, threads, &numThreads) == 0;
+        } else if (strncmp(argv[i], "--strategies=", 13) == 0) {
+            valid = parseStrategyList(argv[i] + 13, selected, &numStrategies) == 0;
+        } else if (strncmp(argv[i], "--keys=", 7) == 0 && atol(argv[i] + 7) > 0) {
+            numKeys = atol(argv[i] + 7);
+        } else if (strncmp(argv[i], "--collisions=", 13) == 0 && atol(argv[i] + 13) > 0) {
+            numCollisions = atol(argv[i] + 13);
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            outputFileName = argv[i] + 9;
+        } else {
+            valid = 0;
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Usage: %s stress [--threads=<n,...>] [--strategies=<name,...>] [--keys=<n>]\n"
+                        "       [--collisions=<n>] [--output=<file.json>]\n", programName);
+        return EXIT_FAILURE;
+    }
+
+    FILE *output = stdout;
+    if (outputFileName != NULL) {
+        output = fopen(outputFileName, "w");
+        if (output == NULL) {
+            perror("Error creating the stress output file");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Enough room for the latencies of the batches of every thread, each
+    // thread may have a last batch that isn't full
+    int maxThreads = 0;
+    for (size_t i = 0; i < numThreads; i++) {
+        maxThreads = threads[i] > maxThreads ? threads[i] : maxThreads;
+    }
+    double *latencies = malloc((numKeys / STRESS_BATCH_SIZE + maxThreads) * sizeof(double));
+    if (latencies == NULL) {
+        perror("Error allocating memory for the latencies");
+        if (output != stdout) {
+            fclose(output);
+        }
+        return EXIT_FAILURE;
+    }
+
+    fprintf(output, "{\n  \"keys\": %zu,\n  \"batch\": %d,\n  \"collisions\": %zu,\n  \"results\": [",
+            numKeys, STRESS_BATCH_SIZE, numCollisions);
+
+    int status = EXIT_SUCCESS;
+    int first = 1;
+    for (int d = 0; d < NUMBER_OF_STRESS_DISTRIBUTIONS && status == EXIT_SUCCESS; d++) {
+        char *storage = NULL;
+        char **keys = buildStressKeys(d, numKeys, numCollisions, &storage);
+        if (keys == NULL) {
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        for (size_t s = 0; s < numStrategies && status == EXIT_SUCCESS; s++) {
+            for (size_t t = 0; t < numThreads; t++) {
+                double seconds;
+                int numBatches = stressConfiguration(selected[s], threads[t], keys, numKeys, &seconds, latencies);
+                if (numBatches == -1) {
+                    status = EXIT_FAILURE;
+                    break;
+                }
+
+                // Percentiles (nearest rank) of the latency of the batches
+                qsort(latencies, numBatches, sizeof(double), compareDoubles);
+                double p50 = latencies[(int) ceil(0.50 * numBatches) - 1];
+                double p99 = latencies[(int) ceil(0.99 * numBatches) - 1];
+                double p999 = latencies[(int) ceil(0.999 * numBatches) - 1];
+                double max = latencies[numBatches - 1];
+
+                fprintf(output, "%s\n    {\"distribution\": \"%s\", \"strategy\": \"%s\", \"threads\": %d, "
+                                "\"seconds\": %.6f, \"keys_per_second\": %.0f, \"batch_p50_us\": %.3f, "
+                                "\"batch_p99_us\": %.3f, \"batch_p999_us\": %.3f, \"batch_max_us\": %.3f}",
+                        first ? "" : ",", stressDistributionNames[d], selected[s]->name, threads[t], seconds,
+                        numKeys / seconds, p50 * 1e6, p99 * 1e6, p999 * 1e6, max * 1e6);
+                first = 0;
+
+                fprintf(stderr, "%-10s %-10s %3d threads %12.0f keys/s p99 %10.3f us max %10.3f us\n",
+                        stressDistributionNames[d], selected[s]->name, threads[t], numKeys / seconds,
+                        p99 * 1e6, max * 1e6);
+            }
+        }
+
+        free(keys);
+        free(storage);
+    }
+
+    fprintf(output, "\n  ]\n}\n");
+    if (output != stdout && fclose(output) == EOF) {
+        perror("Error writing the stress output file");
+        status = EXIT_FAILURE;
+    }
+    free(latencies);
+
+    return status;
+}
+
+/* Builds the sequence of keys of a distribution, the names are stored in
+ * *storage (freed by the caller together with the returned array).
+ * Colliding keys are made of blocks "Aa" and "BB", which have the same
+ * polynomial hash with base 31, so any combination of the same number of
+ * blocks falls in the same bucket whatever the size of the table.
+ * Returns the keys or NULL on error */
+char **buildStressKeys(StressDistribution distribution, size_t numKeys, size_t numCollisions, char **storage) {
+    size_t numNames = distribution == STRESS_SINGLE_KEY ? 1 :
+                      distribution == STRESS_DISTINCT_KEYS ? numKeys : numCollisions;
+    char **keys = malloc(numKeys * sizeof(char *));
+    char (*names)[64] = malloc(numNames * sizeof(*names));
+    if (keys == NULL || names == NULL) {
+        perror("Error allocating memory for the stress keys");
+        free(keys);
+        free(names);
+        return NULL;
+    }
+
+    // Blocks needed to have numCollisions different combinations
+    int numBlocks = 1;
+    while (((size_t) 1 << numBlocks) < numNames && numBlocks < 24) {
+        numBlocks++;
+    }
+
+    for (size_t i = 0; i < numNames; i++) {
+        if (distribution == STRESS_COLLIDING_KEYS) {
+            int length = snprintf(names[i], sizeof(names[i]), "Jugador ");
+            for (int block = 0; block < numBlocks; block++) {
+                memcpy(names[i] + length, (i >> block) & 1 ? "BB" : "Aa", 2);
+                length += 2;
+            }
+            names[i][length] = '\0';
+        } else {
+            buildPlayerName(i, 0, names[i]);
+        }
+    }
+
+    for (size_t i = 0; i < numKeys; i++) {
+        keys[i] = names[i % numNames];
+    }
+
+    *storage = (char *) names;
+    return keys;
+}
+
+/* Adds the keys to a new state of the strategy with the given number of
+ * threads (each one a contiguous share), timing every batch. The wall time
+ * is stored in seconds and the batch latencies in latencies.
+ * Returns the number of batches or -1 on error */
+int stressConfiguration(const AggregationStrategy *strategy, int numberOfThreads, char **keys, size_t numKeys,
+                        double *seconds, double *latencies) {
+    void *state = strategy->init(numKeys, numberOfThreads);
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+    StressThread *work = calloc(numberOfThreads, sizeof(StressThread));
+    if (state == NULL || threads == NULL || work == NULL) {
+        fprintf(stderr, "Error preparing the stress run.\n");
+        if (state != NULL) {
+            strategy->destroy(state);
+        }
+        free(threads);
+        free(work);
+        return -1;
+    }
+
+    size_t numBatches = 0;
+    size_t start = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        size_t share = numKeys / numberOfThreads + ((size_t) i < numKeys % numberOfThreads);
+        work[i] = (StressThread) {strategy, state, i, keys + start, share, latencies + numBatches, 0};
+        start += share;
+        numBatches += (share + STRESS_BATCH_SIZE - 1) / STRESS_BATCH_SIZE;
+    }
+
+    double startSeconds = nowSeconds();
+    for (int i = 0; i < numberOfThreads; i++) {
+        pthread_create(&threads[i], NULL, addStressBatches, &work[i]);
+    }
+    for (int i = 0; i < numberOfThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    strategy->merge(state);
+    *seconds = nowSeconds() - startSeconds;
+
+    strategy->destroy(state);
+    free(threads);
+    free(work);
+
+    return numBatches;
+}
+
+/* Thread function of the stress command: adds its keys in batches of
+ * STRESS_BATCH_SIZE and stores how long every batch took */
+void *addStressBatches(void *arg) {
+    StressThread *work = arg;
+
+    for (size_t i = 0; i < work->numKeys; i += STRESS_BATCH_SIZE) {
+        size_t batch = work->numKeys - i < STRESS_BATCH_SIZE ? work->numKeys - i : STRESS_BATCH_SIZE;
+        double start = nowSeconds();
+        work->strategy->addBatch(work->state, work->tid, work->keys + i, NULL, batch);
+        work->latencies[work->numBatches++] = nowSeconds() - start;
+    }
+
+    return NULL;
+}
+
+/* Hashes the bytes of a unit, mapped in memory and hashed 8 at a time.
+ * Units of the memo blocks start and end after a '\n', so they are exactly
+ * the bytes a LineReader reads for them. The deadline is checked every
+ * MEMO_HASH_SLICE bytes. Returns 0 on success, 1 if the deadline stopped it
+ * or -1 on error */
+int hashWorkUnit(const char *path, const WorkUnit *unit, uint64_t seed, uint64_t *hashValue) {
+    *hashValue = hashWords(seed, NULL, 0);
+    long length = unit->endOffset - unit->startOffset;
+    if (length == 0) {
+        return 0;
+    }
+
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor == -1) {
         perror("Error opening file");
+        return -1;
+    }
+
+    // The mapping starts at a page boundary, before the unit
+    long pageSize = sysconf(_SC_PAGESIZE);
+    long mapOffset = unit->startOffset - unit->startOffset % pageSize;
+    size_t mapLength = unit->endOffset - mapOffset;
+    unsigned char *data = mmap(NULL, mapLength, PROT_READ, MAP_PRIVATE, descriptor, mapOffset);
+    close(descriptor);
+    if (data == MAP_FAILED) {
+        perror("Error mapping file");
+        return -1;
+    }
+    madvise(data, mapLength, MADV_SEQUENTIAL);
+
+    int status = 0;
+    const unsigned char *bytes = data + (unit->startOffset - mapOffset);
+    *hashValue = seed;
+    for (long position = 0; position < length; position += MEMO_HASH_SLICE) {
+        if (__atomic_load_n(&deadlineTimer.expired, __ATOMIC_RELAXED)) {
+            status = 1;
+            break;
+        }
+        long slice = length - position < MEMO_HASH_SLICE ? length - position : MEMO_HASH_SLICE;
+        *hashValue = hashWords(*hashValue, bytes + position, slice);
+    }
+
+    munmap(data, mapLength);
+    return status;
+}
+
+/* Loads the memoized aggregate of a unit with --memo-dir into the state if
+ * the directory has one for a block with the same content. The name of its
+ * entry is stored in memoFileName and its number of lines in lines.
+ * Returns 1 if it was loaded, 0 if the block must be scanned or -1 on error
+ * (then the state may have part of the entry and the run must fail) */
+int loadMemoizedUnit(ThreadData *threadData, const WorkUnit *unit, void *state, char *memoFileName,
+                     size_t size, long *lines) {
+    // A hash stopped by the deadline leaves the block to the scan, that
+    // stops before reading anything
+    uint64_t hashValue;
+    int hashed = hashWorkUnit(threadData->files[unit->fileIndex].path, unit, threadData->memoSeed, &hashValue);
+    if (hashed != 0) {
+        return hashed == 1 ? 0 : -1;
+    }
+    snprintf(memoFileName, size, "%s/%016llx.snap", threadData->memoDirName, (unsigned long long) hashValue);
+
+    // Reuse the block if the entry has the same length
+    char chunkLine[64];
+    snprintf(chunkLine, sizeof(chunkLine), "# chunk %ld", unit->endOffset - unit->startOffset);
+    FILE *file = fopen(memoFileName, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char buffer[128];
+    int valid = fgets(buffer, sizeof(buffer), file) != NULL &&
+                strncmp(buffer, SNAPSHOT_HEADER, strlen(SNAPSHOT_HEADER)) == 0 &&
+                fgets(buffer, sizeof(buffer), file) != NULL &&
+                strncmp(buffer, chunkLine, strlen(chunkLine)) == 0 &&
+                sscanf(buffer + strlen(chunkLine), " lines=%ld", lines) == 1;
+    fclose(file);
+    if (!valid) {
+        return 0;
+    }
+
+    if (loadSnapshot(threadData->strategy, state, memoFileName, threadData->tid) == -1) {
+        fprintf(stderr, "Thread %d: Failed to load the memoized block %s\n", threadData->tid, memoFileName);
+        return -1;
+    }
+    return 1;
+}
+
+/* Saves the keys counted in a scanned unit as its memoized aggregate, through
+ * a temporary file so other runs never read half an entry. A block that can't
+ * be saved is only scanned again by the next run, so failures are warnings.
+ * Returns 0 on success or -1 if the entry wasn't saved */
+int saveMemoizedUnit(ThreadData *threadData, const WorkUnit *unit, HashTable *partial, const char *memoFileName,
+                     long lines) {
+    char temporaryFileName[4200];
+    snprintf(temporaryFileName, sizeof(temporaryFileName), "%s.%d.%d.tmp", memoFileName, (int) getpid(),
+             threadData->tid);
+
+    int status = -1;
+    FILE *file = fopen(temporaryFileName, "w");
+    if (file != NULL) {
+        fprintf(file, "%s\n# chunk %ld lines=%ld\n", SNAPSHOT_HEADER, unit->endOffset - unit->startOffset, lines);
+        iterateHashTable(partial, writeSnapshotItem, file);
+        if (fclose(file) == 0 && rename(temporaryFileName, memoFileName) == 0) {
+            status = 0;
+        }
+    }
+    if (status == -1) {
+        fprintf(stderr, "Warning: failed to save the memoized block %s\n", memoFileName);
+        remove(temporaryFileName);
+    }
+
+    return status;
+}
+
+/* Parses the inputs once into a columnar store and writes a sorted report
+ * for every --group-by column, counting over the id arrays */
+int runReportsCommand(int argc, char *argv[], const char *programName) {
+    int groupColumns[MAX_STORE_COLUMNS];
+    size_t numGroupColumns = 0;
+    int scoreColumn = DEFAULT_SCORE_COLUMN;
+    int teams = 0;
+    const char *playerClubsFileName = NULL;   // Club of every player (or NULL)
+
+    // The options of the command are taken out, the rest (inputs, threads,
+    // filter, delimiter and --stats) are parsed like in the count command
+    char **countArgv = malloc((argc + 1) * sizeof(char *));
+    if (countArgv == NULL) {
+        perror("Error allocating memory for the arguments");
+        return EXIT_FAILURE;
+    }
+    int countArgc = 0;
+    int valid = 1;
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(argv[i], "--group-by=", 11) == 0) {
+            char *items[MAX_STORE_COLUMNS];
+            valid &= splitList(argv[i] + 11, items, MAX_STORE_COLUMNS, &numGroupColumns) == 0;
+            for (size_t j = 0; j < numGroupColumns; j++) {
+                char *end;
+                groupColumns[j] = strcmp(items[j], "last") == 0 ? -1 : (int) strtol(items[j], &end, 10);
+                valid &= strcmp(items[j], "last") == 0 || (*end == '\0' && groupColumns[j] >= 0);
+            }
+            valid &= numGroupColumns > 0;
+        } else if (strncmp(argv[i], "--score-column=", 15) == 0) {
+            scoreColumn = atoi(argv[i] + 15);
+            valid &= scoreColumn >= 0;
+        } else if (strcmp(argv[i], "--teams") == 0) {
+            teams = 1;
+        } else if (strncmp(argv[i], "--teams=", 8) == 0) {
+            teams = 1;
+            playerClubsFileName = argv[i] + 8;
+        } else {
+            countArgv[countArgc++] = argv[i];
+        }
+    }
+    countArgv[countArgc] = NULL;
+
+    ProgramOptions options;
+    if (!valid || parseProgramOptions(countArgc, countArgv, &options) == -1 || options.numInputs == 0 ||
+        options.perFile || options.snapshotFileName != NULL || options.dedup || options.cacheDirName != NULL ||
+        options.memoDirName != NULL || options.deadlineMilliseconds > 0) {
+        fprintf(stderr, "Usage: %s reports archivo.txt|directorio [...] num_hebras [--group-by=<n|last>,...]\n"
+                        "       [--score-column=<n>] [--filter=<column>:<prefix>] [--delimiter=<c>]\n"
+                        "       [--teams[=<jugadores.txt>]] [--stats]\n",
+                programName);
+        free(options.inputs);
+        free(countArgv);
+        return EXIT_FAILURE;
+    }
+    free(countArgv);
+    if (numGroupColumns == 0) {
+        groupColumns[numGroupColumns++] = options.query.column;
+    }
+    statistics.enabled = options.stats;
+
+    InputList inputList = {NULL, 0, 0};
+    for (size_t i = 0; i < options.numInputs; i++) {
+        if (addInputPath(&inputList, options.inputs[i], 0) == -1) {
+            freeInputList(&inputList);
+            free(options.inputs);
+            return EXIT_FAILURE;
+        }
+    }
+    free(options.inputs);
+
+    // The text is parsed only here, the reports only read the store
+    double buildStart = nowSeconds();
+    ColumnStore store;
+    if (buildColumnStore(&store, &inputList, options.query.delimiter, scoreColumn,
+                         options.numberOfThreads) == -1) {
+        fprintf(stderr, "Error while building the columnar store.\n");
+        freeInputList(&inputList);
+        return EXIT_FAILURE;
+    }
+    double buildSeconds = nowSeconds() - buildStart;
+    freeInputList(&inputList);
+
+    // The filter is resolved once to the ids of its column that are kept
+    unsigned char *keep = NULL;
+    int filterColumn = -1;
+    int status = EXIT_SUCCESS;
+    if (options.query.filterColumn >= 0) {
+        filterColumn = resolveStoreColumn(&store, options.query.filterColumn);
+        keep = filterColumn < 0 ? NULL : matchStorePrefix(&store, filterColumn, options.query.filterPrefix,
+                                                          options.query.filterPrefixLength);
+        if (keep == NULL) {
+            fprintf(stderr, "Error: the filter column %d isn't in the inputs.\n", options.query.filterColumn);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (statistics.enabled) {
+        fprintf(stderr, "Columnar store: %zu rows, %d columns, built in %.3f s\n", store.numRows,
+                store.numColumns, buildSeconds);
+        for (int i = 0; i < store.numColumns; i++) {
+            fprintf(stderr, "  column %d: %zu distinct values\n", i, store.dictionaries[i].count);
+        }
+        fprintf(stderr, "  last field: %zu distinct values\n", store.dictionaries[LAST_STORE_COLUMN].count);
+    }
+
+    for (size_t i = 0; i < numGroupColumns && status == EXIT_SUCCESS; i++) {
+        int column = resolveStoreColumn(&store, groupColumns[i]);
+        if (column < 0) {
+            fprintf(stderr, "Error: the column %d isn't in the inputs.\n", groupColumns[i]);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        // The last field is the MVP, its report is the usual one
+        char reportFileName[64] = "reporte_mvp.txt";
+        if (column != LAST_STORE_COLUMN) {
+            snprintf(reportFileName, sizeof(reportFileName), "reporte_columna_%d.txt", column);
+        }
+
+        double queryStart = nowSeconds();
+        int *counts = countStoreColumn(&store, column, filterColumn, keep, options.numberOfThreads);
+        if (counts == NULL || writeStoreReport(&store, column, counts, reportFileName) == -1) {
+            fprintf(stderr, "Error while writing the report of the column %d.\n", column);
+            status = EXIT_FAILURE;
+        }
+        free(counts);
+
+        if (statistics.enabled) {
+            fprintf(stderr, "%s (column %d): %.3f ms\n", reportFileName, column,
+                    (nowSeconds() - queryStart) * 1e3);
+        }
+    }
+
+    // The clubs and sides come from the same store, without scanning again
+    if (teams && status == EXIT_SUCCESS) {
+        double teamsStart = nowSeconds();
+        if (writeTeamReports(&store, filterColumn, keep, playerClubsFileName, options.query.delimiter,
+                             options.numberOfThreads) == -1) {
+            status = EXIT_FAILURE;
+        }
+        if (statistics.enabled) {
+            fprintf(stderr, "reporte_clubes.txt and reporte_mvp_lados.txt: %.3f ms\n",
+                    (nowSeconds() - teamsStart) * 1e3);
+        }
+    }
+
+    if (statistics.enabled) {
+        printMemoryStatistics();
+    }
+
+    free(keep);
+    freeColumnStore(&store);
+
+    return status;
+}
+
+/* Initializes an empty columnar store */
+void initColumnStore(ColumnStore *store, int scoreColumn) {
+    memset(store, 0, sizeof(ColumnStore));
+    store->scoreColumn = scoreColumn;
+}
+
+/* Frees the id arrays, the goals and the dictionaries of a store */
+void freeColumnStore(ColumnStore *store) {
+    for (int i = 0; i <= LAST_STORE_COLUMN; i++) {
+        if (store->columns[i] != NULL) {
+            trackedFree(MEMORY_COLUMNS, store->columns[i], store->capacity * sizeof(int));
+            freeColumnDictionary(&store->dictionaries[i]);
+        }
+    }
+    trackedFree(MEMORY_COLUMNS, store->homeGoals, store->capacity * sizeof(short));
+    trackedFree(MEMORY_COLUMNS, store->awayGoals, store->capacity * sizeof(short));
+    initColumnStore(store, store->scoreColumn);
+}
+
+/* Frees the values and the table of a dictionary */
+void freeColumnDictionary(ColumnDictionary *dictionary) {
+    trackedFree(MEMORY_NAMES, dictionary->values, dictionary->capacity * sizeof(char *));
+    freeHashTable(dictionary->ids);
+    memset(dictionary, 0, sizeof(ColumnDictionary));
+}
+
+/* Returns the id of a value in the dictionary, adding it with the next id if
+ * it is new. Returns -1 on error */
+int internColumnValue(ColumnDictionary *dictionary, char *value) {
+    HashItem *item = findHashItem(dictionary->ids, value);
+    if (item != NULL) {
+        return item->value;
+    }
+
+    // Keep the chains short, the number of distinct values isn't known
+    if (dictionary->count >= dictionary->ids->size * 2 && growColumnDictionary(dictionary) == -1) {
+        return -1;
+    }
+    if (dictionary->count == dictionary->capacity) {
+        size_t newCapacity = dictionary->capacity == 0 ? 64 : dictionary->capacity * 2;
+        char **newValues = trackedRealloc(MEMORY_NAMES, dictionary->values, dictionary->capacity * sizeof(char *),
+                                          newCapacity * sizeof(char *));
+        if (newValues == NULL) {
+            perror("Failed to allocate memory for the column dictionary");
+            return -1;
+        }
+        dictionary->values = newValues;
+        dictionary->capacity = newCapacity;
+    }
+
+    int id = dictionary->count;
+    if (addToHashItem(dictionary->ids, value, id) == -1) {
+        return -1;
+    }
+    // The new item is the head of its chain
+    dictionary->values[id] = dictionary->ids->items[hashGenerator(value, dictionary->ids->size)]->key;
+    dictionary->count++;
+
+    return id;
+}
+
+/* Doubles the buckets of the table of a dictionary, moving its items to the
+ * new chains. Returns 0 on success or -1 on error */
+int growColumnDictionary(ColumnDictionary *dictionary) {
+    HashTable *table = dictionary->ids;
+    size_t newSize = table->size * 2;
+    HashItem **newItems = trackedCalloc(MEMORY_BUCKETS, newSize, sizeof(HashItem *));
+    if (newItems == NULL) {
+        perror("Failed to allocate memory for the column dictionary");
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        HashItem *item = table->items[i];
+        while (item != NULL) {
+            HashItem *next = item->next;
+            unsigned int index = hashGenerator(item->key, newSize);
+            item->next = newItems[index];
+            newItems[index] = item;
+            item = next;
+        }
+    }
+
+    trackedFree(MEMORY_BUCKETS, table->items, table->size * sizeof(HashItem *));
+    table->items = newItems;
+    table->size = newSize;
+
+    return 0;
+}
+
+/* Makes room in the arrays of the store for at least numRows rows
+ * returns 0 on success or -1 on error */
+int reserveStoreRows(ColumnStore *store, size_t numRows) {
+    if (numRows <= store->capacity) {
+        return 0;
+    }
+    size_t newCapacity = store->capacity == 0 ? 4096 : store->capacity;
+    while (newCapacity < numRows) {
+        newCapacity *= 2;
+    }
+
+    for (int i = 0; i <= LAST_STORE_COLUMN; i++) {
+        if (store->columns[i] == NULL) {
+            continue;
+        }
+        int *newColumn = trackedRealloc(MEMORY_COLUMNS, store->columns[i], store->capacity * sizeof(int),
+                                        newCapacity * sizeof(int));
+        if (newColumn == NULL) {
+            perror("Failed to allocate memory for the columnar store");
+            return -1;
+        }
+        store->columns[i] = newColumn;
+    }
+    short *newHomeGoals = trackedRealloc(MEMORY_COLUMNS, store->homeGoals, store->capacity * sizeof(short),
+                                         newCapacity * sizeof(short));
+    if (newHomeGoals != NULL) {
+        store->homeGoals = newHomeGoals;
+    }
+    short *newAwayGoals = trackedRealloc(MEMORY_COLUMNS, store->awayGoals, store->capacity * sizeof(short),
+                                         newCapacity * sizeof(short));
+    if (newAwayGoals != NULL) {
+        store->awayGoals = newAwayGoals;
+    }
+    if (newHomeGoals == NULL || newAwayGoals == NULL) {
+        perror("Failed to allocate memory for the columnar store");
+        return -1;
+    }
+    store->capacity = newCapacity;
+
+    return 0;
+}
+
+/* Adds the next column to the store, the rows already stored don't have it
+ * (-1). Returns 0 on success or -1 on error */
+int addStoreColumn(ColumnStore *store) {
+    if (createStoreColumn(store, store->numColumns) == -1) {
+        return -1;
+    }
+    store->numColumns++;
+
+    return 0;
+}
+
+/* Allocates the ids and the dictionary of a slot of the store, the rows
+ * already stored don't have it (-1). The store must have room for some rows.
+ * Returns 0 on success or -1 on error */
+int createStoreColumn(ColumnStore *store, int column) {
+    ColumnDictionary *dictionary = &store->dictionaries[column];
+
+    store->columns[column] = trackedMalloc(MEMORY_COLUMNS, store->capacity * sizeof(int));
+    dictionary->ids = createHashTable(INITIAL_DICTIONARY_SIZE);
+    if (store->columns[column] == NULL || dictionary->ids == NULL) {
+        perror("Failed to allocate memory for a column of the store");
+        trackedFree(MEMORY_COLUMNS, store->columns[column], store->capacity * sizeof(int));
+        store->columns[column] = NULL;
+        freeHashTable(dictionary->ids);
+        memset(dictionary, 0, sizeof(ColumnDictionary));
+        return -1;
+    }
+    for (size_t i = 0; i < store->numRows; i++) {
+        store->columns[column][i] = -1;
+    }
+    dictionary->values = NULL;
+    dictionary->count = 0;
+    dictionary->capacity = 0;
+
+    return 0;
+}
+
+/* Splits a line (modifying it) and appends its fields to the store as ids
+ * of their dictionaries, adding columns if the line has more fields than
+ * the previous ones, and its last field to LAST_STORE_COLUMN. Returns 0 on
+ * success or -1 on error (also if the line has more than MAX_STORE_COLUMNS
+ * fields) */
+int addStoreRow(ColumnStore *store, char *line, char delimiter) {
+    if (reserveStoreRows(store, store->numRows + 1) == -1) {
+        return -1;
+    }
+    if (store->columns[LAST_STORE_COLUMN] == NULL && createStoreColumn(store, LAST_STORE_COLUMN) == -1) {
+        return -1;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+
+    size_t row = store->numRows;
+    store->homeGoals[row] = -1;
+    store->awayGoals[row] = -1;
+
+    int column = 0;
+    char *field = line;
+    while (field != NULL) {
+        char *next = strchr(field, delimiter);
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        if (column == MAX_STORE_COLUMNS) {
+            fprintf(stderr, "Error: a line has more than %d fields, the columnar store can't hold it.\n",
+                    MAX_STORE_COLUMNS);
+            return -1;
+        }
+
+        if (column == store->numColumns && addStoreColumn(store) == -1) {
+            return -1;
+        }
+        int id = internColumnValue(&store->dictionaries[column], field);
+        if (id == -1) {
+            return -1;
+        }
+        store->columns[column][row] = id;
+        if (column == store->scoreColumn) {
+            parseScore(field, &store->homeGoals[row], &store->awayGoals[row]);
+        }
+
+        // The last field is interned once more, in its own slot
+        if (next == NULL) {
+            id = internColumnValue(&store->dictionaries[LAST_STORE_COLUMN], field);
+            if (id == -1) {
+                return -1;
+            }
+            store->columns[LAST_STORE_COLUMN][row] = id;
+        }
+
+        column++;
+        field = next;
+    }
+
+    // Columns the line doesn't have
+    for (; column < store->numColumns; column++) {
+        store->columns[column][row] = -1;
+    }
+    store->numRows++;
+
+    return 0;
+}
+
+/* Parses a score written as <home>-<away>, the goals are -1 if it isn't one */
+void parseScore(const char *field, short *homeGoals, short *awayGoals) {
+    char *end;
+    long home = strtol(field, &end, 10);
+    if (end == field || *end != '-' || home < 0) {
+        return;
+    }
+    const char *awayStart = end + 1;
+    long away = strtol(awayStart, &end, 10);
+    if (end == awayStart || away < 0 || home > SHRT_MAX || away > SHRT_MAX) {
+        return;
+    }
+
+    *homeGoals = home;
+    *awayGoals = away;
+}
+
+/* Thread function that parses the work units of a thread into its own part
+ * of the store (with its own dictionaries) */
+void *buildStorePart(void *arg) {
+    StoreBuildThread *buildThread = arg;
+    ThreadData *work = buildThread->work;
+
+    for (size_t i = 0; i < work->numUnits && buildThread->status == 0; i++) {
+        const WorkUnit *unit = &work->units[i];
+        LineReader reader;
+        if (openLineReader(&reader, work->files[unit->fileIndex].path, unit->startOffset, unit->endOffset) == -1) {
+            fprintf(stderr, "Thread %d: Failed to read file content\n", work->tid);
+            buildThread->status = -1;
+            break;
+        }
+
+        char *line;
+        while ((line = readLine(&reader)) != NULL) {
+            if (addStoreRow(&buildThread->part, line, buildThread->delimiter) == -1) {
+                buildThread->status = -1;
+                break;
+            }
+        }
+        fclose(reader.file);
+    }
+
+    return NULL;
+}
+
+/* Appends the rows of a part to the store, translating the ids of the
+ * dictionaries of the part to those of the store. Returns 0 on success or
+ * -1 on error */
+int appendColumnStore(ColumnStore *store, ColumnStore *part) {
+    if (part->numRows == 0) {
+        return 0;
+    }
+    if (reserveStoreRows(store, store->numRows + part->numRows) == -1) {
+        return -1;
+    }
+    while (store->numColumns < part->numColumns) {
+        if (addStoreColumn(store) == -1) {
+            return -1;
+        }
+    }
+    if (store->columns[LAST_STORE_COLUMN] == NULL && createStoreColumn(store, LAST_STORE_COLUMN) == -1) {
+        return -1;
+    }
+
+    for (int column = 0; column <= LAST_STORE_COLUMN; column++) {
+        if (store->columns[column] == NULL) {
+            continue;
+        }
+        int *destination = store->columns[column] + store->numRows;
+        if (part->columns[column] == NULL) {
+            for (size_t i = 0; i < part->numRows; i++) {
+                destination[i] = -1;
+            }
+            continue;
+        }
+
+        // Only the distinct values are looked up, the rows are translated
+        // with an array
+        ColumnDictionary *dictionary = &part->dictionaries[column];
+        int *translation = malloc((dictionary->count + 1) * sizeof(int));
+        if (translation == NULL) {
+            perror("Failed to allocate memory for the translation of the ids");
+            return -1;
+        }
+        for (size_t id = 0; id < dictionary->count; id++) {
+            translation[id] = internColumnValue(&store->dictionaries[column], dictionary->values[id]);
+            if (translation[id] == -1) {
+                free(translation);
+                return -1;
+            }
+        }
+
+        const int *source = part->columns[column];
+        for (size_t i = 0; i < part->numRows; i++) {
+            destination[i] = source[i] < 0 ? -1 : translation[source[i]];
+        }
+        free(translation);
+    }
+
+    memcpy(store->homeGoals + store->numRows, part->homeGoals, part->numRows * sizeof(short));
+    memcpy(store->awayGoals + store->numRows, part->awayGoals, part->numRows * sizeof(short));
+    store->numRows += part->numRows;
+
+    return 0;
+}
+
+/* Builds the columnar store of the inputs: the threads parse their work units
+ * into parts of their own, that are appended to the first one. Returns 0 on
+ * success or -1 on error (the store is left empty) */
+int buildColumnStore(ColumnStore *store, InputList *inputList, char delimiter, int scoreColumn,
+                     int numberOfThreads) {
+    initColumnStore(store, scoreColumn);
+
+    size_t numUnits;
+    WorkUnit *units = splitIntoWorkUnits(inputList, numberOfThreads, 0, &numUnits);
+    ThreadData *threadData = calloc(numberOfThreads, sizeof(ThreadData));
+    StoreBuildThread *buildThreads = calloc(numberOfThreads, sizeof(StoreBuildThread));
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+    WorkUnit *assignedUnits = NULL;
+    if (units == NULL || threadData == NULL || buildThreads == NULL || threads == NULL ||
+        (assignedUnits = assignWorkUnits(units, numUnits, threadData, numberOfThreads)) == NULL) {
+        fprintf(stderr, "Error preparing the threads of the columnar store.\n");
+        free(units);
+        free(threadData);
+        free(buildThreads);
+        free(threads);
+        return -1;
+    }
+    free(units);
+
+    for (int i = 0; i < numberOfThreads; i++) {
+        threadData[i].tid = i;
+        threadData[i].files = inputList->files;
+        buildThreads[i].work = &threadData[i];
+        buildThreads[i].delimiter = delimiter;
+        buildThreads[i].status = 0;
+        initColumnStore(&buildThreads[i].part, scoreColumn);
+        pthread_create(&threads[i], NULL, buildStorePart, &buildThreads[i]);
+    }
+    for (int i = 0; i < numberOfThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // The first part already has the ids of the store, the rest are
+    // translated to them
+    int status = buildThreads[0].status;
+    *store = buildThreads[0].part;
+    for (int i = 1; i < numberOfThreads; i++) {
+        if (status == 0 && buildThreads[i].status == 0) {
+            status = appendColumnStore(store, &buildThreads[i].part);
+        } else {
+            status = -1;
+        }
+        freeColumnStore(&buildThreads[i].part);
+    }
+    if (status == -1) {
+        freeColumnStore(store);
+    }
+
+    free(assignedUnits);
+    free(threadData);
+    free(buildThreads);
+    free(threads);
+
+    return status;
+}
+
+/* Translates a column of a query (-1 is the last field of every line) to a
+ * column of the store, returns -1 if the store doesn't have it */
+int resolveStoreColumn(const ColumnStore *store, int column) {
+    if (column < 0) {
+        return store->columns[LAST_STORE_COLUMN] != NULL ? LAST_STORE_COLUMN : -1;
+    }
+    return column < store->numColumns ? column : -1;
+}
+
+/* Returns how many threads go over the rows of the store: small stores
+ * aren't worth a thread per core */
+int countStoreThreads(const ColumnStore *store, int numberOfThreads) {
+    if (store->numRows / numberOfThreads < MIN_STORE_ROWS_PER_THREAD) {
+        return store->numRows / MIN_STORE_ROWS_PER_THREAD + 1;
+    }
+    return numberOfThreads;
+}
+
+/* Marks the ids of a column whose value starts with the prefix, so a filter
+ * is checked once per distinct value instead of once per row. Returns an
+ * array indexed by id or NULL on error */
+unsigned char *matchStorePrefix(const ColumnStore *store, int column, const char *prefix, size_t length) {
+    const ColumnDictionary *dictionary = &store->dictionaries[column];
+    unsigned char *keep = calloc(dictionary->count + 1, sizeof(unsigned char));
+    if (keep == NULL) {
+        perror("Failed to allocate memory for the filter");
+        return NULL;
+    }
+
+    for (size_t id = 0; id < dictionary->count; id++) {
+        keep[id] = strncmp(dictionary->values[id], prefix, length) == 0;
+    }
+
+    return keep;
+}
+
+/* Counts the rows of every value of a column, skipping those whose value of
+ * filterColumn isn't kept (if there is a filter). The rows are split among
+ * the threads, every one counts into its own array. Returns the counts
+ * indexed by id or NULL on error */
+int *countStoreColumn(const ColumnStore *store, int column, int filterColumn, const unsigned char *keep,
+                      int numberOfThreads) {
+    size_t numIds = store->dictionaries[column].count;
+
+    numberOfThreads = countStoreThreads(store, numberOfThreads);
+    size_t rowsPerThread = store->numRows / numberOfThreads;
+
+    StoreCountThread *work = calloc(numberOfThreads, sizeof(StoreCountThread));
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+    if (work == NULL || threads == NULL) {
+        perror("Failed to allocate memory for the count threads");
+        free(work);
+        free(threads);
+        return NULL;
+    }
+
+    int status = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        work[i].store = store;
+        work[i].column = column;
+        work[i].filterColumn = filterColumn;
+        work[i].keep = keep;
+        work[i].startRow = i * rowsPerThread;
+        work[i].endRow = i == numberOfThreads - 1 ? store->numRows : (i + 1) * rowsPerThread;
+        work[i].counts = calloc(numIds + 1, sizeof(int));
+        if (work[i].counts == NULL) {
+            perror("Failed to allocate memory for the counts");
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_create(&threads[i], NULL, countStoreRows, &work[i]);
+        }
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    // Add the counts of the threads to those of the first one
+    int *counts = work[0].counts;
+    for (int i = 1; i < numberOfThreads; i++) {
+        if (status == 0) {
+            for (size_t id = 0; id < numIds; id++) {
+                counts[id] += work[i].counts[id];
+            }
+        }
+        free(work[i].counts);
+    }
+    if (status == -1) {
+        free(counts);
+        counts = NULL;
+    }
+
+    free(work);
+    free(threads);
+
+    return counts;
+}
+
+/* Thread function that counts the ids of a range of rows */
+void *countStoreRows(void *arg) {
+    StoreCountThread *work = arg;
+    const int *ids = work->store->columns[work->column];
+    int *counts = work->counts;
+
+    if (work->filterColumn < 0) {
+        for (size_t i = work->startRow; i < work->endRow; i++) {
+            if (ids[i] >= 0) {
+                counts[ids[i]]++;
+            }
+        }
+        return NULL;
+    }
+
+    const int *filterIds = work->store->columns[work->filterColumn];
+    const unsigned char *keep = work->keep;
+    for (size_t i = work->startRow; i < work->endRow; i++) {
+        if (ids[i] >= 0 && filterIds[i] >= 0) {
+            counts[ids[i]] += keep[filterIds[i]];
+        }
+    }
+
+    return NULL;
+}
+
+/* Writes the values of a column with their counts, sorted in descending
+ * order, with the format of the MVP report. Returns 0 on success or -1 on
+ * error */
+int writeStoreReport(const ColumnStore *store, int column, const int *counts, const char *reportFileName) {
+    const ColumnDictionary *dictionary = &store->dictionaries[column];
+
+    // Only the values of the rows that were counted are written
+    SortableItem *items = trackedMalloc(MEMORY_NAMES, (dictionary->count + 1) * sizeof(SortableItem));
+    if (items == NULL) {
+        perror("Failed to allocate memory for sortable items.");
+        return -1;
+    }
+    size_t numItems = 0;
+    for (size_t id = 0; id < dictionary->count; id++) {
+        if (counts[id] > 0) {
+            items[numItems].key = dictionary->values[id];
+            items[numItems].value = counts[id];
+            numItems++;
+        }
+    }
+    qsort(items, numItems, sizeof(SortableItem), compareByMVPCounts);
+
+    FILE *fptr = fopen(reportFileName, "w");
+    if (fptr == NULL) {
+        perror("Error creating report file");
+        trackedFree(MEMORY_NAMES, items, (dictionary->count + 1) * sizeof(SortableItem));
+        return -1;
+    }
+
+    // The last field is the MVP, the columns count matches
+    if (column == LAST_STORE_COLUMN) {
+        fprintf(fptr, "%-24s|\tPremios\n", "Jugador MVP");
+    } else {
+        char label[32];
+        snprintf(label, sizeof(label), "Columna %d", column);
+        fprintf(fptr, "%-24s|\tPartidos\n", label);
+    }
+    fprintf(fptr, "-----------------------------------\n");
+
+    for (size_t i = 0; i < numItems; i++) {
+        writeReportLine(fptr, items[i].key, items[i].value);
+    }
+
+    fclose(fptr);
+    trackedFree(MEMORY_NAMES, items, (dictionary->count + 1) * sizeof(SortableItem));
+
+    return 0;
+}
+
+/* Attributes every award to the club of the MVP in a single pass over the
+ * store, writing the awards of every club and of every player by side
+ * (home or away) to reporte_clubes.txt and reporte_mvp_lados.txt. The side
+ * of the MVP is that of its club in the file of players and clubs (if given
+ * and the club played the match) or else the winner of the match, on a draw
+ * it can't be told. The rows whose filterColumn isn't kept are skipped.
+ * Returns 0 on success or -1 on error */
+int writeTeamReports(const ColumnStore *store, int filterColumn, const unsigned char *keep,
+                     const char *playerClubsFileName, char delimiter, int numberOfThreads) {
+    int homeColumn = resolveStoreColumn(store, DEFAULT_HOME_COLUMN);
+    int awayColumn = resolveStoreColumn(store, DEFAULT_AWAY_COLUMN);
+    int mvpColumn = resolveStoreColumn(store, -1);
+    if (homeColumn < 0 || awayColumn < 0 || mvpColumn <= awayColumn) {
+        fprintf(stderr, "Error: the inputs don't have the columns of the clubs and the MVP.\n");
+        return -1;
+    }
+
+    // The clubs of both columns (and of the file) share a dictionary, the
+    // ids of the columns are translated once per distinct value
+    const ColumnDictionary *homeDictionary = &store->dictionaries[homeColumn];
+    const ColumnDictionary *awayDictionary = &store->dictionaries[awayColumn];
+    const ColumnDictionary *players = &store->dictionaries[mvpColumn];
+    ColumnDictionary clubs = {createHashTable(INITIAL_DICTIONARY_SIZE), NULL, 0, 0};
+    int *homeClubs = malloc((homeDictionary->count + 1) * sizeof(int));
+    int *awayClubs = malloc((awayDictionary->count + 1) * sizeof(int));
+    int *playerClubs = NULL;
+    int status = clubs.ids == NULL || homeClubs == NULL || awayClubs == NULL ? -1 : 0;
+    for (size_t id = 0; id < homeDictionary->count && status == 0; id++) {
+        homeClubs[id] = internColumnValue(&clubs, homeDictionary->values[id]);
+        status = homeClubs[id] == -1 ? -1 : 0;
+    }
+    for (size_t id = 0; id < awayDictionary->count && status == 0; id++) {
+        awayClubs[id] = internColumnValue(&clubs, awayDictionary->values[id]);
+        status = awayClubs[id] == -1 ? -1 : 0;
+    }
+    if (status == 0 && playerClubsFileName != NULL) {
+        playerClubs = loadPlayerClubs(playerClubsFileName, players, &clubs, delimiter);
+        status = playerClubs == NULL ? -1 : 0;
+    }
+
+    numberOfThreads = countStoreThreads(store, numberOfThreads);
+    size_t rowsPerThread = store->numRows / numberOfThreads;
+    TeamThread *work = calloc(numberOfThreads, sizeof(TeamThread));
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+    if (work == NULL || threads == NULL) {
+        status = -1;
+    }
+    for (int i = 0; i < numberOfThreads && status == 0; i++) {
+        work[i].store = store;
+        work[i].homeColumn = homeColumn;
+        work[i].awayColumn = awayColumn;
+        work[i].mvpColumn = mvpColumn;
+        work[i].filterColumn = filterColumn;
+        work[i].keep = keep;
+        work[i].homeClubs = homeClubs;
+        work[i].awayClubs = awayClubs;
+        work[i].playerClubs = playerClubs;
+        work[i].startRow = i * rowsPerThread;
+        work[i].endRow = i == numberOfThreads - 1 ? store->numRows : (i + 1) * rowsPerThread;
+        work[i].clubCounts = calloc(2 * clubs.count + 1, sizeof(int));
+        work[i].playerCounts = calloc(3 * players->count + 1, sizeof(int));
+        work[i].unknownSide = 0;
+        if (work[i].clubCounts == NULL || work[i].playerCounts == NULL) {
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_create(&threads[i], NULL, attributeTeamAwards, &work[i]);
+        }
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        // Add the counts of the threads to those of the first one
+        for (int i = 1; i < numberOfThreads; i++) {
+            for (size_t j = 0; j < 2 * clubs.count; j++) {
+                work[0].clubCounts[j] += work[i].clubCounts[j];
+            }
+            for (size_t j = 0; j < 3 * players->count; j++) {
+                work[0].playerCounts[j] += work[i].playerCounts[j];
+            }
+            work[0].unknownSide += work[i].unknownSide;
+        }
+
+        TeamItem *items = malloc((clubs.count + players->count + 1) * sizeof(TeamItem));
+        if (items == NULL) {
+            status = -1;
+        }
+
+        size_t numItems = 0;
+        for (size_t id = 0; items != NULL && id < clubs.count; id++) {
+            int home = work[0].clubCounts[2 * id];
+            int away = work[0].clubCounts[2 * id + 1];
+            if (home + away > 0) {
+                items[numItems++] = (TeamItem) {clubs.values[id], home + away, home, away};
+            }
+        }
+        if (items != NULL && writeTeamReport("reporte_clubes.txt", "Club", items, numItems,
+                                             work[0].unknownSide) == -1) {
+            status = -1;
+        }
+
+        numItems = 0;
+        for (size_t id = 0; items != NULL && id < players->count; id++) {
+            const int *counts = &work[0].playerCounts[3 * id];
+            if (counts[2] > 0) {
+                items[numItems++] = (TeamItem) {players->values[id], counts[2], counts[0], counts[1]};
+            }
+        }
+        if (items != NULL && writeTeamReport("reporte_mvp_lados.txt", "Jugador MVP", items, numItems, -1) == -1) {
+            status = -1;
+        }
+        free(items);
+    }
+    if (status == -1) {
+        fprintf(stderr, "Error while attributing the awards to the clubs.\n");
+    }
+
+    for (int i = 0; work != NULL && i < numberOfThreads; i++) {
+        free(work[i].clubCounts);
+        free(work[i].playerCounts);
+    }
+    free(work);
+    free(threads);
+    free(homeClubs);
+    free(awayClubs);
+    free(playerClubs);
+    freeColumnDictionary(&clubs);
+
+    return status;
+}
+
+/* Reads a file of players and clubs (<player><delimiter><club> per line) and
+ * returns the id in clubs of the club of every player id (-1 for the players
+ * that aren't in the file), or NULL on error */
+int *loadPlayerClubs(const char *fileName, const ColumnDictionary *players, ColumnDictionary *clubs,
+                     char delimiter) {
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        perror("Error opening the file of players and clubs");
+        return NULL;
+    }
+
+    int *playerClubs = malloc((players->count + 1) * sizeof(int));
+    if (playerClubs == NULL) {
+        perror("Failed to allocate memory for the clubs of the players");
+        fclose(file);
         return NULL;
     }
+    for (size_t id = 0; id < players->count; id++) {
+        playerClubs[id] = -1;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, file) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *separator = strrchr(line, delimiter);
+        if (separator == NULL) {
+            continue;
+        }
+        *separator = '\0';
+
+        // Players without awards don't matter
+        HashItem *player = findHashItem(players->ids, line);
+        if (player == NULL) {
+            continue;
+        }
+        playerClubs[player->value] = internColumnValue(clubs, separator + 1);
+        if (playerClubs[player->value] == -1) {
+            free(playerClubs);
+            playerClubs = NULL;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return playerClubs;
+}
+
+/* Thread function that attributes the awards of a range of rows to the club
+ * and side of the MVP, only with the ids of the store */
+void *attributeTeamAwards(void *arg) {
+    TeamThread *work = arg;
+    const ColumnStore *store = work->store;
+    const int *homeIds = store->columns[work->homeColumn];
+    const int *awayIds = store->columns[work->awayColumn];
+    const int *mvpIds = store->columns[work->mvpColumn];
+    const int *filterIds = work->filterColumn >= 0 ? store->columns[work->filterColumn] : NULL;
+
+    for (size_t row = work->startRow; row < work->endRow; row++) {
+        int player = mvpIds[row];
+        if (player < 0 || (filterIds != NULL && (filterIds[row] < 0 || !work->keep[filterIds[row]]))) {
+            continue;
+        }
+        work->playerCounts[3 * player + 2]++;
+        if (homeIds[row] < 0 || awayIds[row] < 0) {
+            work->unknownSide++;
+            continue;
+        }
+        int clubs[2] = {work->homeClubs[homeIds[row]], work->awayClubs[awayIds[row]]};
+
+        // The club of the player decides if it played the match, else the
+        // winner does
+        int side = -1;
+        if (work->playerClubs != NULL && work->playerClubs[player] >= 0) {
+            side = work->playerClubs[player] == clubs[0] ? 0 : work->playerClubs[player] == clubs[1] ? 1 : -1;
+        }
+        if (side < 0 && store->homeGoals[row] >= 0 && store->homeGoals[row] != store->awayGoals[row]) {
+            side = store->homeGoals[row] > store->awayGoals[row] ? 0 : 1;
+        }
+        if (side < 0) {
+            work->unknownSide++;
+            continue;
+        }
+
+        work->clubCounts[2 * clubs[side] + side]++;
+        work->playerCounts[3 * player + side]++;
+    }
+
+    return NULL;
+}
+
+/* Comparison function for qsort to sort team items by awards (descending) */
+int compareTeamItems(const void *a, const void *b) {
+    const TeamItem *itemA = a;
+    const TeamItem *itemB = b;
+    return itemB->awards - itemA->awards;
+}
+
+/* Writes the awards of clubs or players by side sorted in descending order,
+ * followed by the awards without a side (if unknownSide isn't -1)
+ * returns 0 on success or -1 on error */
+int writeTeamReport(const char *reportFileName, const char *label, TeamItem *items, size_t numItems,
+                    long unknownSide) {
+    qsort(items, numItems, sizeof(TeamItem), compareTeamItems);
+
+    FILE *fptr = fopen(reportFileName, "w");
+    if (fptr == NULL) {
+        perror("Error creating report file");
+        return -1;
+    }
+
+    fprintf(fptr, "%-24s|\tPremios\tLocal\tVisita\n", label);
+    fprintf(fptr, "-----------------------------------\n");
+    for (size_t i = 0; i < numItems; i++) {
+        int padding = 24 - countVisibleCharacters(items[i].name);
+        fprintf(fptr, "%s%*s|\t%d\t%d\t%d\n", items[i].name, padding > 0 ? padding : 0, "", items[i].awards,
+                items[i].home, items[i].away);
+    }
+    if (unknownSide >= 0) {
+        fprintf(fptr, "-----------------------------------\n");
+        fprintf(fptr, "%-24s|\t%ld\n", "Sin lado", unknownSide);
+    }
 
-    char buffer[1024];
-    size_t numLinesInRange = endLine - startLine;
+    fclose(fptr);
+    return 0;
+}
 
-    // Allocate memory for an array of strings to store player names
-    char **playerNames = malloc(numLinesInRange * sizeof(char *));
-    if (playerNames == NULL) {
-        perror("Error allocating memory for array of player names");
-        fclose(file);
+/* Answers a query over the columnar store of the inputs and writes the
+ * result to stdout (or to --output) */
+int runQueryCommand(int argc, char *argv[], const char *programName) {
+    int scoreColumn = DEFAULT_SCORE_COLUMN;
+    const char *outputFileName = NULL;
+
+    // argv[1] is the query, the options of the command are taken out and the
+    // rest are parsed like in the count command
+    char **countArgv = malloc((argc + 1) * sizeof(char *));
+    if (countArgv == NULL) {
+        perror("Error allocating memory for the arguments");
+        return EXIT_FAILURE;
+    }
+    int countArgc = 0;
+    int valid = argc > 2;
+    for (int i = 0; i < argc; i++) {
+        if (i == 1) {
+            continue;
+        }
+        if (strncmp(argv[i], "--score-column=", 15) == 0) {
+            scoreColumn = atoi(argv[i] + 15);
+            valid &= scoreColumn >= 0;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            outputFileName = argv[i] + 9;
+        } else {
+            countArgv[countArgc++] = argv[i];
+        }
+    }
+    countArgv[countArgc] = NULL;
+
+    ProgramOptions options = {0};
+    if (!valid || parseProgramOptions(countArgc, countArgv, &options) == -1 || options.numInputs == 0 ||
+        options.perFile || options.snapshotFileName != NULL || options.dedup || options.cacheDirName != NULL ||
+        options.memoDirName != NULL || options.deadlineMilliseconds > 0 || options.query.filterColumn >= 0) {
+        fprintf(stderr, "Usage: %s query \"<SELECT ...>\" archivo.txt|directorio [...] num_hebras\n"
+                        "       [--score-column=<n>] [--delimiter=<c>] [--output=<file>] [--stats]\n",
+                programName);
+        free(options.inputs);
+        free(countArgv);
+        return EXIT_FAILURE;
+    }
+    free(countArgv);
+    statistics.enabled = options.stats;
+
+    // The query is checked before reading anything
+    SelectQuery query;
+    if (parseSelectQuery(argv[1], &query) == -1) {
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+
+    InputList inputList = {NULL, 0, 0};
+    for (size_t i = 0; i < options.numInputs; i++) {
+        if (addInputPath(&inputList, options.inputs[i], 0) == -1) {
+            freeInputList(&inputList);
+            free(options.inputs);
+            return EXIT_FAILURE;
+        }
+    }
+    free(options.inputs);
+
+    double buildStart = nowSeconds();
+    ColumnStore store;
+    if (buildColumnStore(&store, &inputList, options.query.delimiter, scoreColumn,
+                         options.numberOfThreads) == -1) {
+        fprintf(stderr, "Error while building the columnar store.\n");
+        freeInputList(&inputList);
+        return EXIT_FAILURE;
+    }
+    double buildSeconds = nowSeconds() - buildStart;
+    freeInputList(&inputList);
+
+    int status = EXIT_SUCCESS;
+    double queryStart = nowSeconds();
+    size_t numRows = 0;
+    size_t numGroups = 0;
+    QueryRow *rows = NULL;
+    if (compileSelectQuery(&query, &store) == -1) {
+        status = EXIT_FAILURE;
+    } else {
+        rows = executeSelectQuery(&query, &store, options.numberOfThreads, &numRows, &numGroups);
+        if (rows == NULL) {
+            fprintf(stderr, "Error while running the query.\n");
+            status = EXIT_FAILURE;
+        }
+    }
+    double querySeconds = nowSeconds() - queryStart;
+
+    if (rows != NULL) {
+        FILE *output = outputFileName != NULL ? fopen(outputFileName, "w") : stdout;
+        if (output == NULL) {
+            perror("Error creating the output file");
+            status = EXIT_FAILURE;
+        } else {
+            writeQueryResult(output, &query, rows, numRows);
+            if (output != stdout) {
+                fclose(output);
+            }
+        }
+    }
+
+    if (statistics.enabled) {
+        fprintf(stderr, "Columnar store: %zu rows, %d columns, built in %.3f s\n", store.numRows,
+                store.numColumns, buildSeconds);
+        fprintf(stderr, "Query: %zu groups, %zu rows, %.3f ms\n", numGroups, numRows, querySeconds * 1e3);
+        printMemoryStatistics();
+    }
+
+    free(rows);
+    freeSelectQuery(&query);
+    freeColumnStore(&store);
+
+    return status;
+}
+
+/* Splits a query into words, symbols and quoted strings ('' is a quote
+ * inside a string). Returns 0 on success or -1 if it can't be split */
+int tokenizeQuery(const char *text, QueryParser *parser) {
+    parser->numTokens = 0;
+    parser->position = 0;
+
+    const char *current = text;
+    while (*current != '\0') {
+        if (isspace((unsigned char) *current) || *current == ';') {
+            current++;
+            continue;
+        }
+        if (parser->numTokens == MAX_QUERY_TOKENS) {
+            fprintf(stderr, "Error in the query: it has more than %d tokens.\n", MAX_QUERY_TOKENS);
+            return -1;
+        }
+
+        QueryToken *token = &parser->tokens[parser->numTokens++];
+        size_t length = 0;
+        token->isString = 0;
+
+        if (*current == '\'') {
+            // Quoted string
+            token->isString = 1;
+            current++;
+            while (*current != '\0' && !(*current == '\'' && current[1] != '\'')) {
+                if (*current == '\'') {
+                    current++;
+                }
+                if (length == MAX_QUERY_TOKEN_LENGTH - 1) {
+                    break;
+                }
+                token->text[length++] = *current++;
+            }
+            if (*current != '\'') {
+                fprintf(stderr, "Error in the query: unterminated or too long string.\n");
+                return -1;
+            }
+            current++;
+        } else if (isalnum((unsigned char) *current) || *current == '_') {
+            // Word: keyword, column, function or number
+            while ((isalnum((unsigned char) *current) || *current == '_') && length < MAX_QUERY_TOKEN_LENGTH - 1) {
+                token->text[length++] = *current++;
+            }
+        } else if (strchr("<>!", *current) != NULL && (current[1] == '=' || (*current == '<' && current[1] == '>'))) {
+            // Symbols of two characters: <=, >=, !=, <>
+            token->text[length++] = *current++;
+            token->text[length++] = *current++;
+        } else if (strchr(",()*=<>", *current) != NULL) {
+            token->text[length++] = *current++;
+        } else {
+            fprintf(stderr, "Error in the query: unexpected character '%c'.\n", *current);
+            return -1;
+        }
+        token->text[length] = '\0';
+    }
+
+    return 0;
+}
+
+/* Advances over the next token if it is the given word or symbol (words
+ * ignore the case). Returns 1 if it was there or 0 if it wasn't */
+int acceptQueryToken(QueryParser *parser, const char *text) {
+    if (parser->position < parser->numTokens && !parser->tokens[parser->position].isString &&
+        strcasecmp(parser->tokens[parser->position].text, text) == 0) {
+        parser->position++;
+        return 1;
+    }
+    return 0;
+}
+
+/* Parses the name of a column or of the goals. Returns 0 on success or -1
+ * if the next token isn't one */
+int parseQueryValue(QueryParser *parser, QueryValue *value) {
+    if (parser->position == parser->numTokens || parser->tokens[parser->position].isString) {
+        fprintf(stderr, "Error in the query: a column was expected.\n");
+        return -1;
+    }
+    const char *name = parser->tokens[parser->position].text;
+
+    for (size_t i = 0; i < sizeof(queryValueNames) / sizeof(queryValueNames[0]); i++) {
+        if (strcasecmp(name, queryValueNames[i].name) == 0) {
+            *value = queryValueNames[i].value;
+            parser->position++;
+            return 0;
+        }
+    }
+
+    // Any column by its number: c0, c1...
+    char *end;
+    if ((name[0] == 'c' || name[0] == 'C') && isdigit((unsigned char) name[1])) {
+        long column = strtol(name + 1, &end, 10);
+        if (*end == '\0' && column < MAX_STORE_COLUMNS) {
+            value->kind = QUERY_TEXT;
+            value->column = column;
+            parser->position++;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Error in the query: unknown column '%s'.\n", name);
+    return -1;
+}
+
+/* Parses an item of SELECT: a column, count(*) or sum(<goals>)
+ * returns 0 on success or -1 on error */
+int parseSelectItem(QueryParser *parser, QuerySelectItem *item) {
+    item->value.kind = QUERY_TEXT;
+    item->value.column = 0;
+    item->index = 0;
+
+    if (acceptQueryToken(parser, "count")) {
+        if (!acceptQueryToken(parser, "(") || !acceptQueryToken(parser, "*") || !acceptQueryToken(parser, ")")) {
+            fprintf(stderr, "Error in the query: count only accepts count(*).\n");
+            return -1;
+        }
+        item->aggregate = QUERY_COUNT;
+        strcpy(item->name, "count(*)");
+        return 0;
+    }
+
+    if (acceptQueryToken(parser, "sum")) {
+        if (!acceptQueryToken(parser, "(") || parseQueryValue(parser, &item->value) == -1 ||
+            !acceptQueryToken(parser, ")") || item->value.kind == QUERY_TEXT) {
+            fprintf(stderr, "Error in the query: sum only accepts home_goals, away_goals or goals.\n");
+            return -1;
+        }
+        item->aggregate = QUERY_SUM;
+        snprintf(item->name, sizeof(item->name), "sum(%s)", parser->tokens[parser->position - 2].text);
+        return 0;
+    }
+
+    if (parseQueryValue(parser, &item->value) == -1) {
+        return -1;
+    }
+    if (item->value.kind != QUERY_TEXT) {
+        fprintf(stderr, "Error in the query: the goals can only be selected with sum.\n");
+        return -1;
+    }
+    item->aggregate = QUERY_NO_AGGREGATE;
+    strcpy(item->name, parser->tokens[parser->position - 1].text);
+
+    return 0;
+}
+
+/* Parses a condition of WHERE: <column> <operator> <value>
+ * returns 0 on success or -1 on error */
+int parseQueryCondition(QueryParser *parser, QueryCondition *condition) {
+    static const char *operators[] = {"=", "<>", "<", "<=", ">", ">=", "like"};
+
+    condition->keep = NULL;
+    if (parseQueryValue(parser, &condition->value) == -1) {
+        return -1;
+    }
+
+    int found = 0;
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]) && !found; i++) {
+        if (acceptQueryToken(parser, operators[i])) {
+            condition->operator = i;
+            found = 1;
+        }
+    }
+    if (!found && acceptQueryToken(parser, "!=")) {
+        condition->operator = QUERY_NOT_EQUAL;
+        found = 1;
+    }
+    if (!found || parser->position == parser->numTokens) {
+        fprintf(stderr, "Error in the query: a condition must be <column> <operator> <value>.\n");
+        return -1;
+    }
+
+    const QueryToken *literal = &parser->tokens[parser->position++];
+    strcpy(condition->text, literal->text);
+
+    // Text columns are compared with strings, the goals with numbers
+    if (condition->value.kind == QUERY_TEXT) {
+        if (!literal->isString || (condition->operator != QUERY_EQUAL && condition->operator != QUERY_NOT_EQUAL &&
+                                   condition->operator != QUERY_LIKE)) {
+            fprintf(stderr, "Error in the query: a column is compared with =, <> or LIKE and a 'string'.\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    char *end;
+    condition->number = strtol(literal->text, &end, 10);
+    if (literal->isString || *end != '\0' || end == literal->text || condition->operator == QUERY_LIKE) {
+        fprintf(stderr, "Error in the query: the goals are compared with a number.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Parses a query into its clauses. Returns 0 on success or -1 on error
+ * (with a message) */
+int parseSelectQuery(const char *text, SelectQuery *query) {
+    QueryParser *parser = malloc(sizeof(QueryParser));
+    if (parser == NULL) {
+        perror("Error allocating memory for the query");
+        return -1;
+    }
+    memset(query, 0, sizeof(SelectQuery));
+    query->limit = -1;
+
+    int status = tokenizeQuery(text, parser);
+    if (status == 0 && !acceptQueryToken(parser, "select")) {
+        fprintf(stderr, "Error in the query: it must start with SELECT.\n");
+        status = -1;
+    }
+
+    // SELECT <item>, ...
+    while (status == 0) {
+        if (query->numSelect == MAX_QUERY_ITEMS) {
+            fprintf(stderr, "Error in the query: more than %d items in a clause.\n", MAX_QUERY_ITEMS);
+            status = -1;
+            break;
+        }
+        status = parseSelectItem(parser, &query->select[query->numSelect++]);
+        if (!acceptQueryToken(parser, ",")) {
+            break;
+        }
+    }
+
+    // WHERE <condition> AND ...
+    if (status == 0 && acceptQueryToken(parser, "where")) {
+        do {
+            if (query->numWhere == MAX_QUERY_ITEMS) {
+                fprintf(stderr, "Error in the query: more than %d items in a clause.\n", MAX_QUERY_ITEMS);
+                status = -1;
+                break;
+            }
+            status = parseQueryCondition(parser, &query->where[query->numWhere++]);
+        } while (status == 0 && acceptQueryToken(parser, "and"));
+    }
+
+    // GROUP BY <column>, ...
+    if (status == 0 && acceptQueryToken(parser, "group")) {
+        if (!acceptQueryToken(parser, "by")) {
+            fprintf(stderr, "Error in the query: GROUP must be followed by BY.\n");
+            status = -1;
+        }
+        while (status == 0) {
+            if (query->numGroupBy == MAX_QUERY_ITEMS) {
+                fprintf(stderr, "Error in the query: more than %d items in a clause.\n", MAX_QUERY_ITEMS);
+                status = -1;
+                break;
+            }
+            QueryValue *value = &query->groupBy[query->numGroupBy++];
+            status = parseQueryValue(parser, value);
+            if (status == 0 && value->kind != QUERY_TEXT) {
+                fprintf(stderr, "Error in the query: the goals can't be grouped.\n");
+                status = -1;
+            }
+            if (!acceptQueryToken(parser, ",")) {
+                break;
+            }
+        }
+    }
+
+    // ORDER BY <position|column> [ASC|DESC], ...
+    if (status == 0 && acceptQueryToken(parser, "order")) {
+        if (!acceptQueryToken(parser, "by")) {
+            fprintf(stderr, "Error in the query: ORDER must be followed by BY.\n");
+            status = -1;
+        }
+        while (status == 0) {
+            if (query->numOrderBy == MAX_QUERY_ITEMS || parser->position == parser->numTokens) {
+                fprintf(stderr, "Error in the query: ORDER BY needs up to %d items.\n", MAX_QUERY_ITEMS);
+                status = -1;
+                break;
+            }
+            QueryOrder *order = &query->orderBy[query->numOrderBy++];
+            const char *key = parser->tokens[parser->position++].text;
+            char *end;
+            order->item = strtol(key, &end, 10) - 1;
+            if (*end != '\0' || end == key) {
+                order->item = -1;
+                for (size_t i = 0; i < query->numSelect && order->item < 0; i++) {
+                    if (strcasecmp(query->select[i].name, key) == 0) {
+                        order->item = i;
+                    }
+                }
+            }
+            if (order->item < 0 || order->item >= (int) query->numSelect) {
+                fprintf(stderr, "Error in the query: ORDER BY '%s' isn't an item of SELECT.\n", key);
+                status = -1;
+                break;
+            }
+            order->descending = acceptQueryToken(parser, "desc");
+            if (!order->descending) {
+                acceptQueryToken(parser, "asc");
+            }
+            if (!acceptQueryToken(parser, ",")) {
+                break;
+            }
+        }
+    }
+
+    // LIMIT <n>
+    if (status == 0 && acceptQueryToken(parser, "limit")) {
+        char *end = NULL;
+        if (parser->position < parser->numTokens) {
+            query->limit = strtol(parser->tokens[parser->position].text, &end, 10);
+        }
+        if (end == NULL || *end != '\0' || query->limit < 0) {
+            fprintf(stderr, "Error in the query: LIMIT needs a number.\n");
+            status = -1;
+        }
+        parser->position++;
+    }
+
+    if (status == 0 && parser->position < parser->numTokens) {
+        fprintf(stderr, "Error in the query: unexpected '%s'.\n", parser->tokens[parser->position].text);
+        status = -1;
+    }
+
+    // Sums have their own accumulators, the selected columns are matched
+    // with the groups once they are resolved in the store
+    for (size_t i = 0; i < query->numSelect && status == 0; i++) {
+        QuerySelectItem *item = &query->select[i];
+        if (item->aggregate == QUERY_SUM) {
+            item->index = query->numSums++;
+        }
+    }
+
+    free(parser);
+    return status;
+}
+
+/* Resolves the columns of a query in the store, checks that every selected
+ * column is grouped and evaluates the conditions of text columns once per
+ * distinct value. Returns 0 on success or -1 on error (with a message) */
+int compileSelectQuery(SelectQuery *query, const ColumnStore *store) {
+    // mvp is the last field of every line, when all the lines have the same
+    // fields it is the last column and c<n> names the same one
+    int lastColumn = resolveStoreColumn(store, -1);
+    int sameWidth = store->numColumns > 0;
+    for (size_t row = 0; sameWidth && row < store->numRows; row++) {
+        sameWidth = store->columns[store->numColumns - 1][row] >= 0;
+    }
+    if (sameWidth) {
+        lastColumn = store->numColumns - 1;
+    }
+
+    // The ids of the GROUP BY columns are packed in the key of a group
+    int keyBits = 0;
+    for (size_t i = 0; i < query->numGroupBy; i++) {
+        int column = resolveQueryColumn(store, query->groupBy[i].column, lastColumn);
+        if (column < 0) {
+            fprintf(stderr, "Error in the query: the column %d isn't in the inputs.\n", query->groupBy[i].column);
+            return -1;
+        }
+        int bits = 0;
+        while (((size_t) 1 << bits) < store->dictionaries[column].count) {
+            bits++;
+        }
+        query->groupColumns[i] = column;
+        query->groupShifts[i] = keyBits;
+        query->groupBits[i] = bits;
+        keyBits += bits;
+        if (keyBits > QUERY_GROUP_KEY_BITS) {
+            fprintf(stderr, "Error in the query: the GROUP BY columns have too many distinct values.\n");
+            return -1;
+        }
+    }
+
+    // A selected column must be one of the groups
+    for (size_t i = 0; i < query->numSelect; i++) {
+        QuerySelectItem *item = &query->select[i];
+        if (item->aggregate != QUERY_NO_AGGREGATE) {
+            continue;
+        }
+        int column = resolveQueryColumn(store, item->value.column, lastColumn);
+        item->index = -1;
+        for (size_t j = 0; j < query->numGroupBy && item->index < 0; j++) {
+            if (column >= 0 && query->groupColumns[j] == column) {
+                item->index = j;
+            }
+        }
+        if (item->index < 0) {
+            fprintf(stderr, "Error in the query: '%s' must be in GROUP BY.\n", item->name);
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < query->numWhere; i++) {
+        QueryCondition *condition = &query->where[i];
+        if (condition->value.kind != QUERY_TEXT) {
+            continue;
+        }
+        int column = resolveQueryColumn(store, condition->value.column, lastColumn);
+        if (column < 0) {
+            fprintf(stderr, "Error in the query: the column %d isn't in the inputs.\n", condition->value.column);
+            return -1;
+        }
+        condition->value.column = column;
+
+        const ColumnDictionary *dictionary = &store->dictionaries[column];
+        condition->keep = calloc(dictionary->count + 1, sizeof(unsigned char));
+        if (condition->keep == NULL) {
+            perror("Failed to allocate memory for the condition");
+            return -1;
+        }
+        for (size_t id = 0; id < dictionary->count; id++) {
+            if (condition->operator == QUERY_LIKE) {
+                condition->keep[id] = matchLikePattern(dictionary->values[id], condition->text);
+            } else {
+                condition->keep[id] = (strcmp(dictionary->values[id], condition->text) == 0) ==
+                                      (condition->operator == QUERY_EQUAL);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Translates a column of a query to a column of the store, with -1 (mvp) as
+ * lastColumn. Returns -1 if the store doesn't have it */
+int resolveQueryColumn(const ColumnStore *store, int column, int lastColumn) {
+    return column < 0 ? lastColumn : resolveStoreColumn(store, column);
+}
+
+/* Frees what the compilation of a query allocated */
+void freeSelectQuery(SelectQuery *query) {
+    for (size_t i = 0; i < query->numWhere; i++) {
+        free(query->where[i].keep);
+        query->where[i].keep = NULL;
+    }
+}
+
+/* Checks a value against a LIKE pattern: % matches any sequence and _ any
+ * (UTF-8) character. Returns 1 if it matches or 0 if it doesn't */
+int matchLikePattern(const char *value, const char *pattern) {
+    // Backtrack to the last % when the rest doesn't match
+    const char *starPattern = NULL;
+    const char *starValue = NULL;
+
+    while (*value != '\0') {
+        if (*pattern == '%') {
+            starPattern = ++pattern;
+            starValue = value;
+        } else if (*pattern == '_') {
+            // A character, with all the bytes of a multibyte one
+            pattern++;
+            value++;
+            while ((*value & 0xC0) == 0x80) {
+                value++;
+            }
+        } else if (*pattern == *value) {
+            pattern++;
+            value++;
+        } else if (starPattern != NULL) {
+            pattern = starPattern;
+            value = ++starValue;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '%') {
+        pattern++;
+    }
+
+    return *pattern == '\0';
+}
+
+/* Runs a compiled query: the rows are split among the threads, every one
+ * runs the operators over its rows into its own table of groups, and these
+ * are added up, turned into rows, sorted and limited. The number of groups
+ * is stored in numGroups. Returns the rows or NULL on error */
+QueryRow *executeSelectQuery(const SelectQuery *query, const ColumnStore *store, int numberOfThreads,
+                             size_t *numRows, size_t *numGroups) {
+    numberOfThreads = countStoreThreads(store, numberOfThreads);
+    size_t rowsPerThread = store->numRows / numberOfThreads;
+
+    QueryThread *work = calloc(numberOfThreads, sizeof(QueryThread));
+    pthread_t *threads = malloc(numberOfThreads * sizeof(pthread_t));
+    if (work == NULL || threads == NULL) {
+        perror("Failed to allocate memory for the query threads");
+        free(work);
+        free(threads);
         return NULL;
     }
 
-    // Skip lines before the start line
-    int currentLine = 0;
-    while (currentLine < startLine && fgets(buffer, sizeof(buffer), file)) {
-        currentLine++;
+    int status = 0;
+    for (int i = 0; i < numberOfThreads; i++) {
+        work[i].store = store;
+        work[i].query = query;
+        work[i].startRow = i * rowsPerThread;
+        work[i].endRow = i == numberOfThreads - 1 ? store->numRows : (i + 1) * rowsPerThread;
+        if (initQueryGroups(&work[i].groups, query->numSums) == -1) {
+            status = -1;
+        }
     }
 
-    // Extract player names from the specified range of lines
-    size_t i = 0;
-    while (i < numLinesInRange && fgets(buffer, sizeof(buffer), file)) {
-        // Picks only the player name without the comma before his name
-        playerNames[i] = strdup(strrchr(buffer, ',') + 1);
-        i++;
+    if (status == 0) {
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_create(&threads[i], NULL, runQueryOperators, &work[i]);
+        }
+        for (int i = 0; i < numberOfThreads; i++) {
+            pthread_join(threads[i], NULL);
+            if (work[i].failed) {
+                status = -1;
+            }
+        }
     }
 
-    // Trim trailing whitespace from the players names
-    for (size_t j = 0; j < numLinesInRange; j++) {
-        if (playerNames[j]) {
-            // find \r or \n and replace it with \0
-            // ex: "Player Name\n" => "Player Name\0"
-            playerNames[j][strcspn(playerNames[j], "\r\n")] = '\0';
+    // Add the groups of the threads to those of the first one
+    QueryGroups *groups = &work[0].groups;
+    for (int i = 1; i < numberOfThreads; i++) {
+        const QueryGroups *other = &work[i].groups;
+        for (size_t slot = 0; status == 0 && slot < other->capacity; slot++) {
+            if (other->keys[slot] == QUERY_EMPTY_GROUP) {
+                continue;
+            }
+            long target = findQueryGroup(groups, other->keys[slot]);
+            if (target == -1) {
+                status = -1;
+                break;
+            }
+            groups->counts[target] += other->counts[slot];
+            for (size_t j = 0; j < query->numSums; j++) {
+                groups->sums[target * query->numSums + j] += other->sums[slot * query->numSums + j];
+            }
         }
+        freeQueryGroups(&work[i].groups);
     }
 
-    fclose(file);
+    // Without GROUP BY there is always one row
+    if (status == 0 && query->numGroupBy == 0 && findQueryGroup(groups, 0) == -1) {
+        status = -1;
+    }
+
+    QueryRow *rows = NULL;
+    size_t count = 0;
+    if (status == 0) {
+        rows = malloc((groups->count + 1) * sizeof(QueryRow));
+        if (rows == NULL) {
+            perror("Failed to allocate memory for the result of the query");
+        }
+    }
+
+    // Every group is a row of the result
+    for (size_t slot = 0; rows != NULL && slot < groups->capacity; slot++) {
+        uint64_t key = groups->keys[slot];
+        if (key == QUERY_EMPTY_GROUP) {
+            continue;
+        }
+        QueryRow *row = &rows[count++];
+        row->query = query;
+        row->group = key;
+        for (size_t i = 0; i < query->numSelect; i++) {
+            const QuerySelectItem *item = &query->select[i];
+            row->texts[i] = NULL;
+            row->numbers[i] = 0;
+            if (item->aggregate == QUERY_COUNT) {
+                row->numbers[i] = groups->counts[slot];
+            } else if (item->aggregate == QUERY_SUM) {
+                row->numbers[i] = groups->sums[slot * query->numSums + item->index];
+            } else {
+                int column = query->groupColumns[item->index];
+                uint64_t mask = ((uint64_t) 1 << query->groupBits[item->index]) - 1;
+                size_t id = key >> query->groupShifts[item->index] & mask;
+                row->texts[i] = store->dictionaries[column].values[id];
+            }
+        }
+    }
+    *numGroups = groups->count;
+    freeQueryGroups(groups);
+    free(work);
+    free(threads);
+
+    // Without ORDER BY the groups keep the order of their keys
+    if (rows != NULL) {
+        qsort(rows, count, sizeof(QueryRow), compareQueryRows);
+    }
+    if (query->limit >= 0 && (size_t) query->limit < count) {
+        count = query->limit;
+    }
 
-    return playerNames;
+    *numRows = count;
+    return rows;
 }
 
-/* Counts the total lines in a file, return line count or -1 on error */
-int getLineCountFromFile(const char *fileName) {
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL) {
-        perror("Error opening file");
+/* Allocates an empty table of groups with numSums goals per group.
+ * Returns 0 on success or -1 on error */
+int initQueryGroups(QueryGroups *groups, size_t numSums) {
+    groups->numSums = numSums;
+    groups->capacity = QUERY_GROUPS_CAPACITY;
+    groups->count = 0;
+    groups->keys = malloc(groups->capacity * sizeof(uint64_t));
+    groups->counts = calloc(groups->capacity, sizeof(long));
+    groups->sums = calloc(groups->capacity * numSums + 1, sizeof(long));
+    if (groups->keys == NULL || groups->counts == NULL || groups->sums == NULL) {
+        perror("Failed to allocate memory for the groups of the query");
+        freeQueryGroups(groups);
         return -1;
     }
+    memset(groups->keys, 0xFF, groups->capacity * sizeof(uint64_t));
 
-    char buffer[1024];
-    int lineCount = 0;
+    return 0;
+}
 
-    // Count lines until EOF
-    while (fgets(buffer, sizeof(buffer), file)) {
-        lineCount++;
+/* Returns the slot of the group with the given key, inserting it (with no
+ * rows) if it isn't in the table. The table doubles when it is half full,
+ * so slots returned before may move. Returns -1 on error */
+long findQueryGroup(QueryGroups *groups, uint64_t key) {
+    if (2 * (groups->count + 1) > groups->capacity) {
+        QueryGroups grown;
+        grown.numSums = groups->numSums;
+        grown.capacity = groups->capacity * 2;
+        grown.count = 0;
+        grown.keys = malloc(grown.capacity * sizeof(uint64_t));
+        grown.counts = calloc(grown.capacity, sizeof(long));
+        grown.sums = calloc(grown.capacity * grown.numSums + 1, sizeof(long));
+        if (grown.keys == NULL || grown.counts == NULL || grown.sums == NULL) {
+            perror("Failed to allocate memory for the groups of the query");
+            freeQueryGroups(&grown);
+            return -1;
+        }
+        memset(grown.keys, 0xFF, grown.capacity * sizeof(uint64_t));
+
+        for (size_t slot = 0; slot < groups->capacity; slot++) {
+            if (groups->keys[slot] == QUERY_EMPTY_GROUP) {
+                continue;
+            }
+            long target = findQueryGroup(&grown, groups->keys[slot]);
+            grown.counts[target] = groups->counts[slot];
+            memcpy(&grown.sums[target * grown.numSums], &groups->sums[slot * groups->numSums],
+                   groups->numSums * sizeof(long));
+        }
+        freeQueryGroups(groups);
+        *groups = grown;
     }
 
-    fclose(file);
+    uint64_t hashValue = key * 0x9E3779B97F4A7C15ULL;
+    size_t slot = (hashValue ^ hashValue >> 32) & (groups->capacity - 1);
+    while (groups->keys[slot] != key) {
+        if (groups->keys[slot] == QUERY_EMPTY_GROUP) {
+            groups->keys[slot] = key;
+            groups->count++;
+            break;
+        }
+        slot = (slot + 1) & (groups->capacity - 1);
+    }
 
-    return lineCount;
+    return slot;
 }
 
-/** Thread function to count player occurrences in a specific range of lines */
-void *countPlayerOccurrences(void *arg) {
-    // Cast void* arg to ThreadData*, required because pthread_create passes
-    // arguments as void*
-    ThreadData *threadData = (ThreadData *) arg;
+/* Frees the arrays of a table of groups */
+void freeQueryGroups(QueryGroups *groups) {
+    free(groups->keys);
+    free(groups->counts);
+    free(groups->sums);
+    groups->keys = NULL;
+    groups->counts = NULL;
+    groups->sums = NULL;
+}
+
+/* Thread function that runs the operators of a query over its rows, a batch
+ * at a time: the filters narrow a selection vector of the batch, the group
+ * operator packs the ids of the GROUP BY columns into the key of the group,
+ * and the aggregate operator adds the rows and the goals to the group in the
+ * table of the thread. If memory runs out the thread stops and sets failed */
+void *runQueryOperators(void *arg) {
+    QueryThread *work = arg;
+    const SelectQuery *query = work->query;
+    const ColumnStore *store = work->store;
+    size_t *selection = malloc(KEY_BATCH_SIZE * sizeof(size_t));
+    uint64_t *groups = malloc(KEY_BATCH_SIZE * sizeof(uint64_t));
+    if (selection == NULL || groups == NULL) {
+        perror("Failed to allocate memory for the batches of the query");
+        free(selection);
+        free(groups);
+        work->failed = 1;
+        return NULL;
+    }
+
+    for (size_t batchStart = work->startRow; batchStart < work->endRow && !work->failed;
+         batchStart += KEY_BATCH_SIZE) {
+        size_t batchEnd = batchStart + KEY_BATCH_SIZE < work->endRow ? batchStart + KEY_BATCH_SIZE : work->endRow;
+
+        // Scan: every row of the batch is selected
+        size_t numSelected = 0;
+        for (size_t row = batchStart; row < batchEnd; row++) {
+            selection[numSelected++] = row;
+        }
+
+        // Filter
+        for (size_t i = 0; i < query->numWhere && numSelected > 0; i++) {
+            numSelected = filterQueryBatch(store, &query->where[i], selection, numSelected);
+        }
+
+        // Group
+        numSelected = groupQueryBatch(store, query, selection, groups, numSelected);
+
+        // Aggregate, a row at a time because a new group may move the slots
+        for (size_t j = 0; j < numSelected; j++) {
+            long slot = findQueryGroup(&work->groups, groups[j]);
+            if (slot == -1) {
+                work->failed = 1;
+                break;
+            }
+            work->groups.counts[slot]++;
+
+            size_t row = selection[j];
+            int home = store->homeGoals[row];
+            int away = store->awayGoals[row];
+            for (size_t i = 0; i < query->numSelect && home >= 0; i++) {
+                const QuerySelectItem *item = &query->select[i];
+                if (item->aggregate != QUERY_SUM) {
+                    continue;
+                }
+                work->groups.sums[slot * query->numSums + item->index] +=
+                        item->value.kind == QUERY_HOME_GOALS ? home :
+                        item->value.kind == QUERY_AWAY_GOALS ? away : home + away;
+            }
+        }
+    }
+
+    free(selection);
+    free(groups);
+    return NULL;
+}
 
-    size_t numLinesInRange = threadData->endLine - threadData->startLine;
+/* Filter operator: keeps the rows of the selection that pass a condition.
+ * Returns how many rows are left (at the start of the selection) */
+size_t filterQueryBatch(const ColumnStore *store, const QueryCondition *condition, size_t *selection,
+                        size_t numSelected) {
+    size_t numKept = 0;
 
-    // Extract player names from the specified range of lines in the file
-    char **playerNames = extractMVPNamesFromLineRange(threadData->fileName, threadData->startLine, threadData->endLine);
-    if (!playerNames) {
-        fprintf(stderr, "Thread %d: Failed to read file content\n", threadData->tid);
-        pthread_exit(NULL);
+    // Text columns were evaluated once per id
+    if (condition->value.kind == QUERY_TEXT) {
+        const int *ids = store->columns[condition->value.column];
+        for (size_t i = 0; i < numSelected; i++) {
+            int id = ids[selection[i]];
+            selection[numKept] = selection[i];
+            numKept += id >= 0 && condition->keep[id];
+        }
+        return numKept;
     }
 
-    // Process each player name in range
-    // incrementOrInsertHashItem manages thge mutex to prevent race conditions
-    for (size_t i = 0; i < numLinesInRange; i++) {
-        incrementOrInsertHashItem(threadData->table, playerNames[i], 1);
-        free(playerNames[i]);
+    for (size_t i = 0; i < numSelected; i++) {
+        size_t row = selection[i];
+        long home = store->homeGoals[row];
+        long away = store->awayGoals[row];
+        long goals = condition->value.kind == QUERY_HOME_GOALS ? home :
+                     condition->value.kind == QUERY_AWAY_GOALS ? away : home + away;
+        int passes;
+        switch (condition->operator) {
+            case QUERY_EQUAL:
+                passes = goals == condition->number;
+                break;
+            case QUERY_NOT_EQUAL:
+                passes = goals != condition->number;
+                break;
+            case QUERY_LESS:
+                passes = goals < condition->number;
+                break;
+            case QUERY_LESS_EQUAL:
+                passes = goals <= condition->number;
+                break;
+            case QUERY_GREATER:
+                passes = goals > condition->number;
+                break;
+            case QUERY_GREATER_EQUAL:
+                passes = goals >= condition->number;
+                break;
+            default:
+                passes = 0;
+                break;
+        }
+        // Rows without a score never pass
+        selection[numKept] = row;
+        numKept += passes && home >= 0;
     }
 
-    free(playerNames);
+    return numKept;
+}
+
+/* Group operator: stores in groups the key of the group of every selected
+ * row, dropping the rows without some GROUP BY column. Returns how many rows
+ * are left */
+size_t groupQueryBatch(const ColumnStore *store, const SelectQuery *query, size_t *selection, uint64_t *groups,
+                       size_t numSelected) {
+    for (size_t i = 0; i < numSelected; i++) {
+        groups[i] = 0;
+    }
 
-    // Terminates thread and return a void pointer as required by pthread API
-    pthread_exit(NULL);
+    for (size_t k = 0; k < query->numGroupBy; k++) {
+        const int *ids = store->columns[query->groupColumns[k]];
+        int shift = query->groupShifts[k];
+        size_t numKept = 0;
+        for (size_t i = 0; i < numSelected; i++) {
+            int id = ids[selection[i]];
+            selection[numKept] = selection[i];
+            groups[numKept] = groups[i] | (uint64_t) id << shift;
+            numKept += id >= 0;
+        }
+        numSelected = numKept;
+    }
+
+    return numSelected;
 }
 
-/* Comparison function for qsort to sort players in descending order by mvp count
- * Return negative if b < a, positive if b > a or 0 for equal */
-int compareByMVPCounts(const void *a, const void *b) {
-    // Cast the generic void pointers to SortableItem pointers
-    // This is necessary because qsort() uses void pointers
-    SortableItem *itemA = (SortableItem *) a;
-    SortableItem *itemB = (SortableItem *) b;
+/* Comparison function for qsort to sort the rows of a query by the keys of
+ * ORDER BY, the ties keep the order of the groups */
+int compareQueryRows(const void *a, const void *b) {
+    const QueryRow *rowA = a;
+    const QueryRow *rowB = b;
+    const SelectQuery *query = rowA->query;
 
-    // Subtract a from b to sort in descending order
-    return itemB->value - itemA->value;
-}
\ No newline at end of file
+    for (size_t i = 0; i < query->numOrderBy; i++) {
+        int item = query->orderBy[i].item;
+        int comparison;
+        if (rowA->texts[item] != NULL) {
+            comparison = strcmp(rowA->texts[item], rowB->texts[item]);
+        } else {
+            comparison = (rowA->numbers[item] > rowB->numbers[item]) - (rowA->numbers[item] < rowB->numbers[item]);
+        }
+        if (comparison != 0) {
+            return query->orderBy[i].descending ? -comparison : comparison;
+        }
+    }
+
+    return (rowA->group > rowB->group) - (rowA->group < rowB->group);
+}
+
+/* Writes the result of a query with the format of the reports: every column
+ * but the last one padded to 24 visible characters */
+void writeQueryResult(FILE *file, const SelectQuery *query, const QueryRow *rows, size_t numRows) {
+    for (size_t i = 0; i < query->numSelect; i++) {
+        if (i + 1 < query->numSelect) {
+            int padding = 24 - countVisibleCharacters(query->select[i].name);
+            fprintf(file, "%s%*s|\t", query->select[i].name, padding > 0 ? padding : 0, "");
+        } else {
+            fprintf(file, "%s\n", query->select[i].name);
+        }
+    }
+    fprintf(file, "-----------------------------------\n");
+
+    for (size_t row = 0; row < numRows; row++) {
+        for (size_t i = 0; i < query->numSelect; i++) {
+            char number[32];
+            const char *text = rows[row].texts[i];
+            if (text == NULL) {
+                snprintf(number, sizeof(number), "%ld", rows[row].numbers[i]);
+                text = number;
+            }
+            if (i + 1 < query->numSelect) {
+                int padding = 24 - countVisibleCharacters(text);
+                fprintf(file, "%s%*s|\t", text, padding > 0 ? padding : 0, "");
+            } else {
+                fprintf(file, "%s\n", text);
+            }
+        }
+    }
+}